@@ -23,14 +23,18 @@ class LLVMTypeConverter;
 
 namespace circt {
 
-/// Get the LLHD to LLVM conversion patterns.
+/// Get the LLHD to LLVM conversion patterns. If `driveLogs` is set, the
+/// units take a pointer to a drive log as additional argument, and the
+/// signal drives are appended to it instead of calling the runtime library.
 void populateLLHDToLLVMConversionPatterns(mlir::LLVMTypeConverter &converter,
                                           OwningRewritePatternList &patterns,
                                           size_t &sigCounter,
-                                          size_t &regCounter);
+                                          size_t &regCounter,
+                                          bool driveLogs = false);
 
 /// Create an LLHD to LLVM conversion pass.
-std::unique_ptr<OperationPass<ModuleOp>> createConvertLLHDToLLVMPass();
+std::unique_ptr<OperationPass<ModuleOp>>
+createConvertLLHDToLLVMPass(bool driveLogs = false);
 
 } // namespace circt
 
@@ -30,6 +30,13 @@ struct FIRParserOptions {
   /// If this is set to true, the @info locators are ignored, and the locations
   /// are set to the location in the .fir file.
   bool ignoreInfoLocators = false;
+
+  /// If this is set to true, the bodies of the modules are parsed concurrently,
+  /// once a scan of the circuit finds where they end by their indentation.
+  /// Diagnostics are reported in the order of the modules, and a module may be
+  /// instantiated before it is defined.  This has no effect if multithreading
+  /// is disabled in the context.
+  bool parseModulesInParallel = false;
 };
 
 mlir::OwningModuleRef importFIRRTL(llvm::SourceMgr &sourceMgr,
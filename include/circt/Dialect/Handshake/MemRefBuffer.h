@@ -0,0 +1,87 @@
+//===- MemRefBuffer.h - Contents of simulated memrefs -----------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the storage of the memrefs allocated when simulating the
+// standard and handshake dialects.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CIRCT_DIALECT_HANDSHAKE_MEMREFBUFFER_H
+#define CIRCT_DIALECT_HANDSHAKE_MEMREFBUFFER_H
+
+#include "mlir/IR/Types.h"
+#include "llvm/ADT/Any.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <memory>
+#include <vector>
+
+namespace circt {
+namespace handshake {
+
+/// The contents of a memref of integers or floats, stored contiguously in the
+/// layout of the host: integers in the smallest of 1, 2, 4 or 8 bytes holding
+/// them, or in 64 bit words if wider, and floats in their IEEE format. The
+/// contents are either owned or mapped from a file, copy on write.
+class MemRefBuffer {
+public:
+  /// Allocate a buffer of `size` zeros.
+  MemRefBuffer(mlir::Type elementType, size_t size);
+
+  /// Read a buffer of `size` elements from a raw binary file, of exactly the
+  /// size of the buffer. The file is mapped to memory if `map` is set, such
+  /// that only the elements accessed are read.
+  static llvm::Expected<MemRefBuffer> readFile(mlir::Type elementType,
+                                               size_t size,
+                                               llvm::StringRef path, bool map);
+
+  /// Write the contents of the buffer to a raw binary file.
+  llvm::Error writeFile(llvm::StringRef path) const;
+
+  mlir::Type getElementType() const { return elementType; }
+  size_t size() const { return numElements; }
+
+  /// Get the number of bytes of the elements of a type, or 0 if memrefs of
+  /// this type can not be stored.
+  static unsigned getElementSize(mlir::Type elementType);
+
+  /// Get and set an element as the APInt or APFloat used by the interpreter,
+  /// floats in the semantics of their type.
+  llvm::Any get(size_t i) const;
+  void set(size_t i, const llvm::Any &value);
+
+  /// Get and set an element at most 64 bits wide as the bits of an integer,
+  /// zero-extended, or of an f32 or f64 converted to a double. The bits of
+  /// other floats are those of their own format.
+  uint64_t getBits(size_t i) const;
+  void setBits(size_t i, uint64_t bits);
+
+private:
+  MemRefBuffer(mlir::Type elementType, size_t size, uint8_t *data)
+      : elementType(elementType), elementSize(getElementSize(elementType)),
+        numElements(size), data(data) {}
+
+  uint8_t *getElement(size_t i) const {
+    assert(i < numElements && "memref access out of bounds");
+    return data + i * elementSize;
+  }
+
+  mlir::Type elementType;
+  unsigned elementSize;
+  size_t numElements;
+  /// The owned or mapped contents.
+  std::vector<uint8_t> owned;
+  std::unique_ptr<llvm::sys::fs::mapped_file_region> mapping;
+  uint8_t *data;
+};
+
+} // namespace handshake
+} // namespace circt
+
+#endif // CIRCT_DIALECT_HANDSHAKE_MEMREFBUFFER_H
@@ -17,9 +17,52 @@
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/MLIRContext.h"
 #include <string>
+#include <vector>
 
+/// The ways the simulated function is executed.
+enum class ExecutionMode {
+  /// Interpret the operations.
+  Interpret,
+  /// Run the function pre-compiled to typed slots.
+  Compiled,
+  /// Run the pre-compiled function, firing its handshake operations through
+  /// native code generated by the LLVM JIT.
+  JIT,
+};
+
+/// The options of a simulation.
+struct SimulationOptions {
+  ExecutionMode mode = ExecutionMode::Compiled;
+  /// Print the statistics of each operation of a handshake function after the
+  /// results.
+  bool runStats = false;
+  /// Map the memref arguments read from raw binary files to memory, rather
+  /// than reading them.
+  bool mapMemRefs = true;
+  /// If set, the final contents of the memref arguments are written to raw
+  /// binary files named after this prefix and the index of the argument,
+  /// rather than printed.
+  std::string memrefOutput;
+};
+
+/// Execute the given function with the arguments parsed from the command line
+/// and print its results. Memref arguments are either a comma-separated list
+/// of elements, or `@` followed by the path of a raw binary file holding them.
+/// The function is interpreted if it uses operations only the interpreter
+/// supports, whatever the execution mode.
 bool simulate(llvm::StringRef toplevelFunction,
               llvm::ArrayRef<std::string> inputArgs,
-              mlir::OwningModuleRef &module, mlir::MLIRContext &context);
+              mlir::OwningModuleRef &module, mlir::MLIRContext &context,
+              const SimulationOptions &options = SimulationOptions());
+
+/// Execute the given function once for each list of arguments, concurrently
+/// on `numThreads` threads or on all the hardware threads if 0, and print the
+/// results of every execution in the order of the lists. Each execution has
+/// values and memrefs of its own, and writes its memref outputs to files named
+/// after the prefix of the options, its index and the index of the argument.
+bool simulateSweep(llvm::StringRef toplevelFunction,
+                   llvm::ArrayRef<std::vector<std::string>> inputVectors,
+                   mlir::OwningModuleRef &module, mlir::MLIRContext &context,
+                   const SimulationOptions &options, unsigned numThreads = 0);
 
 #endif
@@ -15,6 +15,8 @@
 
 #include "circt/Dialect/LLHD/IR/LLHDOps.h"
 #include "mlir/IR/BuiltinOps.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/Support/GlobPattern.h"
 
 namespace mlir {
 class ExecutionEngine;
@@ -22,7 +24,11 @@ class ExecutionEngine;
 
 namespace llvm {
 class Error;
+class MemoryBuffer;
 class Module;
+namespace orc {
+class LLJIT;
+} // namespace orc
 } // namespace llvm
 
 namespace circt {
@@ -31,24 +37,44 @@ namespace sim {
 
 struct State;
 struct Instance;
+struct DriveLog;
+class Profiler;
 
 class Engine {
 public:
   /// Initialize an LLHD simulation engine. This initializes the state, as well
-  /// as the mlir::ExecutionEngine with the given module.
+  /// as the mlir::ExecutionEngine with the given module. If an object cache
+  /// path is given and the file exists, the compiled design is loaded from it
+  /// instead, skipping the lowering and code generation. Otherwise the
+  /// compiled design is saved to it. With more than one compile thread, the
+  /// design is split in partitions of units compiled concurrently.
   Engine(
       llvm::raw_ostream &out, ModuleOp module,
       llvm::function_ref<mlir::LogicalResult(mlir::ModuleOp)> mlirTransformer,
       llvm::function_ref<llvm::Error(llvm::Module *)> llvmTransformer,
-      std::string root, int mode);
+      std::string root, int mode, llvm::StringRef objectCachePath = "",
+      unsigned numCompileThreads = 1);
 
   /// Default destructor
   ~Engine();
 
   /// Run simulation up to n steps or maxTime picoseconds of simulation time.
-  /// n=0 and T=0 make the simulation run indefinitely.
+  /// n=0 and T=0 make the simulation run indefinitely. Returns a negative
+  /// value if the design cannot be run or the checkpoint cannot be saved.
   int simulate(int n, uint64_t maxTime);
 
+  /// Reset the simulation state to the one right after the initialization of
+  /// the design, such that the next call to simulate runs a new simulation,
+  /// independent of the previous ones. A checkpoint can be restored after the
+  /// reset to start from another state.
+  llvm::Error reset();
+
+  /// Create an engine sharing the compiled design of this one, writing its
+  /// trace to the given stream. The new engine has a freshly initialized
+  /// simulation state of its own and the settings of this one, except for the
+  /// checkpoint and profiling ones, such that both can simulate concurrently.
+  llvm::Expected<std::unique_ptr<Engine>> clone(llvm::raw_ostream &out) const;
+
   /// Build the instance layout of the design.
   void buildLayout(ModuleOp module);
 
@@ -64,15 +90,108 @@ public:
   /// Dump the instances each signal triggers.
   void dumpStateSignalTriggers();
 
+  /// Dump the event queue load statistics gathered during simulation.
+  void dumpQueueStatistics(llvm::raw_ostream &os);
+
+  /// Set the number of threads used to evaluate the instances woken up in the
+  /// same delta cycle. The produced trace does not depend on it.
+  void setNumThreads(unsigned n) { numThreads = std::max(n, 1u); }
+
+  /// Evaluate the entities in a static order, such that the combinational
+  /// logic settles within the delta cycle its inputs change in, instead of
+  /// taking one epsilon step per logic level. Registers and processes keep
+  /// going through the event queue. For synchronous designs, the signal values
+  /// at the end of each real-time step match the event-driven mode. Each pass
+  /// over a combinational loop counts as a cycle, and loops not settling go
+  /// through the event queue.
+  void setLevelized(bool enable) { levelized = enable; }
+
+  /// Restrict the trace to the signals whose hierarchical name, in the form
+  /// `<instance path>/<signal>`, matches one of the given glob patterns.
+  llvm::Error setTraceFilters(llvm::ArrayRef<std::string> filters);
+
+  /// Save the simulation state to a checkpoint file. Has to be called in
+  /// between simulation steps.
+  llvm::Error saveCheckpoint(llvm::StringRef path);
+
+  /// Restore the simulation state from a checkpoint file taken from the same
+  /// design. The next call to simulate resumes from the restored state. Has to
+  /// be called before simulating.
+  llvm::Error restoreCheckpoint(llvm::StringRef path);
+
+  /// Make the simulation save a checkpoint to the given file before running
+  /// the first step at or after the given time, in picoseconds.
+  void setCheckpoint(uint64_t time, std::string path) {
+    checkpointTime = time;
+    checkpointPath = std::move(path);
+  }
+
+  /// Enable the profiling of the next simulation run.
+  void setProfiling(bool enable) { profiling = enable; }
+
+  /// Dump the profile gathered during simulation.
+  void dumpProfile(llvm::raw_ostream &os);
+
+  /// Write the instance invocations and the event queue size recorded during
+  /// simulation to a file, in the Chrome trace event format.
+  llvm::Error writeProfileTrace(llvm::StringRef path);
+
 private:
+  /// Create an engine without state nor compiled design, used by clone.
+  Engine(llvm::raw_ostream &out, std::string root, int mode);
+
   void walkEntity(EntityOp entity, Instance &child);
 
+  /// Initialize the simulation state by invoking the design's init function.
+  mlir::LogicalResult initialize();
+
+  /// Compile the lowered design on the given number of threads, and load the
+  /// resulting objects in a JIT. The objects are saved to the object cache
+  /// path, if any.
+  llvm::Error compileInParallel(
+      llvm::function_ref<llvm::Error(llvm::Module *)> llvmTransformer,
+      unsigned numCompileThreads, llvm::StringRef objectCachePath);
+
+  /// Load the compiled design from an object file, or an archive of objects,
+  /// written by a previous run.
+  llvm::Error loadCachedObject(llvm::StringRef path);
+
+  /// Save the compiled design to an object file, or the given objects to an
+  /// archive.
+  void saveCachedObject(
+      llvm::StringRef path,
+      llvm::ArrayRef<std::unique_ptr<llvm::MemoryBuffer>> objects = {});
+
+  /// Look up the packed wrapper of the given function in the compiled design.
+  llvm::Expected<void (*)(void **)> lookupPacked(llvm::StringRef name);
+
+  /// Invoke the unit of the given instance, and issue the drives it appended
+  /// to the given drive log.
+  void runInstance(Instance &inst, DriveLog &log);
+
   llvm::raw_ostream &out;
   std::string root;
   std::unique_ptr<State> state;
-  std::unique_ptr<mlir::ExecutionEngine> engine;
+  // The compiled design, shared with the engines cloned from this one.
+  std::shared_ptr<mlir::ExecutionEngine> engine;
+  // The JIT holding the design when it is loaded from the object cache or
+  // compiled in parallel.
+  std::shared_ptr<llvm::orc::LLJIT> objectJIT;
   ModuleOp module;
   int traceMode;
+  // The wall-clock duration of the last simulation run, in seconds.
+  double wallTime = 0;
+  unsigned numThreads = 1;
+  bool levelized = false;
+  std::vector<llvm::GlobPattern> traceFilters;
+  bool initialized = false;
+  bool restored = false;
+  // The checkpoint of the state right after initialization, restored on reset.
+  std::string initialSnapshot;
+  llvm::Optional<uint64_t> checkpointTime;
+  std::string checkpointPath;
+  bool profiling = false;
+  std::unique_ptr<Profiler> profiler;
 };
 
 } // namespace sim
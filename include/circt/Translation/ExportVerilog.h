@@ -15,6 +15,7 @@
 
 namespace llvm {
 class raw_ostream;
+class StringRef;
 } // namespace llvm
 
 namespace mlir {
@@ -24,9 +25,23 @@ class ModuleOp;
 
 namespace circt {
 
-/// Export a module containing RTL, and SV dialect code.
+/// Export a module containing RTL, and SV dialect code.  The modules are
+/// emitted in parallel if the context allows multithreading.
 mlir::LogicalResult exportVerilog(mlir::ModuleOp module, llvm::raw_ostream &os);
 
+/// Export a module containing RTL, and SV dialect code, into one file per
+/// module and interface in the specified directory, emitted in parallel.  The
+/// other top-level operations are emitted at the top of every file, and the
+/// names of the files are listed in order in `filelist.f`.
+///
+/// The emitted files are recorded in `manifest.md5`.  If `incremental` is set,
+/// only the files whose contents on disk differ from the emitted ones are
+/// written, and the files of modules which are gone since the last emission
+/// are removed.
+mlir::LogicalResult exportSplitVerilog(mlir::ModuleOp module,
+                                       llvm::StringRef dirname,
+                                       bool incremental = false);
+
 /// Register a translation for exporting FIRRTL, RTL, and SV
 void registerToVerilogTranslation();
 
@@ -23,6 +23,7 @@
 #include "mlir/Pass/Pass.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/TinyPtrVector.h"
+#include "llvm/Support/ThreadPool.h"
 
 using namespace circt;
 using namespace firrtl;
@@ -120,11 +121,13 @@ private:
   rtl::RTLModuleExternOp lowerExtModule(FExtModuleOp oldModule,
                                         Block *topLevelModule);
 
-  void lowerModuleBody(FModuleOp oldModule,
-                       DenseMap<Operation *, Operation *> &oldToNewModuleMap);
+  void
+  lowerModuleBody(FModuleOp oldModule,
+                  const DenseMap<Operation *, Operation *> &oldToNewModuleMap);
 
-  void lowerInstance(InstanceOp instance, CircuitOp circuitOp,
-                     DenseMap<Operation *, Operation *> &oldToNewModuleMap);
+  void
+  lowerInstance(InstanceOp instance, CircuitOp circuitOp,
+                const DenseMap<Operation *, Operation *> &oldToNewModuleMap);
 };
 } // end anonymous namespace
 
@@ -186,10 +189,28 @@ void FIRRTLModuleLowering::runOnOperation() {
   // any instances that refer to the old modules.  Only rtl.instance can refer
   // to an rtl.module, not a firrtl.instance.
   //
-  // TODO: This is a trivially parallelizable for loop.  We should be able to
-  // process each module in parallel.
+  // Each module only changes its own body, and the map of the modules is only
+  // read from here on, so the modules are processed in parallel.  Their
+  // diagnostics are reported in the order of the modules.
+  SmallVector<FModuleOp, 32> modules;
   for (auto &op : circuitBody->getOperations()) {
     if (auto module = dyn_cast<FModuleOp>(op))
+      modules.push_back(module);
+  }
+
+  if (getContext().isMultithreadingEnabled() && modules.size() > 1) {
+    mlir::ParallelDiagnosticHandler diagHandler(&getContext());
+    llvm::ThreadPool pool(llvm::hardware_concurrency());
+    for (size_t i = 0, e = modules.size(); i != e; ++i) {
+      pool.async([&, i] {
+        diagHandler.setOrderIDForThread(i);
+        lowerModuleBody(modules[i], oldToNewModuleMap);
+        diagHandler.eraseOrderIDForThread();
+      });
+    }
+    pool.wait();
+  } else {
+    for (auto module : modules)
       lowerModuleBody(module, oldToNewModuleMap);
   }
 
@@ -509,9 +530,9 @@ static Value tryEliminatingConnectsToValue(Value flipValue,
 /// ports and instances.
 void FIRRTLModuleLowering::lowerModuleBody(
     FModuleOp oldModule,
-    DenseMap<Operation *, Operation *> &oldToNewModuleMap) {
+    const DenseMap<Operation *, Operation *> &oldToNewModuleMap) {
   auto newModule =
-      dyn_cast_or_null<rtl::RTLModuleOp>(oldToNewModuleMap[oldModule]);
+      dyn_cast_or_null<rtl::RTLModuleOp>(oldToNewModuleMap.lookup(oldModule));
   // Don't touch modules if we failed to lower ports.
   if (!newModule)
     return;
@@ -641,10 +662,10 @@ void FIRRTLModuleLowering::lowerModuleBody(
 /// letting the caller erase it.
 void FIRRTLModuleLowering::lowerInstance(
     InstanceOp oldInstance, CircuitOp circuitOp,
-    DenseMap<Operation *, Operation *> &oldToNewModuleMap) {
+    const DenseMap<Operation *, Operation *> &oldToNewModuleMap) {
 
   auto *oldModule = circuitOp.lookupSymbol(oldInstance.moduleName());
-  auto newModule = oldToNewModuleMap[oldModule];
+  auto newModule = oldToNewModuleMap.lookup(oldModule);
   if (!newModule) {
     oldInstance->emitOpError("could not find module referenced by instance");
     return;
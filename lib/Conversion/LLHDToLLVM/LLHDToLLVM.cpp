@@ -79,6 +79,28 @@ static Type getLLVMSigType(LLVM::LLVMDialect *dialect) {
                                           {i8PtrTy, i64Ty, i64Ty, i64Ty});
 }
 
+/// Return the LLVM type of the drive log passed to the units when lowering
+/// with drive logs. It corresponds to a struct with the format: {dataPtr,
+/// size, capacity}, with sizes in bytes.
+static Type getLLVMDriveLogType(LLVM::LLVMDialect *dialect) {
+  auto i8PtrTy =
+      LLVM::LLVMPointerType::get(IntegerType::get(dialect->getContext(), 8));
+  auto i64Ty = IntegerType::get(dialect->getContext(), 64);
+  return LLVM::LLVMStructType::getLiteral(dialect->getContext(),
+                                          {i8PtrTy, i64Ty, i64Ty});
+}
+
+/// Return the LLVM type of the header of a drive log entry. It corresponds
+/// to a struct with the format: {entrySize, time, delta, eps, signal, width}.
+/// The header is followed by the driven value, padded to a multiple of 8
+/// bytes.
+static Type getLLVMDriveLogEntryType(LLVM::LLVMDialect *dialect) {
+  auto i64Ty = IntegerType::get(dialect->getContext(), 64);
+  return LLVM::LLVMStructType::getLiteral(
+      dialect->getContext(),
+      {i64Ty, i64Ty, i64Ty, i64Ty, getLLVMSigType(dialect), i64Ty});
+}
+
 /// Extract the details from the given signal struct. The details are returned
 /// in the original struct order.
 static std::vector<Value> getSignalDetail(ConversionPatternRewriter &rewriter,
@@ -187,14 +209,19 @@ static Type unwrapLLVMPtr(Type ty) {
 
 /// Gather the types of values that are used outside of the block they're
 /// defined in. An LLVMType structure containing those types, in order of
-/// appearance, is returned.
-static Type getProcPersistenceTy(LLVM::LLVMDialect *dialect,
-                                 TypeConverter *converter, ProcOp &proc) {
+/// appearance, is returned. If `sigFields` is given, the indices of the fields
+/// holding a signal by value are appended to it.
+static Type
+getProcPersistenceTy(LLVM::LLVMDialect *dialect, TypeConverter *converter,
+                     ProcOp &proc,
+                     SmallVectorImpl<unsigned> *sigFields = nullptr) {
   SmallVector<Type, 3> types = SmallVector<Type, 3>();
   proc.walk([&](Operation *op) -> void {
     if (op->isUsedOutsideOfBlock(op->getBlock()) || isWaitDestArg(op)) {
       auto ty = op->getResult(0).getType();
       auto convertedTy = converter->convertType(ty);
+      if (sigFields && ty.isa<SigType>())
+        sigFields->push_back(types.size());
       if (ty.isa<PtrType, SigType>()) {
         // Persist the unwrapped value.
         types.push_back(unwrapLLVMPtr(convertedTy));
@@ -721,14 +748,17 @@ namespace {
 /// Convert an `llhd.entity` entity to LLVM dialect. The result is an
 /// `llvm.func` which takes a pointer to the global simulation state, a pointer
 /// to the entity's local state, and a pointer to the instance's signal table as
-/// arguments.
+/// arguments, followed by a pointer to the drive log when lowering with
+/// drive logs.
 struct EntityOpConversion : public ConvertToLLVMPattern {
   explicit EntityOpConversion(MLIRContext *ctx,
                               LLVMTypeConverter &typeConverter,
-                              size_t &sigCounter, size_t &regCounter)
+                              size_t &sigCounter, size_t &regCounter,
+                              bool driveLogs)
       : ConvertToLLVMPattern(llhd::EntityOp::getOperationName(), ctx,
                              typeConverter),
-        sigCounter(sigCounter), regCounter(regCounter) {}
+        sigCounter(sigCounter), regCounter(regCounter),
+        driveLogs(driveLogs) {}
 
   LogicalResult
   matchAndRewrite(Operation *op, ArrayRef<Value> operands,
@@ -752,9 +782,15 @@ struct EntityOpConversion : public ConvertToLLVMPattern {
     // state and signal table pointer arguments.
     LLVMTypeConverter::SignatureConversion intermediate(
         entityOp.getNumArguments());
-    // Add state and signal table arguments.
-    intermediate.addInputs(std::array<Type, 3>(
-        {i8PtrTy, entityStatePtrTy, LLVM::LLVMPointerType::get(sigTy)}));
+    // Add state and signal table arguments, and the drive log argument if
+    // requested.
+    SmallVector<Type, 4> unitArgTys(
+        {i8PtrTy, entityStatePtrTy, LLVM::LLVMPointerType::get(sigTy)});
+    if (driveLogs)
+      unitArgTys.push_back(
+          LLVM::LLVMPointerType::get(getLLVMDriveLogType(&getDialect())));
+    size_t numUnitArgs = unitArgTys.size();
+    intermediate.addInputs(unitArgTys);
     for (size_t i = 0, e = entityOp.getNumArguments(); i < e; ++i)
       intermediate.addInputs(i, voidTy);
     rewriter.applySignatureConversion(&entityOp.getBody(), intermediate);
@@ -763,9 +799,8 @@ struct EntityOpConversion : public ConvertToLLVMPattern {
         OpBuilder::atBlockBegin(&entityOp.getBlocks().front());
     LLVMTypeConverter::SignatureConversion final(
         intermediate.getConvertedTypes().size());
-    final.addInputs(0, i8PtrTy);
-    final.addInputs(1, entityStatePtrTy);
-    final.addInputs(2, LLVM::LLVMPointerType::get(sigTy));
+    for (size_t i = 0; i < numUnitArgs; ++i)
+      final.addInputs(i, unitArgTys[i]);
 
     // The first n elements of the signal table represent the entity arguments,
     // while the remaining elements represent the entity's owned signals.
@@ -778,14 +813,13 @@ struct EntityOpConversion : public ConvertToLLVMPattern {
           op->getLoc(), LLVM::LLVMPointerType::get(sigTy),
           entityOp.getArgument(2), ArrayRef<Value>(index));
       // Remap i-th original argument to the gep'd signal pointer.
-      final.remapInput(i + 3, gep.getResult());
+      final.remapInput(i + numUnitArgs, gep.getResult());
     }
 
     rewriter.applySignatureConversion(&entityOp.getBody(), final);
 
     // Get the converted entity signature.
-    auto funcTy = LLVM::LLVMFunctionType::get(
-        voidTy, {i8PtrTy, entityStatePtrTy, LLVM::LLVMPointerType::get(sigTy)});
+    auto funcTy = LLVM::LLVMFunctionType::get(voidTy, unitArgTys);
 
     // Create the a new llvm function to house the lowered entity.
     auto llvmFunc = rewriter.create<LLVM::LLVMFuncOp>(
@@ -804,6 +838,7 @@ struct EntityOpConversion : public ConvertToLLVMPattern {
 private:
   size_t &sigCounter;
   size_t &regCounter;
+  bool driveLogs;
 };
 } // namespace
 
@@ -829,10 +864,13 @@ struct TerminatorOpConversion : public ConvertToLLVMPattern {
 namespace {
 /// Convert an `llhd.proc` operation to LLVM dialect. This inserts the required
 /// logic to resume execution after an `llhd.wait` operation, as well as state
-/// keeping for values that need to persist across suspension.
+/// keeping for values that need to persist across suspension. A pointer to the
+/// drive log is added to the arguments when lowering with drive logs.
 struct ProcOpConversion : public ConvertToLLVMPattern {
-  explicit ProcOpConversion(MLIRContext *ctx, LLVMTypeConverter &typeConverter)
-      : ConvertToLLVMPattern(ProcOp::getOperationName(), ctx, typeConverter) {}
+  explicit ProcOpConversion(MLIRContext *ctx, LLVMTypeConverter &typeConverter,
+                            bool driveLogs)
+      : ConvertToLLVMPattern(ProcOp::getOperationName(), ctx, typeConverter),
+        driveLogs(driveLogs) {}
 
   LogicalResult
   matchAndRewrite(Operation *op, ArrayRef<Value> operands,
@@ -864,10 +902,15 @@ struct ProcOpConversion : public ConvertToLLVMPattern {
     // state, process-specific state and signal table.
     LLVMTypeConverter::SignatureConversion intermediate(
         procOp.getNumArguments());
-    // Add state, process state table and signal table arguments.
-    std::array<Type, 3> procArgTys({i8PtrTy,
-                                    LLVM::LLVMPointerType::get(stateTy),
-                                    LLVM::LLVMPointerType::get(sigTy)});
+    // Add state, process state table and signal table arguments, and the drive
+    // buffer argument if requested.
+    SmallVector<Type, 4> procArgTys({i8PtrTy,
+                                     LLVM::LLVMPointerType::get(stateTy),
+                                     LLVM::LLVMPointerType::get(sigTy)});
+    if (driveLogs)
+      procArgTys.push_back(
+          LLVM::LLVMPointerType::get(getLLVMDriveLogType(&getDialect())));
+    size_t numUnitArgs = procArgTys.size();
     intermediate.addInputs(procArgTys);
     for (size_t i = 0, e = procOp.getNumArguments(); i < e; ++i)
       intermediate.addInputs(i, voidTy);
@@ -878,9 +921,8 @@ struct ProcOpConversion : public ConvertToLLVMPattern {
         OpBuilder::atBlockBegin(&procOp.getBlocks().front());
     LLVMTypeConverter::SignatureConversion final(
         intermediate.getConvertedTypes().size());
-    final.addInputs(0, i8PtrTy);
-    final.addInputs(1, LLVM::LLVMPointerType::get(stateTy));
-    final.addInputs(2, LLVM::LLVMPointerType::get(sigTy));
+    for (size_t i = 0; i < numUnitArgs; ++i)
+      final.addInputs(i, procArgTys[i]);
 
     for (size_t i = 0, e = procOp.getNumArguments(); i < e; ++i) {
       // Create gep operations from the signal table for each original argument.
@@ -891,13 +933,11 @@ struct ProcOpConversion : public ConvertToLLVMPattern {
           procOp.getArgument(2), ArrayRef<Value>({index}));
 
       // Remap the i-th original argument to the gep'd value.
-      final.remapInput(i + 3, gep.getResult());
+      final.remapInput(i + numUnitArgs, gep.getResult());
     }
 
     // Get the converted process signature.
-    auto funcTy = LLVM::LLVMFunctionType::get(
-        voidTy, {i8PtrTy, LLVM::LLVMPointerType::get(stateTy),
-                 LLVM::LLVMPointerType::get(sigTy)});
+    auto funcTy = LLVM::LLVMFunctionType::get(voidTy, procArgTys);
     // Create a new llvm function to house the lowered process.
     auto llvmFunc = rewriter.create<LLVM::LLVMFuncOp>(op->getLoc(),
                                                       procOp.getName(), funcTy);
@@ -920,6 +960,9 @@ struct ProcOpConversion : public ConvertToLLVMPattern {
 
     return success();
   }
+
+private:
+  bool driveLogs;
 };
 } // namespace
 
@@ -1146,14 +1189,24 @@ struct InstOpConversion : public ConvertToLLVMPattern {
                             "addSigStructElement", addSigStructElemFuncTy);
 
     // Get or insert allocProc library call definition.
-    auto allocProcFuncTy =
-        LLVM::LLVMFunctionType::get(voidTy, {i8PtrTy, i8PtrTy, i8PtrTy});
+    // Signature: (i8* state, i8* owner, i8* procState, i64 size) -> void
+    auto allocProcFuncTy = LLVM::LLVMFunctionType::get(
+        voidTy, {i8PtrTy, i8PtrTy, i8PtrTy, i64Ty});
     auto allocProcFunc = getOrInsertFunction(module, rewriter, op->getLoc(),
                                              "allocProc", allocProcFuncTy);
 
+    // Get or insert addProcSignalRef library call definition.
+    // Signature: (i8* state, i8* owner, i64 offset) -> void
+    auto addProcSignalRefFuncTy =
+        LLVM::LLVMFunctionType::get(voidTy, {i8PtrTy, i8PtrTy, i64Ty});
+    auto addProcSignalRefFunc =
+        getOrInsertFunction(module, rewriter, op->getLoc(), "addProcSignalRef",
+                            addProcSignalRefFuncTy);
+
     // Get or insert allocEntity library call definition.
-    auto allocEntityFuncTy =
-        LLVM::LLVMFunctionType::get(voidTy, {i8PtrTy, i8PtrTy, i8PtrTy});
+    // Signature: (i8* state, i8* owner, i8* entityState, i64 size) -> void
+    auto allocEntityFuncTy = LLVM::LLVMFunctionType::get(
+        voidTy, {i8PtrTy, i8PtrTy, i8PtrTy, i64Ty});
     auto allocEntityFunc = getOrInsertFunction(
         module, rewriter, op->getLoc(), "allocEntity", allocEntityFuncTy);
 
@@ -1230,7 +1283,7 @@ struct InstOpConversion : public ConvertToLLVMPattern {
       // Add reg state pointer to global state.
       initBuilder.create<LLVM::CallOp>(
           op->getLoc(), voidTy, rewriter.getSymbolRefAttr(allocEntityFunc),
-          ArrayRef<Value>({initStatePtr, owner, regMall}));
+          ArrayRef<Value>({initStatePtr, owner, regMall, regSize}));
 
       // Index of the signal in the entity's signal table.
       int initCounter = 0;
@@ -1360,11 +1413,13 @@ struct InstOpConversion : public ConvertToLLVMPattern {
       // Handle process instantiation.
       auto sensesPtrTy = LLVM::LLVMPointerType::get(
           LLVM::LLVMArrayType::get(i1Ty, proc.getNumArguments()));
+      SmallVector<unsigned, 4> sigFields;
+      auto persistenceTy = getProcPersistenceTy(&getDialect(), typeConverter,
+                                                proc, &sigFields);
       auto procStatePtrTy =
           LLVM::LLVMPointerType::get(LLVM::LLVMStructType::getLiteral(
               rewriter.getContext(),
-              {i32Ty, i32Ty, sensesPtrTy,
-               getProcPersistenceTy(&getDialect(), typeConverter, proc)}));
+              {i32Ty, i32Ty, sensesPtrTy, persistenceTy}));
 
       auto zeroC = initBuilder.create<LLVM::ConstantOp>(
           op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(0));
@@ -1438,10 +1493,31 @@ struct InstOpConversion : public ConvertToLLVMPattern {
       initBuilder.create<LLVM::StoreOp>(op->getLoc(), sensesBC,
                                         procStateSensesPtr);
 
-      std::array<Value, 3> allocProcArgs({initStatePtr, owner, procStateMall});
+      std::array<Value, 4> allocProcArgs(
+          {initStatePtr, owner, procStateMall, procStateSize});
       initBuilder.create<LLVM::CallOp>(op->getLoc(), voidTy,
                                        rewriter.getSymbolRefAttr(allocProcFunc),
                                        allocProcArgs);
+
+      // Register the byte offsets of the signals persisted by value, whose
+      // value pointers have to be relocated when restoring a checkpoint.
+      auto threeC = initBuilder.create<LLVM::ConstantOp>(
+          op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(3));
+      for (auto field : sigFields) {
+        auto fieldC = initBuilder.create<LLVM::ConstantOp>(
+            op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(field));
+        auto fieldTy =
+            persistenceTy.cast<LLVM::LLVMStructType>().getBody()[field];
+        auto fieldGep = initBuilder.create<LLVM::GEPOp>(
+            op->getLoc(), LLVM::LLVMPointerType::get(fieldTy), procStateNullPtr,
+            ArrayRef<Value>({zeroC, threeC, fieldC}));
+        auto fieldOffset = initBuilder.create<LLVM::PtrToIntOp>(
+            op->getLoc(), i64Ty, fieldGep);
+        initBuilder.create<LLVM::CallOp>(
+            op->getLoc(), voidTy,
+            rewriter.getSymbolRefAttr(addProcSignalRefFunc),
+            ArrayRef<Value>({initStatePtr, owner, fieldOffset}));
+      }
     }
 
     rewriter.eraseOp(op);
@@ -1562,10 +1638,18 @@ namespace {
 /// `@driveSignal` function, which declaration is inserted at the beginning of
 /// the module if missing. The required arguments are either generated or
 /// fetched.
+///
+/// When lowering with drive logs, the drive is instead appended to the drive
+/// log passed to the unit, as long as it has room left. The simulator drains
+/// the log once the unit returns. If the log is full, it is drained by calling
+/// `@flushDriveLog` before calling `@driveSignal`, such that the drives are
+/// still issued in order.
 struct DrvOpConversion : public ConvertToLLVMPattern {
-  explicit DrvOpConversion(MLIRContext *ctx, LLVMTypeConverter &typeConverter)
+  explicit DrvOpConversion(MLIRContext *ctx, LLVMTypeConverter &typeConverter,
+                           bool driveLogs)
       : ConvertToLLVMPattern(llhd::DrvOp::getOperationName(), ctx,
-                             typeConverter) {}
+                             typeConverter),
+        driveLogs(driveLogs) {}
 
   LogicalResult
   matchAndRewrite(Operation *op, ArrayRef<Value> operands,
@@ -1637,32 +1721,153 @@ struct DrvOpConversion : public ConvertToLLVMPattern {
       rewriter.setInsertionPointToStart(drvBlock);
     }
 
-    auto oneConst = rewriter.create<LLVM::ConstantOp>(
+    // Get the time values.
+    auto extractTime = [&]() {
+      SmallVector<Value, 3> time;
+      for (int i = 0; i < 3; ++i)
+        time.push_back(rewriter.create<LLVM::ExtractValueOp>(
+            op->getLoc(), i64Ty, transformed.time(),
+            rewriter.getI32ArrayAttr(i)));
+      return time;
+    };
+
+    // Store the value on the stack and call the drive library function. The
+    // time values are extracted if none are given.
+    auto valuePtrTy = LLVM::LLVMPointerType::get(transformed.value().getType());
+    auto insertDriveCall = [&](ArrayRef<Value> time) {
+      auto oneConst = rewriter.create<LLVM::ConstantOp>(
+          op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(1));
+      auto alloca = rewriter.create<LLVM::AllocaOp>(op->getLoc(), valuePtrTy,
+                                                    oneConst, 4);
+      rewriter.create<LLVM::StoreOp>(op->getLoc(), transformed.value(), alloca);
+      auto bc =
+          rewriter.create<LLVM::BitcastOp>(op->getLoc(), i8PtrTy, alloca);
+
+      SmallVector<Value, 3> timeValues(time.begin(), time.end());
+      if (timeValues.empty())
+        timeValues = extractTime();
+
+      // Define the driveSignal library call arguments.
+      std::array<Value, 7> args({statePtr, transformed.signal(), bc, sigWidth,
+                                 timeValues[0], timeValues[1], timeValues[2]});
+      // Create the library call.
+      rewriter.create<LLVM::CallOp>(op->getLoc(), voidTy,
+                                    rewriter.getSymbolRefAttr(drvFunc), args);
+    };
+
+    if (!driveLogs) {
+      insertDriveCall({});
+      rewriter.eraseOp(op);
+      return success();
+    }
+    auto time = extractTime();
+
+    // Get or insert the drive log flush library call.
+    Value driveLog = op->getParentOfType<LLVM::LLVMFuncOp>().getArgument(3);
+    auto flushFuncTy = LLVM::LLVMFunctionType::get(
+        voidTy, {i8PtrTy, driveLog.getType()});
+    auto flushFunc = getOrInsertFunction(module, rewriter, op->getLoc(),
+                                         "flushDriveLog", flushFuncTy);
+
+    auto entryPtrTy =
+        LLVM::LLVMPointerType::get(getLLVMDriveLogEntryType(&getDialect()));
+    auto zeroC = rewriter.create<LLVM::ConstantOp>(
+        op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(0));
+    auto oneC = rewriter.create<LLVM::ConstantOp>(
         op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(1));
-    auto alloca = rewriter.create<LLVM::AllocaOp>(
-        op->getLoc(), LLVM::LLVMPointerType::get(transformed.value().getType()),
-        oneConst, 4);
-    rewriter.create<LLVM::StoreOp>(op->getLoc(), transformed.value(), alloca);
-    auto bc = rewriter.create<LLVM::BitcastOp>(op->getLoc(), i8PtrTy, alloca);
+    auto twoC = rewriter.create<LLVM::ConstantOp>(
+        op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(2));
 
-    // Get the time values.
-    auto realTime = rewriter.create<LLVM::ExtractValueOp>(
-        op->getLoc(), i64Ty, transformed.time(), rewriter.getI32ArrayAttr(0));
-    auto delta = rewriter.create<LLVM::ExtractValueOp>(
-        op->getLoc(), i64Ty, transformed.time(), rewriter.getI32ArrayAttr(1));
-    auto eps = rewriter.create<LLVM::ExtractValueOp>(
-        op->getLoc(), i64Ty, transformed.time(), rewriter.getI32ArrayAttr(2));
-
-    // Define the driveSignal library call arguments.
-    std::array<Value, 7> args(
-        {statePtr, transformed.signal(), bc, sigWidth, realTime, delta, eps});
-    // Create the library call.
+    // Compute the size of the entry: the header, followed by the value padded
+    // to a multiple of 8 bytes.
+    auto getTypeSize = [&](Type ptrTy) -> Value {
+      auto null = rewriter.create<LLVM::NullOp>(op->getLoc(), ptrTy);
+      auto gep = rewriter.create<LLVM::GEPOp>(op->getLoc(), ptrTy, null,
+                                              ArrayRef<Value>(oneC));
+      return rewriter.create<LLVM::PtrToIntOp>(op->getLoc(), i64Ty, gep);
+    };
+    auto headerSize = getTypeSize(entryPtrTy);
+    auto valueSize = getTypeSize(valuePtrTy);
+    auto sevenC = rewriter.create<LLVM::ConstantOp>(
+        op->getLoc(), i64Ty, rewriter.getI64IntegerAttr(7));
+    auto alignMaskC = rewriter.create<LLVM::ConstantOp>(
+        op->getLoc(), i64Ty, rewriter.getI64IntegerAttr(-8));
+    auto paddedSize = rewriter.create<LLVM::AndOp>(
+        op->getLoc(), i64Ty,
+        rewriter.create<LLVM::AddOp>(op->getLoc(), i64Ty, valueSize, sevenC),
+        alignMaskC);
+    auto entrySize = rewriter.create<LLVM::AddOp>(op->getLoc(), i64Ty,
+                                                  headerSize, paddedSize);
+
+    // Check whether the entry fits in the log.
+    auto dataPtr = rewriter.create<LLVM::GEPOp>(
+        op->getLoc(), LLVM::LLVMPointerType::get(i8PtrTy), driveLog,
+        ArrayRef<Value>({zeroC, zeroC}));
+    auto sizePtr = rewriter.create<LLVM::GEPOp>(
+        op->getLoc(), LLVM::LLVMPointerType::get(i64Ty), driveLog,
+        ArrayRef<Value>({zeroC, oneC}));
+    auto capacityPtr = rewriter.create<LLVM::GEPOp>(
+        op->getLoc(), LLVM::LLVMPointerType::get(i64Ty), driveLog,
+        ArrayRef<Value>({zeroC, twoC}));
+    auto size = rewriter.create<LLVM::LoadOp>(op->getLoc(), i64Ty, sizePtr);
+    auto capacity =
+        rewriter.create<LLVM::LoadOp>(op->getLoc(), i64Ty, capacityPtr);
+    auto newSize =
+        rewriter.create<LLVM::AddOp>(op->getLoc(), i64Ty, size, entrySize);
+    auto fits = rewriter.create<LLVM::ICmpOp>(
+        op->getLoc(), LLVM::ICmpPredicate::ule, newSize, capacity);
+
+    auto block = rewriter.getInsertionBlock();
+    auto continueBlock =
+        rewriter.splitBlock(block, rewriter.getInsertionPoint());
+    auto appendBlock = rewriter.createBlock(continueBlock);
+    auto fallbackBlock = rewriter.createBlock(continueBlock);
+    rewriter.setInsertionPointToEnd(block);
+    rewriter.create<LLVM::CondBrOp>(op->getLoc(), fits, appendBlock,
+                                    fallbackBlock);
+
+    // Append the entry to the log.
+    rewriter.setInsertionPointToStart(appendBlock);
+    auto data = rewriter.create<LLVM::LoadOp>(op->getLoc(), i8PtrTy, dataPtr);
+    auto entryBytes = rewriter.create<LLVM::GEPOp>(
+        op->getLoc(), i8PtrTy, data, ArrayRef<Value>(size));
+    auto entry =
+        rewriter.create<LLVM::BitcastOp>(op->getLoc(), entryPtrTy, entryBytes);
+    auto signal =
+        rewriter.create<LLVM::LoadOp>(op->getLoc(), sigTy, transformed.signal());
+    std::array<Value, 6> fields(
+        {entrySize, time[0], time[1], time[2], signal, sigWidth});
+    for (size_t i = 0, e = fields.size(); i < e; ++i) {
+      auto indexC = rewriter.create<LLVM::ConstantOp>(
+          op->getLoc(), i32Ty, rewriter.getI32IntegerAttr(i));
+      auto fieldPtr = rewriter.create<LLVM::GEPOp>(
+          op->getLoc(), LLVM::LLVMPointerType::get(fields[i].getType()), entry,
+          ArrayRef<Value>({zeroC, indexC}));
+      rewriter.create<LLVM::StoreOp>(op->getLoc(), fields[i], fieldPtr);
+    }
+    auto valueBytes = rewriter.create<LLVM::GEPOp>(
+        op->getLoc(), i8PtrTy, entryBytes, ArrayRef<Value>(headerSize));
+    auto valuePtr =
+        rewriter.create<LLVM::BitcastOp>(op->getLoc(), valuePtrTy, valueBytes);
+    rewriter.create<LLVM::StoreOp>(op->getLoc(), transformed.value(), valuePtr,
+                                   /*alignment=*/8);
+    rewriter.create<LLVM::StoreOp>(op->getLoc(), newSize, sizePtr);
+    rewriter.create<LLVM::BrOp>(op->getLoc(), ValueRange(), continueBlock);
+
+    // Drain the full log and call the library.
+    rewriter.setInsertionPointToStart(fallbackBlock);
     rewriter.create<LLVM::CallOp>(op->getLoc(), voidTy,
-                                  rewriter.getSymbolRefAttr(drvFunc), args);
+                                  rewriter.getSymbolRefAttr(flushFunc),
+                                  ArrayRef<Value>({statePtr, driveLog}));
+    insertDriveCall(time);
+    rewriter.create<LLVM::BrOp>(op->getLoc(), ValueRange(), continueBlock);
 
     rewriter.eraseOp(op);
     return success();
   }
+
+private:
+  bool driveLogs;
 };
 } // namespace
 
@@ -2697,13 +2902,17 @@ using LoadOpConversion =
 namespace {
 struct LLHDToLLVMLoweringPass
     : public ConvertLLHDToLLVMBase<LLHDToLLVMLoweringPass> {
+  LLHDToLLVMLoweringPass() = default;
+  LLHDToLLVMLoweringPass(bool driveLogs) {
+    this->driveLogs = driveLogs;
+  }
   void runOnOperation() override;
 };
 } // namespace
 
 void circt::populateLLHDToLLVMConversionPatterns(
     LLVMTypeConverter &converter, OwningRewritePatternList &patterns,
-    size_t &sigCounter, size_t &regCounter) {
+    size_t &sigCounter, size_t &regCounter, bool driveLogs) {
   MLIRContext *ctx = converter.getDialect()->getContext();
 
   // Value creation conversion patterns.
@@ -2729,12 +2938,15 @@ void circt::populateLLHDToLLVMConversionPatterns(
                                                                     converter);
 
   // Unit conversion patterns.
-  patterns.insert<TerminatorOpConversion, ProcOpConversion, WaitOpConversion,
-                  HaltOpConversion>(ctx, converter);
-  patterns.insert<EntityOpConversion>(ctx, converter, sigCounter, regCounter);
+  patterns.insert<TerminatorOpConversion, WaitOpConversion, HaltOpConversion>(
+      ctx, converter);
+  patterns.insert<ProcOpConversion>(ctx, converter, driveLogs);
+  patterns.insert<EntityOpConversion>(ctx, converter, sigCounter, regCounter,
+                                      driveLogs);
 
   // Signal conversion patterns.
-  patterns.insert<PrbOpConversion, DrvOpConversion>(ctx, converter);
+  patterns.insert<PrbOpConversion>(ctx, converter);
+  patterns.insert<DrvOpConversion>(ctx, converter, driveLogs);
   patterns.insert<SigOpConversion>(ctx, converter, sigCounter);
   patterns.insert<RegOpConversion>(ctx, converter, regCounter);
 
@@ -2779,7 +2991,7 @@ void LLHDToLLVMLoweringPass::runOnOperation() {
   // Setup the full conversion.
   populateStdToLLVMConversionPatterns(converter, patterns);
   populateLLHDToLLVMConversionPatterns(converter, patterns, sigCounter,
-                                       regCounter);
+                                       regCounter, driveLogs);
 
   target.addLegalDialect<LLVM::LLVMDialect>();
   target.addLegalOp<ModuleOp, ModuleTerminatorOp>();
@@ -2791,6 +3003,7 @@ void LLHDToLLVMLoweringPass::runOnOperation() {
 }
 
 /// Create an LLHD to LLVM conversion pass.
-std::unique_ptr<OperationPass<ModuleOp>> circt::createConvertLLHDToLLVMPass() {
-  return std::make_unique<LLHDToLLVMLoweringPass>();
+std::unique_ptr<OperationPass<ModuleOp>>
+circt::createConvertLLHDToLLVMPass(bool driveLogs) {
+  return std::make_unique<LLHDToLLVMLoweringPass>(driveLogs);
 }
@@ -105,21 +105,51 @@ std::string FIRToken::getStringValue(StringRef spelling) {
 //===----------------------------------------------------------------------===//
 
 FIRLexer::FIRLexer(const llvm::SourceMgr &sourceMgr, MLIRContext *context)
-    : sourceMgr(sourceMgr), context(context) {
+    : sourceMgr(sourceMgr), context(context),
+      bufferName(Identifier::get(
+          sourceMgr.getMemoryBuffer(sourceMgr.getMainFileID())
+              ->getBufferIdentifier(),
+          context)) {
   auto bufferID = sourceMgr.getMainFileID();
   curBuffer = sourceMgr.getMemoryBuffer(bufferID)->getBuffer();
   curPtr = curBuffer.begin();
+  lastLineStart = curBuffer.begin();
 }
 
 /// Encode the specified source location information into a Location object
 /// for attachment to the IR or error reporting.
 Location FIRLexer::translateLocation(llvm::SMLoc loc) {
-  unsigned mainFileID = sourceMgr.getMainFileID();
-  auto lineAndColumn = sourceMgr.getLineAndColumn(loc, mainFileID);
-  auto *buffer = sourceMgr.getMemoryBuffer(mainFileID);
+  auto lineAndColumn = getLineAndColumn(loc);
+  return FileLineColLoc::get(bufferName, lineAndColumn.first,
+                             lineAndColumn.second);
+}
+
+/// Return the line and column of the specified location, counting the lines
+/// from the line of the last location decoded.
+std::pair<unsigned, unsigned> FIRLexer::getLineAndColumn(llvm::SMLoc loc) {
+  const char *ptr = loc.getPointer();
+  if (ptr >= lastLineStart) {
+    StringRef skipped(lastLineStart, ptr - lastLineStart);
+    size_t lastNewline = skipped.rfind('\n');
+    if (lastNewline != StringRef::npos) {
+      lastLineNo += skipped.count('\n');
+      lastLineStart += lastNewline + 1;
+    }
+  } else {
+    StringRef skipped(ptr, lastLineStart - ptr);
+    lastLineNo -= skipped.count('\n');
+    lastLineStart = ptr;
+    while (lastLineStart != curBuffer.begin() && lastLineStart[-1] != '\n')
+      --lastLineStart;
+  }
+  return {lastLineNo, static_cast<unsigned>(ptr - lastLineStart + 1)};
+}
 
-  return FileLineColLoc::get(buffer->getBufferIdentifier(), lineAndColumn.first,
-                             lineAndColumn.second, context);
+void FIRLexer::setLineNumber(llvm::SMLoc loc, unsigned lineNo) {
+  lastLineStart = loc.getPointer();
+  while (lastLineStart != curBuffer.begin() && lastLineStart[-1] != '\n')
+    --lastLineStart;
+  lastLineNo = lineNo;
 }
 
 /// Emit an error message and return a FIRToken::error token.
@@ -14,6 +14,7 @@
 #define FIRTOMLIR_FIRLEXER_H
 
 #include "circt/Support/LLVM.h"
+#include "mlir/IR/Identifier.h"
 #include "llvm/Support/SourceMgr.h"
 
 namespace mlir {
@@ -100,6 +101,15 @@ public:
 
   mlir::Location translateLocation(llvm::SMLoc loc);
 
+  /// Return the line and column of the specified location.  These are decoded
+  /// by scanning from the line of the last location decoded, which is usually
+  /// close by, such that no index of the lines of the buffer is needed.
+  std::pair<unsigned, unsigned> getLineAndColumn(llvm::SMLoc loc);
+
+  /// Set the line number of the specified location, from which the following
+  /// locations are decoded.
+  void setLineNumber(llvm::SMLoc loc, unsigned lineNo);
+
   /// Return the indentation level of the specified token or None if this token
   /// is preceded by another token on the same line.
   Optional<unsigned> getIndentation(const FIRToken &tok) const;
@@ -107,6 +117,10 @@ public:
   /// Get an opaque pointer into the lexer state that can be restored later.
   FIRLexerCursor getCursor() const;
 
+  /// Move the lexer to the specified pointer into the buffer, such that the
+  /// next token lexed starts there.
+  void resetPointer(const char *newPointer) { curPtr = newPointer; }
+
 private:
   // Helpers.
   FIRToken formToken(FIRToken::Kind kind, const char *tokStart) {
@@ -129,6 +143,13 @@ private:
   StringRef curBuffer;
   const char *curPtr;
 
+  /// The name of the buffer, which is the file of the locations.
+  mlir::Identifier bufferName;
+
+  /// The start and the number of the line of the last location decoded.
+  const char *lastLineStart;
+  unsigned lastLineNo = 1;
+
   FIRLexer(const FIRLexer &) = delete;
   void operator=(const FIRLexer &) = delete;
   friend class FIRLexerCursor;
@@ -25,14 +25,19 @@
 #include "llvm/ADT/ScopedHashTable.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <atomic>
+
 using namespace circt;
 using namespace firrtl;
 
 using llvm::SMLoc;
 using llvm::SourceMgr;
+using mlir::ParallelDiagnosticHandler;
 
 /// Return true if this is a useless temporary name produced by FIRRTL.  We
 /// drop these as they don't convey semantic meaning.
@@ -85,6 +90,9 @@ struct GlobalFIRParserState {
   /// This is the next token that hasn't been consumed yet.
   FIRToken curToken;
 
+  /// The filenames of the @info locators, interned once each.
+  llvm::StringMap<Identifier> filenames;
+
   class BacktraceState {
   public:
     explicit BacktraceState(GlobalFIRParserState &state)
@@ -104,6 +112,13 @@ struct GlobalFIRParserState {
 
   BacktraceState getBacktrackState() { return BacktraceState(*this); }
 
+  /// Move the parser to the token starting at the specified pointer into the
+  /// buffer.
+  void resetPointer(const char *newPointer) {
+    lex.resetPointer(newPointer);
+    curToken = lex.lexToken();
+  }
+
 private:
   GlobalFIRParserState(const GlobalFIRParserState &) = delete;
   void operator=(const GlobalFIRParserState &) = delete;
@@ -162,6 +177,10 @@ struct FIRParser {
   ParseResult parseOptionalInfo(LocWithInfo &result,
                                 ArrayRef<Operation *> subOps = {});
 
+  /// Return the location of a line and column of a file of an @info locator.
+  Location getInfoLocation(StringRef filename, unsigned lineNo,
+                           unsigned columnNo);
+
   //===--------------------------------------------------------------------===//
   // Token Parsing
   //===--------------------------------------------------------------------===//
@@ -325,6 +344,19 @@ private:
   Optional<Location> infoLoc;
 };
 
+/// Return the location of a line and column of a file of an @info locator.
+/// The same few files are named by most locators, so their names are looked up
+/// in the parser rather than interned in the context each time.
+Location FIRParser::getInfoLocation(StringRef filename, unsigned lineNo,
+                                    unsigned columnNo) {
+  auto it = state.filenames.find(filename);
+  if (it == state.filenames.end())
+    it = state.filenames
+             .try_emplace(filename, Identifier::get(filename, getContext()))
+             .first;
+  return FileLineColLoc::get(it->second, lineNo, columnNo);
+}
+
 /// Parse an @info marker if present.  If so, apply the symbolic location
 /// specified it to all of the operations listed in subOps.
 ///
@@ -413,8 +445,8 @@ ParseResult FIRParser::parseOptionalInfo(LocWithInfo &result,
 
     // On success, remember what we already parsed (Bar.Scala / 309:14), and
     // move on to the next chunk.
-    auto loc = FileLineColLoc::get(filename.drop_front(spaceLoc + 1), lineNo,
-                                   columnNo, getContext());
+    auto loc =
+        getInfoLocation(filename.drop_front(spaceLoc + 1), lineNo, columnNo);
     extraLocs.push_back(loc);
     filename = nextFilename;
     lineNo = nextLineNo;
@@ -422,8 +454,7 @@ ParseResult FIRParser::parseOptionalInfo(LocWithInfo &result,
     spaceLoc = filename.find_last_of(' ');
   }
 
-  Location resultLoc =
-      FileLineColLoc::get(filename, lineNo, columnNo, getContext());
+  Location resultLoc = getInfoLocation(filename, lineNo, columnNo);
   if (!extraLocs.empty()) {
     extraLocs.push_back(resultLoc);
     std::reverse(extraLocs.begin(), extraLocs.end());
@@ -2415,11 +2446,19 @@ struct FIRModuleParser : public FIRScopedParser {
         circuit(circuit), firstScope(symbolTable),
         firstMemoryScope(memoryScopeTable) {}
 
+  using PortInfoAndLoc = std::pair<ModulePortInfo, SMLoc>;
+
   ParseResult parseExtModule(unsigned indent);
   ParseResult parseModule(unsigned indent);
 
+  /// Parse the name and ports of a module, and create it with an empty body.
+  ParseResult parseModuleHeader(unsigned indent, FModuleOp &fmodule,
+                                SmallVectorImpl<PortInfoAndLoc> &portList);
+  /// Parse the statements of a module into the body of the module.
+  ParseResult parseModuleBody(unsigned indent, FModuleOp fmodule,
+                              ArrayRef<PortInfoAndLoc> portList);
+
 private:
-  using PortInfoAndLoc = std::pair<ModulePortInfo, SMLoc>;
   ParseResult parsePortList(SmallVectorImpl<PortInfoAndLoc> &result,
                             unsigned indent);
 
@@ -2591,9 +2630,19 @@ ParseResult FIRModuleParser::parseExtModule(unsigned indent) {
 /// DEDENT
 ///
 ParseResult FIRModuleParser::parseModule(unsigned indent) {
+  FModuleOp fmodule;
+  SmallVector<PortInfoAndLoc, 4> portListAndLoc;
+  if (parseModuleHeader(indent, fmodule, portListAndLoc) ||
+      parseModuleBody(indent, fmodule, portListAndLoc))
+    return failure();
+  return success();
+}
+
+ParseResult FIRModuleParser::parseModuleHeader(
+    unsigned indent, FModuleOp &fmodule,
+    SmallVectorImpl<PortInfoAndLoc> &portListAndLoc) {
   LocWithInfo info(getToken().getLoc(), this);
   StringAttr name;
-  SmallVector<PortInfoAndLoc, 4> portListAndLoc;
 
   consumeToken(FIRToken::kw_module);
   if (parseId(name, "expected module name") ||
@@ -2608,8 +2657,13 @@ ParseResult FIRModuleParser::parseModule(unsigned indent) {
   portList.reserve(portListAndLoc.size());
   for (auto &elt : portListAndLoc)
     portList.push_back(elt.first);
-  auto fmodule = builder.create<FModuleOp>(info.getLoc(), name, portList);
+  fmodule = builder.create<FModuleOp>(info.getLoc(), name, portList);
+  return success();
+}
 
+ParseResult
+FIRModuleParser::parseModuleBody(unsigned indent, FModuleOp fmodule,
+                                 ArrayRef<PortInfoAndLoc> portListAndLoc) {
   // Install all of the ports into the symbol table, associated with their
   // block arguments.
   auto argIt = fmodule.args_begin();
@@ -2640,11 +2694,93 @@ struct FIRCircuitParser : public FIRParser {
   ParseResult parseCircuit();
 
 private:
+  /// A module whose body is parsed once the whole circuit has been scanned.
+  struct DeferredModule {
+    FModuleOp fmodule;
+    SmallVector<FIRModuleParser::PortInfoAndLoc, 4> portList;
+    unsigned indent;
+    /// The order of the module in the circuit, which orders its diagnostics.
+    size_t orderID;
+    /// The first token of the body, and the first token after it.
+    const char *bodyStart;
+    const char *bodyEnd;
+    /// The line number of the first token of the body.
+    unsigned bodyLineNo;
+  };
+
+  ParseResult parseDeferredModules(MutableArrayRef<DeferredModule> modules,
+                                   ParallelDiagnosticHandler &diagHandler);
+
   ModuleOp mlirModule;
 };
 
 } // end anonymous namespace
 
+/// Return the first token on a line after the one at `ptr` which is indented no
+/// more than `indent`, or the end of the buffer.  This finds the end of a
+/// module body without lexing it, which relies on the tokens of the body not
+/// spanning several lines.  Blank and comment lines do not end the body.
+static const char *skipIndentedLines(const char *ptr, const char *bufferEnd,
+                                     unsigned indent) {
+  while (true) {
+    // Move to the start of the next line.
+    while (ptr != bufferEnd && *ptr != '\n' && *ptr != '\r')
+      ++ptr;
+    while (ptr != bufferEnd && (*ptr == '\n' || *ptr == '\r'))
+      ++ptr;
+
+    unsigned lineIndent = 0;
+    while (ptr != bufferEnd && (*ptr == ' ' || *ptr == '\t' || *ptr == ','))
+      ++ptr, ++lineIndent;
+
+    if (ptr == bufferEnd)
+      return bufferEnd;
+    if (*ptr == '\n' || *ptr == '\r' || *ptr == ';')
+      continue;
+    if (lineIndent <= indent)
+      return ptr;
+  }
+}
+
+/// Parse the bodies of the modules concurrently, each with a parser state of
+/// its own.  The diagnostics of each module are emitted in its order.
+ParseResult FIRCircuitParser::parseDeferredModules(
+    MutableArrayRef<DeferredModule> modules,
+    ParallelDiagnosticHandler &diagHandler) {
+  if (modules.empty())
+    return success();
+
+  std::atomic<bool> anyFailed(false);
+  llvm::ThreadPool pool(llvm::hardware_concurrency());
+  for (auto &module : modules) {
+    pool.async([&] {
+      diagHandler.setOrderIDForThread(module.orderID);
+      GlobalFIRParserState state(getSourceMgr(), getContext(),
+                                 getState().options);
+      state.lex.setLineNumber(SMLoc::getFromPointer(module.bodyStart),
+                              module.bodyLineNo);
+      state.resetPointer(module.bodyStart);
+      auto circuit = module.fmodule->getParentOfType<CircuitOp>();
+      FIRModuleParser mp(state, circuit);
+      if (mp.parseModuleBody(module.indent, module.fmodule, module.portList) ||
+          state.curToken.is(FIRToken::error)) {
+        anyFailed = true;
+      } else if (state.curToken.getLoc().getPointer() != module.bodyEnd) {
+        // A statement spanning several lines has a line indented no more than
+        // the module, which the scan took for the end of the module.
+        mp.emitError(SMLoc::getFromPointer(module.bodyEnd),
+                     "statement continues at the indentation of its module, "
+                     "which is not supported when parsing modules in "
+                     "parallel");
+        anyFailed = true;
+      }
+      diagHandler.eraseOrderIDForThread();
+    });
+  }
+  pool.wait();
+  return failure(anyFailed);
+}
+
 /// file ::= circuit
 /// circuit ::= 'circuit' id ':' info? INDENT module* DEDENT EOF
 ///
@@ -2669,40 +2805,98 @@ ParseResult FIRCircuitParser::parseCircuit() {
   OpBuilder b(mlirModule.getBodyRegion());
   auto circuit = b.create<CircuitOp>(info.getLoc(), name);
 
+  // When parsing the modules in parallel, the circuit is scanned for the
+  // headers of the modules first, creating them with empty bodies.  The
+  // diagnostics of the scan and the bodies are buffered, and ordered by the
+  // module they come from.
+  std::unique_ptr<ParallelDiagnosticHandler> diagHandler;
+  if (getState().options.parseModulesInParallel &&
+      getContext()->isMultithreadingEnabled())
+    diagHandler = std::make_unique<ParallelDiagnosticHandler>(getContext());
+  std::vector<DeferredModule> deferredModules;
+  size_t numModules = 0;
+  const char *bufferEnd =
+      getSourceMgr()
+          .getMemoryBuffer(getSourceMgr().getMainFileID())
+          ->getBufferEnd();
+
   // Parse any contained modules.
   while (true) {
+    if (diagHandler)
+      diagHandler->setOrderIDForThread(numModules);
+
     switch (getToken().getKind()) {
     // If we got to the end of the file, then we're done.
     case FIRToken::eof:
-      return success();
+      if (!diagHandler)
+        return success();
+      diagHandler->eraseOrderIDForThread();
+      return parseDeferredModules(deferredModules, *diagHandler);
 
     // If we got an error token, then the lexer already emitted an error,
     // just stop.  We could introduce error recovery if there was demand for
     // it.
     case FIRToken::error:
-      return failure();
+      break;
 
     default:
       emitError("unexpected token in circuit");
-      return failure();
+      break;
 
     case FIRToken::kw_module:
     case FIRToken::kw_extmodule: {
       auto indent = getIndentation();
-      if (!indent.hasValue())
-        return emitError("'module' must be first token on its line"), failure();
+      if (!indent.hasValue()) {
+        emitError("'module' must be first token on its line");
+        break;
+      }
       unsigned moduleIndent = indent.getValue();
 
-      if (moduleIndent <= circuitIndent)
-        return emitError("module should be indented more"), failure();
+      if (moduleIndent <= circuitIndent) {
+        emitError("module should be indented more");
+        break;
+      }
 
       FIRModuleParser mp(getState(), circuit);
+      ++numModules;
+      if (diagHandler && getToken().is(FIRToken::kw_module)) {
+        DeferredModule module;
+        module.indent = moduleIndent;
+        module.orderID = numModules - 1;
+        if (mp.parseModuleHeader(moduleIndent, module.fmodule,
+                                 module.portList) ||
+            getToken().is(FIRToken::error))
+          break;
+
+        // Skip over the body of the module, and resume parsing after it.
+        module.bodyStart = getToken().getLoc().getPointer();
+        module.bodyEnd = module.bodyStart;
+        module.bodyLineNo =
+            getState().lex.getLineAndColumn(getToken().getLoc()).first;
+        auto bodyIndent = getIndentation();
+        if (getToken().isNot(FIRToken::eof) &&
+            (!bodyIndent.hasValue() || bodyIndent.getValue() > moduleIndent)) {
+          module.bodyEnd =
+              skipIndentedLines(module.bodyStart, bufferEnd, moduleIndent);
+          getState().resetPointer(module.bodyEnd);
+        }
+        deferredModules.push_back(std::move(module));
+        continue;
+      }
       if (getToken().is(FIRToken::kw_module) ? mp.parseModule(moduleIndent)
                                              : mp.parseExtModule(moduleIndent))
-        return failure();
-      break;
+        break;
+      continue;
     }
     }
+
+    // Parsing the circuit failed.  The modules before the failure are still
+    // parsed, such that their diagnostics are reported.
+    if (!diagHandler)
+      return failure();
+    diagHandler->eraseOrderIDForThread();
+    (void)parseDeferredModules(deferredModules, *diagHandler);
+    return failure();
   }
 }
 
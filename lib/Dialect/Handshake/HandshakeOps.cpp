@@ -158,7 +158,7 @@ bool handshake::ForkOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   return tryToExecute(getOperation(), valueMap, timeMap, scheduleList, 1);
 }
@@ -208,7 +208,7 @@ bool handshake::MergeOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   auto op = getOperation();
   bool found = false;
@@ -250,7 +250,7 @@ bool handshake::MuxOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   auto op = getOperation();
   mlir::Value control = op->getOperand(0);
@@ -370,7 +370,7 @@ bool handshake::ControlMergeOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   auto op = getOperation();
   bool found = false;
@@ -430,7 +430,7 @@ bool handshake::BranchOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   return tryToExecute(getOperation(), valueMap, timeMap, scheduleList, 0);
 }
@@ -459,7 +459,7 @@ bool handshake::ConditionalBranchOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   auto op = getOperation();
   mlir::Value control = op->getOperand(0);
@@ -496,7 +496,7 @@ bool handshake::StartOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   return true;
 }
@@ -510,7 +510,7 @@ bool handshake::EndOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   return true;
 }
@@ -530,7 +530,7 @@ bool handshake::SinkOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   valueMap.erase(getOperand());
   return true;
@@ -557,7 +557,7 @@ bool handshake::ConstantOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   return tryToExecute(getOperation(), valueMap, timeMap, scheduleList, 0);
 }
@@ -604,7 +604,7 @@ void MemoryOp::build(OpBuilder &builder, OperationState &result,
 
 bool handshake::MemoryOp::allocateMemory(
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<double> &storeTimes) {
   unsigned id = getID();
   if (memoryMap.count(id))
@@ -625,21 +625,8 @@ bool handshake::MemoryOp::allocateMemory(
     }
   }
   unsigned ptr = store.size();
-  store.resize(ptr + 1);
-  storeTimes.resize(ptr + 1);
-  store[ptr].resize(allocationSize);
-  storeTimes[ptr] = 0.0;
-  mlir::Type elementType = type.getElementType();
-  int width = elementType.getIntOrFloatBitWidth();
-  for (int i = 0; i < allocationSize; i++) {
-    if (elementType.isa<mlir::IntegerType>()) {
-      store[ptr][i] = APInt(width, 0);
-    } else if (elementType.isa<mlir::FloatType>()) {
-      store[ptr][i] = APFloat(0.0);
-    } else {
-      llvm_unreachable("Unknown result type!\n");
-    }
-  }
+  store.emplace_back(type.getElementType(), allocationSize);
+  storeTimes.push_back(0.0);
 
   memoryMap[id] = ptr;
   return true;
@@ -649,7 +636,7 @@ bool handshake::MemoryOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   auto op = getOperation();
   int opIndex = 0;
@@ -674,7 +661,7 @@ bool handshake::MemoryOp::tryExecute(
     auto &ref = store[buffer];
     unsigned offset = llvm::any_cast<APInt>(addressValue).getZExtValue();
     assert(offset < ref.size());
-    ref[offset] = dataValue;
+    ref.set(offset, dataValue);
 
     // Implicit none argument
     APInt apnonearg(1, 0);
@@ -703,7 +690,7 @@ bool handshake::MemoryOp::tryExecute(
     unsigned offset = llvm::any_cast<APInt>(addressValue).getZExtValue();
     assert(offset < ref.size());
 
-    valueMap[dataOut] = ref[offset];
+    valueMap[dataOut] = ref.get(offset);
     timeMap[dataOut] = addressTime;
     // Implicit none argument
     APInt apnonearg(1, 0);
@@ -738,7 +725,7 @@ bool handshake::LoadOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   auto op = getOperation();
   mlir::Value address = op->getOperand(0);
@@ -804,7 +791,7 @@ bool handshake::StoreOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   return tryToExecute(getOperation(), valueMap, timeMap, scheduleList, 1);
 }
@@ -829,7 +816,7 @@ bool handshake::JoinOp::tryExecute(
     llvm::DenseMap<mlir::Value, llvm::Any> &valueMap,
     llvm::DenseMap<unsigned, unsigned> &memoryMap,
     llvm::DenseMap<mlir::Value, double> &timeMap,
-    std::vector<std::vector<llvm::Any>> &store,
+    std::vector<MemRefBuffer> &store,
     std::vector<mlir::Value> &scheduleList) {
   return tryToExecute(getOperation(), valueMap, timeMap, scheduleList, 1);
 }
@@ -0,0 +1,217 @@
+//===- MemRefBuffer.cpp - Contents of simulated memrefs -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the storage of the memrefs allocated when simulating
+// the standard and handshake dialects.
+//
+//===----------------------------------------------------------------------===//
+
+#include "circt/Dialect/Handshake/MemRefBuffer.h"
+#include "mlir/IR/BuiltinTypes.h"
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+
+using namespace circt;
+using namespace circt::handshake;
+using namespace llvm;
+
+MemRefBuffer::MemRefBuffer(mlir::Type elementType, size_t size)
+    : MemRefBuffer(elementType, size, nullptr) {
+  if (!elementSize)
+    llvm_unreachable("Unknown result type!\n");
+  owned.resize(size * elementSize);
+  data = owned.data();
+}
+
+Expected<MemRefBuffer> MemRefBuffer::readFile(mlir::Type elementType,
+                                              size_t size, StringRef path,
+                                              bool map) {
+  unsigned elementSize = getElementSize(elementType);
+  if (!elementSize)
+    return createStringError(inconvertibleErrorCode(),
+                             "memrefs of this element type can not be read");
+  uint64_t bytes = size * elementSize;
+  uint64_t fileSize;
+  if (auto ec = sys::fs::file_size(path, fileSize))
+    return createFileError(path, ec);
+  if (fileSize != bytes)
+    return createStringError(inconvertibleErrorCode(),
+                             "'%s' has %llu bytes, but the memref needs %llu",
+                             path.str().c_str(),
+                             static_cast<unsigned long long>(fileSize),
+                             static_cast<unsigned long long>(bytes));
+
+  MemRefBuffer buffer(elementType, size, nullptr);
+  if (map && bytes > 0) {
+    int fd;
+    if (auto ec = sys::fs::openFileForRead(path, fd))
+      return createFileError(path, ec);
+    std::error_code ec;
+    buffer.mapping = std::make_unique<sys::fs::mapped_file_region>(
+        sys::fs::convertFDToNativeFile(fd),
+        sys::fs::mapped_file_region::priv, bytes, 0, ec);
+    sys::Process::SafelyCloseFileDescriptor(fd);
+    if (ec)
+      return createFileError(path, ec);
+    buffer.data = reinterpret_cast<uint8_t *>(buffer.mapping->data());
+    return std::move(buffer);
+  }
+
+  auto file = MemoryBuffer::getFile(path, /*FileSize=*/-1,
+                                    /*RequiresNullTerminator=*/false);
+  if (!file)
+    return createFileError(path, file.getError());
+  buffer.owned.assign((*file)->getBufferStart(), (*file)->getBufferEnd());
+  buffer.data = buffer.owned.data();
+  return std::move(buffer);
+}
+
+Error MemRefBuffer::writeFile(StringRef path) const {
+  std::error_code ec;
+  raw_fd_ostream os(path, ec, sys::fs::OF_None);
+  if (ec)
+    return createFileError(path, ec);
+  os.write(reinterpret_cast<const char *>(data), numElements * elementSize);
+  os.close();
+  if (os.has_error())
+    return createFileError(path, os.error());
+  return Error::success();
+}
+
+unsigned MemRefBuffer::getElementSize(mlir::Type elementType) {
+  if (!elementType.isIntOrFloat())
+    return 0;
+  unsigned width = elementType.getIntOrFloatBitWidth();
+  if (width <= 8)
+    return 1;
+  if (width <= 16)
+    return 2;
+  if (width <= 32)
+    return 4;
+  return alignTo(width, 64) / 8;
+}
+
+Any MemRefBuffer::get(size_t i) const {
+  // Floats are returned in the semantics of their type, like the scalars of
+  // the interpreter, which can not mix them in arithmetic.
+  if (elementType.isF32()) {
+    float value;
+    std::memcpy(&value, getElement(i), sizeof(value));
+    return APFloat(value);
+  }
+  unsigned width = elementType.getIntOrFloatBitWidth();
+  APInt bits;
+  if (elementSize <= 8) {
+    bits = APInt(width, getBits(i));
+  } else {
+    SmallVector<uint64_t, 4> words(elementSize / 8);
+    std::memcpy(words.data(), getElement(i), elementSize);
+    bits = APInt(width, words);
+  }
+  if (auto floatType = elementType.dyn_cast<mlir::FloatType>())
+    return APFloat(floatType.getFloatSemantics(), bits);
+  return bits;
+}
+
+void MemRefBuffer::set(size_t i, const Any &value) {
+  APInt bits;
+  if (auto floatType = elementType.dyn_cast<mlir::FloatType>()) {
+    APFloat apfloat = any_cast<APFloat>(value);
+    bool losesInfo;
+    apfloat.convert(floatType.getFloatSemantics(),
+                    APFloat::rmNearestTiesToEven, &losesInfo);
+    if (elementType.isF32()) {
+      float f = apfloat.convertToFloat();
+      std::memcpy(getElement(i), &f, sizeof(f));
+      return;
+    }
+    bits = apfloat.bitcastToAPInt();
+  } else {
+    bits = any_cast<APInt>(value).zextOrTrunc(
+        elementType.getIntOrFloatBitWidth());
+  }
+  if (elementSize <= 8)
+    setBits(i, bits.getZExtValue());
+  else
+    std::memcpy(getElement(i), bits.getRawData(), elementSize);
+}
+
+uint64_t MemRefBuffer::getBits(size_t i) const {
+  uint8_t *element = getElement(i);
+  if (elementType.isF32()) {
+    float f;
+    std::memcpy(&f, element, sizeof(f));
+    double d = f;
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    return bits;
+  }
+  // The bits of a file beyond the width of the integers are ignored.
+  uint64_t bits;
+  switch (elementSize) {
+  case 1:
+    bits = *element;
+    break;
+  case 2: {
+    uint16_t narrow;
+    std::memcpy(&narrow, element, sizeof(narrow));
+    bits = narrow;
+    break;
+  }
+  case 4: {
+    uint32_t narrow;
+    std::memcpy(&narrow, element, sizeof(narrow));
+    bits = narrow;
+    break;
+  }
+  case 8:
+    std::memcpy(&bits, element, sizeof(bits));
+    break;
+  default:
+    llvm_unreachable("element wider than 64 bits");
+  }
+  if (elementType.isF64())
+    return bits;
+  return bits & maskTrailingOnes<uint64_t>(elementType.getIntOrFloatBitWidth());
+}
+
+void MemRefBuffer::setBits(size_t i, uint64_t bits) {
+  uint8_t *element = getElement(i);
+  if (elementType.isF32()) {
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    float f = d;
+    std::memcpy(element, &f, sizeof(f));
+    return;
+  }
+  switch (elementSize) {
+  case 1:
+    *element = bits;
+    return;
+  case 2: {
+    uint16_t narrow = bits;
+    std::memcpy(element, &narrow, sizeof(narrow));
+    return;
+  }
+  case 4: {
+    uint32_t narrow = bits;
+    std::memcpy(element, &narrow, sizeof(narrow));
+    return;
+  }
+  case 8:
+    std::memcpy(element, &bits, sizeof(bits));
+    return;
+  }
+  llvm_unreachable("element wider than 64 bits");
+}
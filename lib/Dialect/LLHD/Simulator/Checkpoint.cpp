@@ -0,0 +1,331 @@
+//===- Checkpoint.cpp - Simulation state checkpoints ----------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements saving the simulation state to a binary checkpoint and
+// restoring it.
+//
+// A checkpoint is a sequence of little-endian 64-bit words, with raw byte
+// arrays padded to a multiple of 8 bytes, such that all the words are aligned
+// when the file is memory mapped:
+//
+//   checkpoint ::= "LLHDCKPT" version layout-hash time
+//                  num-signals num-instances num-slots
+//                  signal* instance* slot*
+//   time       ::= real delta epsilon
+//   signal     ::= size bytes
+//   instance   ::= expected-wakeup state-size
+//                  (resume num-senses senses persistence | entity-state)?
+//   slot       ::= time num-changes num-buffers num-words num-scheduled
+//                  (signal buffer-index)* (bit-offset width value)* word*
+//                  instance*
+//
+// The layout hash identifies the design the checkpoint was taken from. Signal
+// pointers persisted by processes are stored relative to the start of their
+// signal, and relocated when restoring.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Checkpoint.h"
+
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <cstddef>
+#include <cstring>
+
+using namespace llvm;
+using namespace circt::llhd::sim;
+
+static constexpr char magic[] = "LLHDCKPT";
+static constexpr uint64_t version = 1;
+/// The offset of the persisted values in a process state.
+static constexpr size_t procHeaderSize = offsetof(ProcState, resumeState);
+/// Marker for persisted signals not pointing into a signal yet.
+static constexpr uint64_t invalidSignal = ~0ULL;
+
+/// Return a hash of the instance and signal layout of the design.
+static uint64_t getLayoutHash(const State &state) {
+  std::string layout;
+  raw_string_ostream os(layout);
+  for (auto &inst : state.instances)
+    os << inst.path << ' ' << inst.unit << ' ' << inst.stateSize << ' '
+       << inst.sensitivityList.size() << ';';
+  for (auto &sig : state.signals)
+    os << sig.owner << '/' << sig.name << ' ' << sig.size << ';';
+  return xxHash64(os.str());
+}
+
+//===----------------------------------------------------------------------===//
+// Checkpoint writing
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct CheckpointWriter {
+  CheckpointWriter(raw_ostream &os) : os(os), writer(os, support::little) {}
+
+  void word(uint64_t value) { writer.write<uint64_t>(value); }
+
+  void time(const Time &time) {
+    word(time.time);
+    word(time.delta);
+    word(time.eps);
+  }
+
+  void bytes(const uint8_t *data, size_t size) {
+    os.write(reinterpret_cast<const char *>(data), size);
+    os.write_zeros(alignTo(size, 8) - size);
+  }
+
+  raw_ostream &os;
+  support::endian::Writer writer;
+};
+} // namespace
+
+void circt::llhd::sim::writeCheckpoint(const State &state, raw_ostream &os) {
+  CheckpointWriter w(os);
+
+  size_t numSlots = 0;
+  state.queue.forEachSlot([&](const Slot &) { ++numSlots; });
+
+  os.write(magic, 8);
+  w.word(version);
+  w.word(getLayoutHash(state));
+  w.time(state.time);
+  w.word(state.signals.size());
+  w.word(state.instances.size());
+  w.word(numSlots);
+
+  for (auto &sig : state.signals) {
+    w.word(sig.size);
+    w.bytes(sig.value, sig.size);
+  }
+
+  SmallVector<uint8_t, 64> persistence;
+  for (auto &inst : state.instances) {
+    w.time(inst.expectedWakeup);
+    w.word(inst.stateSize);
+    if (inst.procState && inst.stateSize >= procHeaderSize) {
+      w.word(inst.procState->resume);
+      w.word(inst.sensitivityList.size());
+      w.bytes(reinterpret_cast<const uint8_t *>(inst.procState->senses),
+              inst.sensitivityList.size());
+
+      // Replace the pointers of the persisted signals by their offset in the
+      // signal.
+      auto *bytes = reinterpret_cast<const uint8_t *>(inst.procState.get());
+      persistence.assign(bytes + procHeaderSize, bytes + inst.stateSize);
+      for (auto offset : inst.persistedSignals) {
+        SignalDetail detail;
+        auto *field = persistence.data() + offset - procHeaderSize;
+        std::memcpy(&detail, field, sizeof(detail));
+        uint64_t relative = invalidSignal;
+        if (detail.globalIndex < state.signals.size()) {
+          auto &sig = state.signals[detail.globalIndex];
+          if (detail.value >= sig.value &&
+              detail.value < sig.value + 2 * sig.size)
+            relative = detail.value - sig.value;
+        }
+        support::endian::write64le(field, relative);
+      }
+      w.bytes(persistence.data(), persistence.size());
+    } else if (inst.entityState) {
+      w.bytes(inst.entityState.get(), inst.stateSize);
+    }
+  }
+
+  state.queue.forEachSlot([&](const Slot &slot) {
+    w.time(slot.time);
+    w.word(slot.changes.size());
+    w.word(slot.buffers.size());
+    w.word(slot.words.size());
+    w.word(slot.scheduled.size());
+    for (auto change : slot.changes) {
+      w.word(change.first);
+      w.word(change.second);
+    }
+    for (auto &buffer : slot.buffers) {
+      w.word(buffer.bitOffset);
+      w.word(buffer.width);
+      w.word(buffer.value);
+    }
+    for (auto word : slot.words)
+      w.word(word);
+    for (auto inst : slot.scheduled)
+      w.word(inst);
+  });
+}
+
+//===----------------------------------------------------------------------===//
+// Checkpoint reading
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct CheckpointReader {
+  CheckpointReader(StringRef data) : data(data) {}
+
+  bool word(uint64_t &value) {
+    if (data.size() < 8)
+      return false;
+    value = support::endian::read64le(data.data());
+    data = data.drop_front(8);
+    return true;
+  }
+
+  bool time(Time &time) {
+    return word(time.time) && word(time.delta) && word(time.eps);
+  }
+
+  /// Return a pointer to the next `size` bytes, or null if the checkpoint is
+  /// too short.
+  const uint8_t *bytes(uint64_t size) {
+    auto padded = alignTo(size, 8);
+    if (data.size() < padded)
+      return nullptr;
+    auto *ptr = reinterpret_cast<const uint8_t *>(data.data());
+    data = data.drop_front(padded);
+    return ptr;
+  }
+
+  StringRef data;
+};
+} // namespace
+
+static Error makeError(const Twine &message) {
+  return createStringError(inconvertibleErrorCode(), message);
+}
+
+Error circt::llhd::sim::readCheckpoint(State &state, MemoryBufferRef buffer) {
+  assert(state.queue.empty() && "the event queue has to be empty");
+  CheckpointReader r(buffer.getBuffer());
+  auto truncated = [&]() {
+    return makeError("truncated checkpoint '" + buffer.getBufferIdentifier() +
+                     "'");
+  };
+  auto mismatch = [&]() {
+    return makeError("checkpoint '" + buffer.getBufferIdentifier() +
+                     "' was taken from a different design");
+  };
+
+  const uint8_t *bytes;
+  uint64_t word, numSignals, numInstances, numSlots;
+  if (!(bytes = r.bytes(8)) || std::memcmp(bytes, magic, 8) != 0)
+    return makeError("'" + buffer.getBufferIdentifier() +
+                     "' is not an llhd-sim checkpoint");
+  if (!r.word(word))
+    return truncated();
+  if (word != version)
+    return makeError("unsupported checkpoint version " + Twine(word));
+  if (!r.word(word))
+    return truncated();
+  if (word != getLayoutHash(state))
+    return mismatch();
+  if (!r.time(state.time) || !r.word(numSignals) || !r.word(numInstances) ||
+      !r.word(numSlots))
+    return truncated();
+  if (numSignals != state.signals.size() ||
+      numInstances != state.instances.size())
+    return mismatch();
+
+  for (auto &sig : state.signals) {
+    if (!r.word(word))
+      return truncated();
+    if (word != sig.size)
+      return mismatch();
+    if (!(bytes = r.bytes(sig.size)))
+      return truncated();
+    std::memcpy(sig.value, bytes, sig.size);
+  }
+
+  for (auto &inst : state.instances) {
+    if (!r.time(inst.expectedWakeup) || !r.word(word))
+      return truncated();
+    if (word != inst.stateSize)
+      return mismatch();
+    if (inst.procState && inst.stateSize >= procHeaderSize) {
+      uint64_t resume, numSenses;
+      if (!r.word(resume) || !r.word(numSenses))
+        return truncated();
+      if (numSenses != inst.sensitivityList.size())
+        return mismatch();
+      if (!(bytes = r.bytes(numSenses)))
+        return truncated();
+      inst.procState->resume = resume;
+      std::memcpy(inst.procState->senses, bytes, numSenses);
+
+      auto persistenceSize = inst.stateSize - procHeaderSize;
+      if (!(bytes = r.bytes(persistenceSize)))
+        return truncated();
+      auto *procBytes = reinterpret_cast<uint8_t *>(inst.procState.get());
+      std::memcpy(procBytes + procHeaderSize, bytes, persistenceSize);
+
+      // Relocate the persisted signals into the restored signals.
+      for (auto offset : inst.persistedSignals) {
+        SignalDetail detail;
+        std::memcpy(&detail, procBytes + offset, sizeof(detail));
+        uint64_t relative = reinterpret_cast<uint64_t>(detail.value);
+        if (relative == invalidSignal)
+          continue;
+        if (detail.globalIndex >= state.signals.size() ||
+            relative >= 2 * state.signals[detail.globalIndex].size)
+          return mismatch();
+        detail.value = state.signals[detail.globalIndex].value + relative;
+        std::memcpy(procBytes + offset, &detail, sizeof(detail));
+      }
+    } else if (inst.entityState) {
+      if (!(bytes = r.bytes(inst.stateSize)))
+        return truncated();
+      std::memcpy(inst.entityState.get(), bytes, inst.stateSize);
+    }
+  }
+
+  for (uint64_t i = 0; i < numSlots; ++i) {
+    Time time;
+    uint64_t numChanges, numBuffers, numWords, numScheduled;
+    if (!r.time(time) || !r.word(numChanges) || !r.word(numBuffers) ||
+        !r.word(numWords) || !r.word(numScheduled))
+      return truncated();
+
+    auto &slot = state.queue.getOrCreateSlot(time);
+    for (uint64_t j = 0; j < numChanges; ++j) {
+      uint64_t sigIndex, bufferIndex;
+      if (!r.word(sigIndex) || !r.word(bufferIndex))
+        return truncated();
+      if (sigIndex >= state.signals.size() || bufferIndex >= numBuffers)
+        return mismatch();
+      slot.changes.push_back(std::make_pair(sigIndex, bufferIndex));
+    }
+    for (uint64_t j = 0; j < numBuffers; ++j) {
+      Change change;
+      if (!r.word(change.bitOffset) || !r.word(change.width) ||
+          !r.word(change.value))
+        return truncated();
+      // Wide values have to lie within the slot's word arena.
+      if (change.width > 64 &&
+          (change.value > numWords ||
+           numWords - change.value < alignTo(change.width, 64) / 64))
+        return mismatch();
+      slot.buffers.push_back(change);
+    }
+    for (uint64_t j = 0; j < numWords; ++j) {
+      if (!r.word(word))
+        return truncated();
+      slot.words.push_back(word);
+    }
+    for (uint64_t j = 0; j < numScheduled; ++j) {
+      if (!r.word(word))
+        return truncated();
+      if (word >= state.instances.size())
+        return mismatch();
+      slot.scheduled.push_back(word);
+    }
+  }
+
+  return Error::success();
+}
@@ -0,0 +1,48 @@
+//===- Checkpoint.h - Simulation state checkpoints --------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the functions used to save the simulation state to a
+// binary checkpoint and to restore it.
+//
+//===----------------------------------------------------------------------===//
+
+// clang-tidy seems to expect the absolute path in the header guard on some
+// systems, so just disable it.
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef CIRCT_DIALECT_LLHD_SIMULATOR_CHECKPOINT_H
+#define CIRCT_DIALECT_LLHD_SIMULATOR_CHECKPOINT_H
+
+#include "State.h"
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+namespace circt {
+namespace llhd {
+namespace sim {
+
+/// Write the current simulation time, signal values, process and entity
+/// states and pending events to a checkpoint. The state has to be in between
+/// two simulation steps.
+void writeCheckpoint(const State &state, llvm::raw_ostream &os);
+
+/// Restore a checkpoint written by `writeCheckpoint` into a freshly
+/// initialized state of the same design. The event queue has to be empty. Fails
+/// if the checkpoint is truncated or any of its counts or indices does not fit
+/// the design.
+llvm::Error readCheckpoint(State &state, llvm::MemoryBufferRef buffer);
+
+} // namespace sim
+} // namespace llhd
+} // namespace circt
+
+#endif // CIRCT_DIALECT_LLHD_SIMULATOR_CHECKPOINT_H
@@ -10,30 +10,162 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "Checkpoint.h"
+#include "Levelize.h"
+#include "ParallelCompile.h"
+#include "Profile.h"
 #include "State.h"
 #include "Trace.h"
+#include "signals-runtime-wrappers.h"
 
 #include "circt/Conversion/LLHDToLLVM/LLHDToLLVM.h"
 #include "circt/Dialect/LLHD/Simulator/Engine.h"
 
 #include "mlir/ExecutionEngine/ExecutionEngine.h"
 #include "mlir/IR/Builders.h"
-
+#include "mlir/Target/LLVMIR/Export.h"
+
+#include "llvm/BinaryFormat/Magic.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/Object/Archive.h"
+#include "llvm/Object/ArchiveWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 
 using namespace circt::llhd::sim;
 
+/// The size of the drive log of each worker, in bytes.
+static constexpr uint64_t driveLogSize = 1 << 16;
+/// The number of passes over the levels of the design after which the
+/// combinational loops of a delta cycle are considered not to settle in
+/// levelized mode.
+static constexpr unsigned maxSettlePasses = 64;
+
+namespace {
+/// A range of indices in the wakeup queue owned by one worker. The owner takes
+/// work from the front of the range, while idle workers steal its back half.
+/// Both ends are packed in a single atomic word, the begin in the upper 32
+/// bits, such that both operations are a single compare-and-swap.
+class WorkRange {
+public:
+  /// Replace the range. Only called by the owner.
+  void reset(uint32_t begin, uint32_t end) { range.store(pack(begin, end)); }
+
+  /// Take the first index of the range. Returns false if the range is empty.
+  bool pop(uint32_t &index) {
+    uint64_t curr = range.load();
+    while (true) {
+      uint32_t begin = curr >> 32, end = curr;
+      if (begin >= end)
+        return false;
+      if (range.compare_exchange_weak(curr, pack(begin + 1, end))) {
+        index = begin;
+        return true;
+      }
+    }
+  }
+
+  /// Take the back half of the range. Returns false if the range is empty.
+  bool steal(uint32_t &stolenBegin, uint32_t &stolenEnd) {
+    uint64_t curr = range.load();
+    while (true) {
+      uint32_t begin = curr >> 32, end = curr;
+      if (begin >= end)
+        return false;
+      uint32_t mid = begin + (end - begin) / 2;
+      if (range.compare_exchange_weak(curr, pack(begin, mid))) {
+        stolenBegin = mid;
+        stolenEnd = end;
+        return true;
+      }
+    }
+  }
+
+private:
+  static uint64_t pack(uint32_t begin, uint32_t end) {
+    return (uint64_t(begin) << 32) | end;
+  }
+
+  std::atomic<uint64_t> range{0};
+};
+} // namespace
+
+/// Evaluate the given instances on the worker pool. The wakeup queue is split
+/// in one contiguous range per worker, and workers running out of work steal
+/// from the others. Each worker records the events issued by the instances it
+/// evaluates in its own drive buffer. The run function is called with the
+/// index of the instance and of the worker evaluating it.
+static void evaluateParallel(llvm::ThreadPool &pool,
+                             llvm::ArrayRef<unsigned> wakeupQueue,
+                             llvm::MutableArrayRef<DriveBuffer> buffers,
+                             WorkRange *ranges,
+                             llvm::function_ref<void(unsigned, unsigned)> run) {
+  size_t size = wakeupQueue.size();
+  unsigned numWorkers = std::min<size_t>(buffers.size(), size);
+  for (unsigned w = 0; w < numWorkers; ++w)
+    ranges[w].reset(w * size / numWorkers, (w + 1) * size / numWorkers);
+
+  for (unsigned w = 0; w < numWorkers; ++w) {
+    pool.async([&, w] {
+      auto &buffer = buffers[w];
+      setDriveBuffer(&buffer);
+      while (true) {
+        uint32_t index;
+        while (ranges[w].pop(index)) {
+          buffer.beginInstance(wakeupQueue[index]);
+          run(wakeupQueue[index], w);
+        }
+
+        // Look for a victim to steal work from, and stop when all the other
+        // ranges are empty.
+        uint32_t begin, end;
+        bool stolen = false;
+        for (unsigned v = 1; v < numWorkers && !stolen; ++v)
+          stolen = ranges[(w + v) % numWorkers].steal(begin, end);
+        if (!stolen)
+          break;
+        ranges[w].reset(begin, end);
+      }
+      setDriveBuffer(nullptr);
+    });
+  }
+  pool.wait();
+}
+
 Engine::Engine(
     llvm::raw_ostream &out, ModuleOp module,
     llvm::function_ref<mlir::LogicalResult(mlir::ModuleOp)> mlirTransformer,
     llvm::function_ref<llvm::Error(llvm::Module *)> llvmTransformer,
-    std::string root, int mode)
+    std::string root, int mode, llvm::StringRef objectCachePath,
+    unsigned numCompileThreads)
     : out(out), root(root), traceMode(mode) {
   state = std::make_unique<State>();
   state->root = root + '.' + root;
 
   buildLayout(module);
 
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  // Skip the lowering and code generation if the design has been compiled by
+  // a previous run.
+  if (!objectCachePath.empty() && llvm::sys::fs::exists(objectCachePath)) {
+    this->module = module;
+    auto err = loadCachedObject(objectCachePath);
+    if (!err)
+      return;
+    llvm::errs() << "Ignoring the cached object " << objectCachePath << ": "
+                 << llvm::toString(std::move(err)) << "\n";
+  }
+
   auto rootEntity = module.lookupSymbol<EntityOp>(root);
 
   // Insert explicit instantiation of the design root.
@@ -50,34 +182,303 @@ Engine::Engine(
 
   this->module = module;
 
-  llvm::InitializeNativeTarget();
-  llvm::InitializeNativeTargetAsmPrinter();
+  if (numCompileThreads > 1) {
+    if (auto err = compileInParallel(llvmTransformer, numCompileThreads,
+                                     objectCachePath)) {
+      llvm::logAllUnhandledErrors(std::move(err), llvm::errs(),
+                                  "failed to compile the design: ");
+      exit(EXIT_FAILURE);
+    }
+    return;
+  }
+
   auto maybeEngine =
       mlir::ExecutionEngine::create(this->module, nullptr, llvmTransformer);
   assert(maybeEngine && "failed to create JIT");
   engine = std::move(*maybeEngine);
+
+  if (!objectCachePath.empty())
+    saveCachedObject(objectCachePath);
 }
 
+Engine::Engine(llvm::raw_ostream &out, std::string root, int mode)
+    : out(out), root(root), traceMode(mode) {}
+
 Engine::~Engine() = default;
 
+llvm::Expected<std::unique_ptr<Engine>>
+Engine::clone(llvm::raw_ostream &out) const {
+  std::unique_ptr<Engine> clone(new Engine(out, root, traceMode));
+  clone->state = state->cloneLayout();
+  clone->engine = engine;
+  clone->objectJIT = objectJIT;
+  clone->module = module;
+  clone->numThreads = numThreads;
+  clone->levelized = levelized;
+  clone->traceFilters = traceFilters;
+  if (failed(clone->initialize()))
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "failed to initialize the design");
+  return std::move(clone);
+}
+
+/// Create a JIT resolving the runtime library calls in the simulator process,
+/// as done by the mlir::ExecutionEngine.
+static llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> createObjectJIT() {
+  auto jit = llvm::orc::LLJITBuilder().create();
+  if (!jit)
+    return jit.takeError();
+
+  auto generator =
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          (*jit)->getDataLayout().getGlobalPrefix());
+  if (!generator)
+    return generator.takeError();
+  (*jit)->getMainJITDylib().addGenerator(std::move(*generator));
+  return jit;
+}
+
+llvm::Error Engine::compileInParallel(
+    llvm::function_ref<llvm::Error(llvm::Module *)> llvmTransformer,
+    unsigned numCompileThreads, llvm::StringRef objectCachePath) {
+  llvm::LLVMContext llvmContext;
+  auto llvmModule = mlir::translateModuleToLLVMIR(module, llvmContext);
+  if (!llvmModule)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "failed to translate the design to LLVM IR");
+
+  auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!jtmb)
+    return jtmb.takeError();
+  auto dataLayout = jtmb->getDefaultDataLayoutForTarget();
+  if (!dataLayout)
+    return dataLayout.takeError();
+  llvmModule->setDataLayout(*dataLayout);
+  llvmModule->setTargetTriple(jtmb->getTargetTriple().str());
+  packFunctionArguments(*llvmModule);
+
+  auto objects = circt::llhd::sim::compileInParallel(
+      *llvmModule, *jtmb, llvmTransformer, numCompileThreads);
+  if (!objects)
+    return objects.takeError();
+  if (!objectCachePath.empty())
+    saveCachedObject(objectCachePath, *objects);
+
+  auto jit = createObjectJIT();
+  if (!jit)
+    return jit.takeError();
+  for (auto &object : *objects)
+    if (auto err = (*jit)->addObjectFile(std::move(object)))
+      return err;
+  objectJIT = std::move(*jit);
+  return llvm::Error::success();
+}
+
+llvm::Error Engine::loadCachedObject(llvm::StringRef path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return llvm::createFileError(path, buffer.getError());
+
+  auto jit = createObjectJIT();
+  if (!jit)
+    return jit.takeError();
+
+  // Designs compiled in parallel are cached as an archive of the objects of
+  // their partitions.
+  if (llvm::identify_magic((*buffer)->getBuffer()) ==
+      llvm::file_magic::archive) {
+    auto archive = llvm::object::Archive::create((*buffer)->getMemBufferRef());
+    if (!archive)
+      return llvm::createFileError(path, archive.takeError());
+    llvm::Error err = llvm::Error::success();
+    for (auto &child : (*archive)->children(err)) {
+      auto member = child.getMemoryBufferRef();
+      if (!member)
+        return llvm::createFileError(path, member.takeError());
+      if (auto addErr = (*jit)->addObjectFile(
+              llvm::MemoryBuffer::getMemBufferCopy(
+                  member->getBuffer(), member->getBufferIdentifier())))
+        return addErr;
+    }
+    if (err)
+      return llvm::createFileError(path, std::move(err));
+  } else if (auto err = (*jit)->addObjectFile(std::move(*buffer))) {
+    return err;
+  }
+  objectJIT = std::move(*jit);
+
+  // Make sure the object actually holds a design.
+  auto init = lookupPacked("llhd_init");
+  if (!init) {
+    objectJIT.reset();
+    return init.takeError();
+  }
+  return llvm::Error::success();
+}
+
+void Engine::saveCachedObject(
+    llvm::StringRef path,
+    llvm::ArrayRef<std::unique_ptr<llvm::MemoryBuffer>> objects) {
+  // Write to a temporary file first, such that concurrent runs never load a
+  // partially written object.
+  std::string tmpPath =
+      (path + ".tmp" + llvm::Twine(llvm::sys::Process::getProcessId())).str();
+
+  if (objects.empty()) {
+    // The design is compiled lazily, force it such that the object is cached.
+    auto init = lookupPacked("llhd_init");
+    if (!init) {
+      llvm::consumeError(init.takeError());
+      return;
+    }
+    engine->dumpToObjectFile(tmpPath);
+  } else {
+    std::vector<llvm::NewArchiveMember> members;
+    for (auto &object : objects)
+      members.emplace_back(object->getMemBufferRef());
+    if (auto err = llvm::writeArchive(tmpPath, members, /*WriteSymtab=*/false,
+                                      llvm::object::Archive::K_GNU,
+                                      /*Deterministic=*/true, /*Thin=*/false)) {
+      llvm::consumeError(std::move(err));
+      llvm::sys::fs::remove(tmpPath);
+      return;
+    }
+  }
+  if (llvm::sys::fs::rename(tmpPath, path))
+    llvm::sys::fs::remove(tmpPath);
+}
+
+llvm::Expected<void (*)(void **)> Engine::lookupPacked(llvm::StringRef name) {
+  if (engine)
+    return engine->lookup(name);
+
+  auto symbol = objectJIT->lookup(("_mlir_" + name).str());
+  if (!symbol)
+    return symbol.takeError();
+  return reinterpret_cast<void (*)(void **)>(symbol->getAddress());
+}
+
 void Engine::dumpStateLayout() { state->dumpLayout(); }
 
 void Engine::dumpStateSignalTriggers() { state->dumpSignalTriggers(); }
 
+void Engine::dumpQueueStatistics(llvm::raw_ostream &os) {
+  const auto &stats = state->queue.getStatistics();
+  os << "::------------- Queue statistics -------------::\n";
+  os << "slots created: " << stats.slotsCreated << "\n";
+  os << "max pending slots: " << stats.maxPending << "\n";
+  os << "current step inserts: " << stats.nearInserts << "\n";
+  os << "timing wheel inserts: " << stats.wheelInserts << "\n";
+  os << "overflow inserts: " << stats.overflowInserts << "\n";
+  os << "wheel cascades: " << stats.cascades << "\n";
+  os << "drives: " << stats.drives << "\n";
+  if (wallTime > 0)
+    os << "drives per second: "
+       << llvm::format("%.0f", stats.drives / wallTime) << "\n";
+  os << "::--------------------------------------------::\n";
+}
+
+void Engine::dumpProfile(llvm::raw_ostream &os) {
+  if (profiler)
+    profiler->printReport(os);
+}
+
+llvm::Error Engine::writeProfileTrace(llvm::StringRef path) {
+  if (!profiler)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "no profile was recorded");
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_Text);
+  if (ec)
+    return llvm::createFileError(path, ec);
+  profiler->writeChromeTrace(os);
+  os.close();
+  if (os.has_error())
+    return llvm::createFileError(path, os.error());
+  return llvm::Error::success();
+}
+
+llvm::Error Engine::setTraceFilters(ArrayRef<std::string> filters) {
+  traceFilters.clear();
+  for (auto &filter : filters) {
+    auto pattern = llvm::GlobPattern::create(filter);
+    if (!pattern)
+      return pattern.takeError();
+    traceFilters.push_back(std::move(*pattern));
+  }
+  return llvm::Error::success();
+}
+
+mlir::LogicalResult Engine::initialize() {
+  SmallVector<void *, 1> arg({&state});
+  // Initialize tbe simulation state.
+  auto init = lookupPacked("llhd_init");
+  if (!init) {
+    llvm::errs() << "Failed invocation of llhd_init: "
+                 << llvm::toString(init.takeError()) << "\n";
+    return mlir::failure();
+  }
+  (*init)(arg.data());
+  state->allocateSignalArena();
+  initialized = true;
+
+  // Keep a snapshot of the initial state to reset to.
+  initialSnapshot.clear();
+  llvm::raw_string_ostream os(initialSnapshot);
+  writeCheckpoint(*state, os);
+  os.flush();
+  return mlir::success();
+}
+
+llvm::Error Engine::reset() {
+  restored = false;
+  if (!initialized)
+    return llvm::Error::success();
+
+  state->queue = UpdateQueue();
+  return readCheckpoint(*state,
+                        llvm::MemoryBufferRef(initialSnapshot, "initial state"));
+}
+
+llvm::Error Engine::saveCheckpoint(llvm::StringRef path) {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_None);
+  if (ec)
+    return llvm::createFileError(path, ec);
+  writeCheckpoint(*state, os);
+  os.close();
+  if (os.has_error())
+    return llvm::createFileError(path, os.error());
+  return llvm::Error::success();
+}
+
+llvm::Error Engine::restoreCheckpoint(llvm::StringRef path) {
+  if (!initialized && failed(initialize()))
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "failed to initialize the design");
+  if (!state->queue.empty())
+    return llvm::createStringError(
+        llvm::inconvertibleErrorCode(),
+        "checkpoints can only be restored before simulating");
+
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return llvm::createFileError(path, buffer.getError());
+  if (auto err = readCheckpoint(*state, (*buffer)->getMemBufferRef()))
+    return err;
+  restored = true;
+  return llvm::Error::success();
+}
+
 int Engine::simulate(int n, uint64_t maxTime) {
-  assert(engine && "engine not found");
+  assert((engine || objectJIT) && "engine not found");
   assert(state && "state not found");
 
   auto tm = static_cast<TraceMode>(traceMode);
-  Trace trace(state, out, tm);
+  Trace trace(state, out, tm, traceFilters);
 
-  SmallVector<void *, 1> arg({&state});
-  // Initialize tbe simulation state.
-  auto invocationResult = engine->invokePacked("llhd_init", arg);
-  if (invocationResult) {
-    llvm::errs() << "Failed invocation of llhd_init: " << invocationResult;
+  if (!initialized && failed(initialize()))
     return -1;
-  }
 
   if (traceMode >= 0) {
     // Add changes for all the signals' initial values.
@@ -86,19 +487,60 @@ int Engine::simulate(int n, uint64_t maxTime) {
     }
   }
 
-  // Add a dummy event to get the simulation started.
-  state->queue.push_back(Slot(Time()));
-  ++state->queue.events;
+  // Add a dummy event to get the simulation started, unless resuming from a
+  // checkpoint.
+  if (!restored)
+    state->queue.getOrCreateSlot(Time());
 
   // Keep track of the instances that need to wakeup.
   llvm::SmallVector<unsigned, 8> wakeupQueue;
 
+  // Scratch buffer used to apply the changes to a signal. It is reused across
+  // all the updates, such that it only allocates when growing.
+  llvm::SmallVector<uint8_t, 64> buff;
+
+  // Set up the workers used to evaluate the woken up instances in parallel.
+  std::unique_ptr<llvm::ThreadPool> pool;
+  llvm::SmallVector<DriveBuffer, 8> driveBuffers;
+  std::unique_ptr<WorkRange[]> workRanges;
+  if (numThreads > 1) {
+    pool = std::make_unique<llvm::ThreadPool>(
+        llvm::hardware_concurrency(numThreads));
+    driveBuffers.resize(numThreads);
+    workRanges = std::make_unique<WorkRange[]>(numThreads);
+  }
+
+  // In levelized mode, the woken up instances are evaluated level by level,
+  // always recording their events, such that the drives settling within the
+  // current delta cycle can be applied before evaluating the next level.
+  std::unique_ptr<Levelization> levelization;
+  std::vector<std::pair<unsigned, unsigned>> pending;
+  llvm::BitVector queued;
+  if (levelized) {
+    levelization = std::make_unique<Levelization>(*state);
+    queued.resize(state->instances.size());
+    if (driveBuffers.empty())
+      driveBuffers.resize(1);
+  }
+
+  // Set up the drive log of each worker, for the units lowered with drive
+  // logs. The words back the logs with 8-byte aligned storage.
+  llvm::SmallVector<llvm::SmallVector<uint64_t, 0>, 8> driveLogWords(
+      numThreads);
+  llvm::SmallVector<DriveLog, 8> driveLogs(numThreads);
+  for (unsigned i = 0; i < numThreads; ++i) {
+    driveLogWords[i].resize(driveLogSize / 8);
+    driveLogs[i] = {reinterpret_cast<uint8_t *>(driveLogWords[i].data()), 0,
+                    driveLogSize};
+  }
+
   // Add all instances to the wakeup queue for the first run and add the jitted
   // function pointers to all of the instances to make them readily available.
   for (size_t i = 0, e = state->instances.size(); i < e; ++i) {
-    wakeupQueue.push_back(i);
+    if (!restored)
+      wakeupQueue.push_back(i);
     auto &inst = state->instances[i];
-    auto expectedFPtr = engine->lookup(inst.unit);
+    auto expectedFPtr = lookupPacked(inst.unit);
     if (!expectedFPtr) {
       llvm::errs() << "Could not lookup " << inst.unit << "!\n";
       return -1;
@@ -106,10 +548,118 @@ int Engine::simulate(int n, uint64_t maxTime) {
     inst.unitFPtr = *expectedFPtr;
   }
 
+  // Run an instance on the given worker, timing it if profiling.
+  if (profiling)
+    profiler = std::make_unique<Profiler>(*state, numThreads);
+  auto run = [&](unsigned i, unsigned worker) {
+    if (!profiler) {
+      runInstance(state->instances[i], driveLogs[worker]);
+      return;
+    }
+    auto begin = Profiler::Clock::now();
+    runInstance(state->instances[i], driveLogs[worker]);
+    profiler->recordInstance(i, worker, begin, Profiler::Clock::now());
+  };
+
+  // Add an instance to the wakeup queue, or to the pending instances ordered by
+  // level in levelized mode.
+  auto wakeup = [&](unsigned i) {
+    if (!levelization) {
+      wakeupQueue.push_back(i);
+      return;
+    }
+    if (queued.test(i))
+      return;
+    queued.set(i);
+    pending.push_back(std::make_pair(levelization->levels[i], i));
+    std::push_heap(pending.begin(), pending.end(), std::greater<>());
+  };
+
+  // Wake up the instances sensitive to a signal that just changed, and dump
+  // it. In levelized mode, entities are only woken up by the signals they
+  // probe.
+  auto signalChanged = [&](unsigned sigIndex) {
+    if (profiler)
+      profiler->recordSignalChange(sigIndex);
+
+    if (levelization)
+      for (auto i : levelization->readers[sigIndex])
+        wakeup(i);
+    for (auto trigger : state->getTriggers(sigIndex)) {
+      auto &inst = state->instances[trigger.inst];
+      if (inst.isEntity) {
+        if (!levelization)
+          wakeup(trigger.inst);
+        continue;
+      }
+
+      // Skip if the process is not currently sensible to the signal.
+      if (!inst.procState->senses[trigger.slot])
+        continue;
+
+      // Invalidate scheduled wakeup
+      inst.expectedWakeup = Time();
+      wakeup(trigger.inst);
+    }
+
+    // Dump the updated signal.
+    if (traceMode >= 0)
+      trace.addChange(sigIndex);
+  };
+
+  // Apply a drive recorded in levelized mode right away if it is issued by an
+  // entity onto a combinationally driven signal and lands in the current delta
+  // cycle. Returns false if the drive has to go through the event queue.
+  llvm::SmallVector<uint64_t, 8> driveWords;
+  bool deferDrives = false, reportedLoop = false;
+  auto applyDrive = [&](const DriveBuffer::Entry &entry,
+                        const uint8_t *value) {
+    if (deferDrives || !state->instances[entry.inst].isEntity ||
+        !levelization->combinational.test(entry.sigIndex) ||
+        entry.time.time != state->time.time ||
+        entry.time.delta != state->time.delta)
+      return false;
+
+    auto &sig = state->signals[entry.sigIndex];
+    buff.assign(sig.value, sig.value + sig.size);
+    if (entry.width < sig.size * 8) {
+      driveWords.assign(llvm::divideCeil(entry.width, 64), 0);
+      std::memcpy(driveWords.data(), value, llvm::divideCeil(entry.width, 8));
+      insertBits(buff.data(), sig.size, driveWords.data(), entry.width,
+                 entry.bitOffset);
+    } else {
+      std::memcpy(buff.data(), value, sig.size);
+    }
+    if (std::memcmp(sig.value, buff.data(), sig.size) != 0) {
+      std::memcpy(sig.value, buff.data(), sig.size);
+      signalChanged(entry.sigIndex);
+    }
+    return true;
+  };
+
+  // Order the instances of the first run by level in levelized mode.
+  if (levelization) {
+    auto initial = std::move(wakeupQueue);
+    wakeupQueue.clear();
+    for (auto i : initial)
+      wakeup(i);
+  }
+
+  auto startTime = std::chrono::steady_clock::now();
   int cycle = 0;
   while (state->queue.events > 0) {
     const auto &pop = state->queue.top();
 
+    // Save the requested checkpoint before running the first step at or after
+    // its time.
+    if (checkpointTime && pop.time.time >= *checkpointTime) {
+      checkpointTime.reset();
+      if (auto err = saveCheckpoint(checkpointPath)) {
+        llvm::errs() << llvm::toString(std::move(err)) << "\n";
+        return -1;
+      }
+    }
+
     // Interrupt the simulation if a stop condition is met.
     if ((n > 0 && cycle >= n) || (maxTime > 0 && pop.time.time > maxTime)) {
       break;
@@ -117,98 +667,130 @@ int Engine::simulate(int n, uint64_t maxTime) {
 
     // Update the simulation time.
     state->time = pop.time;
+    if (profiler)
+      profiler->recordCycle(pop.time, state->queue.events);
 
     if (traceMode >= 0)
       trace.flush();
 
     // Process signal changes.
-    size_t i = 0, e = pop.changesSize;
+    size_t i = 0, e = pop.changes.size();
     while (i < e) {
       const auto sigIndex = pop.changes[i].first;
       const auto &curr = state->signals[sigIndex];
-      APInt buff(
-          curr.size * 8,
-          llvm::makeArrayRef(reinterpret_cast<uint64_t *>(curr.value.get()),
-                             llvm::divideCeil(curr.size, 8)));
+      buff.assign(curr.value, curr.value + curr.size);
 
       // Apply the changes to the buffer until we reach the next signal.
       while (i < e && pop.changes[i].first == sigIndex) {
         const auto &change = pop.buffers[pop.changes[i].second];
-        const auto offset = change.first;
-        const auto &drive = change.second;
-        if (drive.getBitWidth() < buff.getBitWidth())
-          buff.insertBits(drive, offset);
+        const auto *drive = pop.getValue(change);
+        if (change.width < curr.size * 8)
+          insertBits(buff.data(), curr.size, drive, change.width,
+                     change.bitOffset);
         else
-          buff = drive;
+          std::memcpy(buff.data(), drive, curr.size);
 
         ++i;
       }
 
       // Skip if the updated signal value is equal to the initial value.
-      if (std::memcmp(curr.value.get(), buff.getRawData(), curr.size) == 0)
+      if (std::memcmp(curr.value, buff.data(), curr.size) == 0)
         continue;
 
       // Apply the signal update.
-      std::memcpy(curr.value.get(), buff.getRawData(), curr.size);
-
-      // Add sensitive instances.
-      for (auto inst : curr.triggers) {
-        // Skip if the process is not currently sensible to the signal.
-        if (!state->instances[inst].isEntity) {
-          const auto &sensList = state->instances[inst].sensitivityList;
-          auto it = std::find_if(sensList.begin(), sensList.end(),
-                                 [sigIndex](const SignalDetail &sig) {
-                                   return sig.globalIndex == sigIndex;
-                                 });
-          if (sensList.end() != it &&
-              state->instances[inst].procState->senses[it - sensList.begin()] ==
-                  0)
-            continue;
-
-          // Invalidate scheduled wakeup
-          state->instances[inst].expectedWakeup = Time();
-        }
-        wakeupQueue.push_back(inst);
-      }
-
-      // Dump the updated signal.
-      if (traceMode >= 0)
-        trace.addChange(sigIndex);
+      std::memcpy(curr.value, buff.data(), curr.size);
+      signalChanged(sigIndex);
     }
 
     // Add scheduled process resumes to the wakeup queue.
     for (auto inst : pop.scheduled) {
       if (state->time == state->instances[inst].expectedWakeup)
-        wakeupQueue.push_back(inst);
+        wakeup(inst);
     }
 
     state->queue.pop();
 
-    std::sort(wakeupQueue.begin(), wakeupQueue.end());
-    wakeupQueue.erase(std::unique(wakeupQueue.begin(), wakeupQueue.end()),
-                      wakeupQueue.end());
-
-    // Run the instances present in the wakeup queue.
-    for (auto i : wakeupQueue) {
-      auto &inst = state->instances[i];
-      auto signalTable = inst.sensitivityList.data();
-
-      // Gather the instance arguments for unit invocation.
-      SmallVector<void *, 3> args;
-      if (inst.isEntity)
-        args.assign({&state, &inst.entityState, &signalTable});
-      else {
-        args.assign({&state, &inst.procState, &signalTable});
+    // Evaluate the pending instances level by level in levelized mode. The
+    // instances woken up by the drives applied right away are added to the
+    // pending ones, and the loop ends once the current delta cycle settled.
+    // Each new pass over the levels, going back to a level already evaluated
+    // through a combinational loop, counts as a cycle. Once the passes reach
+    // their limit or the cycle limit is hit, the drives go through the event
+    // queue again, such that oscillating loops advance like in event-driven
+    // mode.
+    if (levelization) {
+      deferDrives = false;
+      unsigned passes = 0;
+      llvm::Optional<unsigned> lastLevel;
+      while (!pending.empty()) {
+        unsigned level = pending.front().first;
+        if (lastLevel && level <= *lastLevel && !deferDrives) {
+          ++cycle;
+          if (++passes >= maxSettlePasses) {
+            if (!reportedLoop)
+              llvm::errs() << "Combinational loop not settling at "
+                           << state->time.dump() << " after " << passes
+                           << " passes, scheduling its drives as events\n";
+            reportedLoop = true;
+            deferDrives = true;
+          } else if (n > 0 && cycle >= n) {
+            deferDrives = true;
+          }
+        }
+        lastLevel = level;
+        while (!pending.empty() && pending.front().first == level) {
+          std::pop_heap(pending.begin(), pending.end(), std::greater<>());
+          wakeupQueue.push_back(pending.back().second);
+          queued.reset(pending.back().second);
+          pending.pop_back();
+        }
+
+        if (pool && wakeupQueue.size() > 1) {
+          evaluateParallel(*pool, wakeupQueue, driveBuffers, workRanges.get(),
+                           run);
+        } else {
+          setDriveBuffer(&driveBuffers[0]);
+          for (auto i : wakeupQueue) {
+            driveBuffers[0].beginInstance(i);
+            run(i, 0);
+          }
+          setDriveBuffer(nullptr);
+        }
+        state->mergeDriveBuffers(driveBuffers, applyDrive);
+        wakeupQueue.clear();
+      }
+    } else {
+      std::sort(wakeupQueue.begin(), wakeupQueue.end());
+      wakeupQueue.erase(std::unique(wakeupQueue.begin(), wakeupQueue.end()),
+                        wakeupQueue.end());
+
+      // Run the instances present in the wakeup queue. When evaluating them in
+      // parallel, the recorded events are merged in the queue afterwards.
+      if (pool && wakeupQueue.size() > 1) {
+        evaluateParallel(*pool, wakeupQueue, driveBuffers, workRanges.get(),
+                         run);
+        state->mergeDriveBuffers(driveBuffers);
+      } else {
+        for (auto i : wakeupQueue)
+          run(i, 0);
       }
-      // Run the unit.
-      (*inst.unitFPtr)(args.data());
-    }
 
-    // Clear wakeup queue.
-    wakeupQueue.clear();
+      // Clear wakeup queue.
+      wakeupQueue.clear();
+    }
     ++cycle;
   }
 
+  if (checkpointTime) {
+    llvm::errs() << "Checkpoint time " << *checkpointTime
+                 << "ps not reached, no checkpoint saved\n";
+    checkpointTime.reset();
+  }
+
+  wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                           startTime)
+                 .count();
+
   if (traceMode >= 0) {
     // Flush any remainign changes
     trace.flush(/*force=*/true);
@@ -219,6 +801,26 @@ int Engine::simulate(int n, uint64_t maxTime) {
   return 0;
 }
 
+void Engine::runInstance(Instance &inst, DriveLog &log) {
+  auto signalTable = inst.sensitivityList.data();
+  auto *logPtr = &log;
+
+  // Gather the instance arguments for unit invocation. The drive log is
+  // ignored by the units not lowered with drive logs.
+  SmallVector<void *, 4> args;
+  if (inst.isEntity)
+    args.assign({&state, &inst.entityState, &signalTable, &logPtr});
+  else {
+    args.assign({&state, &inst.procState, &signalTable, &logPtr});
+  }
+  // Run the unit.
+  (*inst.unitFPtr)(args.data());
+
+  // Issue the drives it logged.
+  if (log.size)
+    flushDriveLog(state.get(), &log);
+}
+
 void Engine::buildLayout(ModuleOp module) {
   // Start from the root entity.
   auto rootEntity = module.lookupSymbol<EntityOp>(root);
@@ -239,25 +841,88 @@ void Engine::buildLayout(ModuleOp module) {
   state->instances.push_back(std::move(rootInst));
 
   // Add triggers to signals.
-  for (size_t i = 0, e = state->instances.size(); i < e; ++i) {
-    auto &inst = state->instances[i];
-    for (auto trigger : inst.sensitivityList) {
-      state->signals[trigger.globalIndex].triggers.push_back(i);
-    }
+  state->buildTriggers();
+}
+
+/// Return the width in bits of a signal's underlying type, or zero if it is
+/// not known.
+static uint64_t getBitWidth(mlir::Type type) {
+  if (auto intType = type.dyn_cast<mlir::IntegerType>())
+    return intType.getWidth();
+  if (auto arrayType = type.dyn_cast<circt::llhd::ArrayType>())
+    return arrayType.getLength() * getBitWidth(arrayType.getElementType());
+  if (auto tupleType = type.dyn_cast<mlir::TupleType>()) {
+    uint64_t width = 0;
+    for (auto elementType : tupleType.getTypes())
+      width += getBitWidth(elementType);
+    return width;
   }
+  return 0;
+}
+
+/// Record the bit widths of a signal and its elements, which are dumped to
+/// the VCD waveforms.
+static void setSignalWidths(Signal &sig, mlir::Type type) {
+  sig.width = getBitWidth(type);
+  if (auto arrayType = type.dyn_cast<circt::llhd::ArrayType>())
+    sig.elementWidths.assign(arrayType.getLength(),
+                             getBitWidth(arrayType.getElementType()));
+  else if (auto tupleType = type.dyn_cast<mlir::TupleType>())
+    for (auto elementType : tupleType.getTypes())
+      sig.elementWidths.push_back(getBitWidth(elementType));
 }
 
 void Engine::walkEntity(EntityOp entity, Instance &child) {
+  // Map the signals of the entity to their slot in the sensitivity list, going
+  // through the signal extractions.
+  llvm::DenseMap<Value, unsigned> slots;
+  for (auto arg : entity.getArguments())
+    slots[arg] = arg.getArgNumber();
+  auto getSlot = [&](Value signal) -> llvm::Optional<unsigned> {
+    while (auto *def = signal.getDefiningOp()) {
+      if (!isa<ExtractSliceOp, DynExtractSliceOp, ExtractElementOp,
+               DynExtractElementOp>(def))
+        break;
+      signal = def->getOperand(0);
+    }
+    auto it = slots.find(signal);
+    if (it == slots.end())
+      return llvm::None;
+    return it->second;
+  };
+
   entity.walk([&](Operation *op) {
     assert(op);
 
     // Add a signal to the signal table.
     if (auto sig = dyn_cast<SigOp>(op)) {
       uint64_t index = state->addSignal(sig.name().str(), child.name);
+      auto type = sig.result().getType().cast<SigType>().getUnderlyingType();
+      setSignalWidths(state->signals[index], type);
+      slots[sig.result()] = child.sensitivityList.size();
       child.sensitivityList.push_back(
           SignalDetail({nullptr, 0, child.sensitivityList.size(), index}));
     }
 
+    // Record the signals the entity drives combinationally and the ones it
+    // reads, for the levelized mode.
+    if (auto drv = dyn_cast<DrvOp>(op)) {
+      if (auto slot = getSlot(drv.signal()))
+        child.drivenSlots.push_back(*slot);
+    } else if (!isa<SigOp, InstOp, ExtractSliceOp, DynExtractSliceOp,
+                    ExtractElementOp, DynExtractElementOp>(op)) {
+      auto reg = dyn_cast<RegOp>(op);
+      if (reg)
+        child.hasRegisters = true;
+      for (auto operand : op->getOperands()) {
+        if (!operand.getType().isa<SigType>() ||
+            (reg && operand == reg.signal()))
+          continue;
+        if (auto slot = getSlot(operand))
+          child.probedSlots.push_back(*slot);
+      }
+    }
+
     // Build (recursive) instance layout.
     if (auto inst = dyn_cast<InstOp>(op)) {
       // Skip self-recursion.
@@ -0,0 +1,90 @@
+//===- Levelize.cpp - Static entity schedule ------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the levelization of the entities of a design.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Levelize.h"
+
+#include <algorithm>
+
+using namespace llvm;
+using namespace circt::llhd::sim;
+
+/// Sort the given indices and remove the duplicates.
+static void sortUnique(SmallVectorImpl<unsigned> &indices) {
+  llvm::sort(indices);
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+}
+
+Levelization::Levelization(const State &state)
+    : levels(state.instances.size()), readers(state.signals.size()),
+      combinational(state.signals.size()) {
+  auto &instances = state.instances;
+
+  // Gather the signals each entity drives, and the entities probing each
+  // signal.
+  std::vector<SmallVector<unsigned, 2>> drives(instances.size());
+  for (unsigned i = 0, e = instances.size(); i < e; ++i) {
+    auto &inst = instances[i];
+    if (!inst.isEntity)
+      continue;
+    for (auto slot : inst.probedSlots)
+      readers[inst.sensitivityList[slot].globalIndex].push_back(i);
+    for (auto slot : inst.drivenSlots) {
+      auto sigIndex = inst.sensitivityList[slot].globalIndex;
+      drives[i].push_back(sigIndex);
+      combinational.set(sigIndex);
+    }
+    sortUnique(drives[i]);
+  }
+  for (auto &sigReaders : readers)
+    sortUnique(sigReaders);
+
+  // Return true if `reader` depends on the value `driver` drives on the signal.
+  auto dependsOn = [&](unsigned reader, unsigned driver) {
+    return reader != driver && !instances[reader].hasRegisters;
+  };
+
+  // Count the entities each entity depends on, with one dependency per driven
+  // signal.
+  std::vector<unsigned> numDependencies(instances.size());
+  for (unsigned i = 0, e = instances.size(); i < e; ++i)
+    for (auto sigIndex : drives[i])
+      for (auto reader : readers[sigIndex])
+        if (dependsOn(reader, i))
+          ++numDependencies[reader];
+
+  // Assign the levels in topological order, starting from the entities without
+  // dependencies.
+  SmallVector<unsigned, 0> current, next;
+  BitVector done(instances.size());
+  for (unsigned i = 0, e = instances.size(); i < e; ++i)
+    if (instances[i].isEntity && numDependencies[i] == 0)
+      current.push_back(i);
+  unsigned level = 0;
+  for (; !current.empty(); ++level) {
+    for (auto i : current) {
+      levels[i] = level;
+      done.set(i);
+      for (auto sigIndex : drives[i])
+        for (auto reader : readers[sigIndex])
+          if (dependsOn(reader, i) && --numDependencies[reader] == 0)
+            next.push_back(reader);
+    }
+    std::swap(current, next);
+    next.clear();
+  }
+
+  // The remaining entities are part of combinational loops, and are evaluated
+  // until they settle.
+  for (unsigned i = 0, e = instances.size(); i < e; ++i)
+    if (!done.test(i))
+      levels[i] = instances[i].isEntity ? level : level + 1;
+}
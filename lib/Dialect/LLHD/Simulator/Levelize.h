@@ -0,0 +1,53 @@
+//===- Levelize.h - Static entity schedule ----------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the static evaluation order of the entities used by the
+// levelized simulation mode.
+//
+//===----------------------------------------------------------------------===//
+
+// clang-tidy seems to expect the absolute path in the header guard on some
+// systems, so just disable it.
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef CIRCT_DIALECT_LLHD_SIMULATOR_LEVELIZE_H
+#define CIRCT_DIALECT_LLHD_SIMULATOR_LEVELIZE_H
+
+#include "State.h"
+
+#include "llvm/ADT/BitVector.h"
+
+#include <vector>
+
+namespace circt {
+namespace llhd {
+namespace sim {
+
+/// Static evaluation order of the instances of a design. Each entity gets a
+/// level higher than the ones of the entities driving the signals it probes,
+/// such that evaluating the levels in ascending order settles the
+/// combinational logic with a single evaluation of each entity. Entities with
+/// registers sample their inputs before the combinational logic changes and
+/// are all on the first level. The entities of combinational loops share the
+/// level after the last acyclic one, and processes come last.
+struct Levelization {
+  /// Levelize the instances of the given state.
+  explicit Levelization(const State &state);
+
+  /// The level of each instance.
+  std::vector<unsigned> levels;
+  /// The entity instances probing each signal, sorted by index.
+  std::vector<llvm::SmallVector<unsigned, 2>> readers;
+  /// Whether each signal is driven by llhd.drv in an entity.
+  llvm::BitVector combinational;
+};
+
+} // namespace sim
+} // namespace llhd
+} // namespace circt
+
+#endif // CIRCT_DIALECT_LLHD_SIMULATOR_LEVELIZE_H
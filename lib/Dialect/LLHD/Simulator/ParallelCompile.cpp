@@ -0,0 +1,204 @@
+//===- ParallelCompile.cpp - Parallel compilation of a design -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the compilation of a lowered design in partitions of
+// functions, compiled concurrently in LLVM contexts of their own.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ParallelCompile.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <mutex>
+
+using namespace llvm;
+using namespace circt::llhd::sim;
+
+/// The prefix of the packed function wrappers.
+static constexpr char packedPrefix[] = "_mlir_";
+/// The number of partitions created for each thread, such that threads
+/// finishing early can pick up the remaining work.
+static constexpr unsigned partitionsPerThread = 4;
+
+void circt::llhd::sim::packFunctionArguments(Module &module) {
+  auto &context = module.getContext();
+  IRBuilder<> builder(context);
+  auto *i8PtrTy = builder.getInt8PtrTy();
+  auto *wrapperTy = FunctionType::get(builder.getVoidTy(),
+                                      {i8PtrTy->getPointerTo()}, false);
+
+  SmallVector<Function *, 0> functions;
+  for (auto &func : module)
+    if (!func.isDeclaration())
+      functions.push_back(&func);
+
+  for (auto *func : functions) {
+    auto *wrapper =
+        Function::Create(wrapperTy, GlobalValue::ExternalLinkage,
+                         packedPrefix + func->getName(), module);
+    builder.SetInsertPoint(BasicBlock::Create(context, "entry", wrapper));
+
+    // Load the arguments from the pointers in the argument list.
+    Value *argList = wrapper->arg_begin();
+    SmallVector<Value *, 8> args;
+    for (auto &arg : func->args()) {
+      auto *argPtrPtr =
+          builder.CreateGEP(i8PtrTy, argList, builder.getInt64(arg.getArgNo()));
+      Value *argPtr = builder.CreateLoad(i8PtrTy, argPtrPtr);
+      argPtr = builder.CreateBitCast(argPtr, arg.getType()->getPointerTo());
+      args.push_back(builder.CreateLoad(arg.getType(), argPtr));
+    }
+
+    // Store the result through the pointer following the arguments.
+    auto *result = builder.CreateCall(func, args);
+    if (!result->getType()->isVoidTy()) {
+      auto *resultPtrPtr = builder.CreateGEP(
+          i8PtrTy, argList, builder.getInt64(func->arg_size()));
+      Value *resultPtr = builder.CreateLoad(i8PtrTy, resultPtrPtr);
+      resultPtr =
+          builder.CreateBitCast(resultPtr, result->getType()->getPointerTo());
+      builder.CreateStore(result, resultPtr);
+    }
+    builder.CreateRetVoid();
+  }
+}
+
+/// Assign the functions defined in the module to `numPartitions` partitions of
+/// balanced instruction counts. Packed wrappers go with the function they
+/// wrap, such that they can be inlined.
+static StringMap<unsigned> partitionFunctions(Module &module,
+                                              unsigned numPartitions) {
+  // Group the functions with their packed wrapper.
+  StringMap<unsigned> groupOf;
+  SmallVector<std::pair<unsigned, SmallVector<Function *, 2>>, 0> groups;
+  for (auto &func : module) {
+    if (func.isDeclaration())
+      continue;
+    auto name = func.getName();
+    if (name.startswith(packedPrefix)) {
+      auto *wrapped = module.getFunction(name.drop_front(strlen(packedPrefix)));
+      if (wrapped && !wrapped->isDeclaration())
+        name = wrapped->getName();
+    }
+    auto it = groupOf.insert(std::make_pair(name, groups.size()));
+    if (it.second)
+      groups.emplace_back();
+    auto &group = groups[it.first->second];
+    group.first += func.getInstructionCount();
+    group.second.push_back(&func);
+  }
+
+  // Hand out the largest groups first, each to the least loaded partition.
+  std::stable_sort(groups.begin(), groups.end(),
+                   [](const auto &lhs, const auto &rhs) {
+                     return lhs.first > rhs.first;
+                   });
+  SmallVector<uint64_t, 16> loads(numPartitions);
+  StringMap<unsigned> partitionOf;
+  for (auto &group : groups) {
+    auto partition = std::min_element(loads.begin(), loads.end()) - loads.begin();
+    loads[partition] += group.first;
+    for (auto *func : group.second)
+      partitionOf[func->getName()] = partition;
+  }
+  return partitionOf;
+}
+
+Expected<std::vector<std::unique_ptr<MemoryBuffer>>>
+circt::llhd::sim::compileInParallel(Module &module,
+                                    orc::JITTargetMachineBuilder jtmb,
+                                    function_ref<Error(Module *)> transformer,
+                                    unsigned numThreads) {
+  // Make all the symbols externally visible, such that the partitions can
+  // refer to the ones defined by the other partitions.
+  for (auto &value : module.global_values()) {
+    if (!value.hasName())
+      value.setName("__llhd_sim_anon");
+    if (value.hasLocalLinkage())
+      value.setLinkage(GlobalValue::ExternalLinkage);
+  }
+
+  unsigned numFunctions = 0;
+  for (auto &func : module)
+    if (!func.isDeclaration())
+      ++numFunctions;
+  unsigned numPartitions = std::max(
+      1u, std::min(numFunctions, std::max(numThreads, 1u) * partitionsPerThread));
+  auto partitionOf = partitionFunctions(module, numPartitions);
+
+  // Each partition is parsed from the bitcode in a context of its own, only
+  // materializing the functions it defines.
+  SmallString<0> bitcode;
+  raw_svector_ostream os(bitcode);
+  WriteBitcodeToFile(module, os);
+  MemoryBufferRef bitcodeRef(bitcode, module.getModuleIdentifier());
+
+  std::vector<std::unique_ptr<MemoryBuffer>> objects(numPartitions);
+  std::mutex errorMutex;
+  Error error = Error::success();
+  auto report = [&](Error err) {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    error = joinErrors(std::move(error), std::move(err));
+  };
+
+  ThreadPool pool(hardware_concurrency(numThreads));
+  for (unsigned p = 0; p < numPartitions; ++p) {
+    pool.async([&, p] {
+      LLVMContext context;
+      auto partModule = getLazyBitcodeModule(bitcodeRef, context);
+      if (!partModule)
+        return report(partModule.takeError());
+      auto &part = **partModule;
+
+      for (auto &func : part) {
+        if (func.isDeclaration() || partitionOf.lookup(func.getName()) == p)
+          continue;
+        func.deleteBody();
+        func.setComdat(nullptr);
+      }
+      if (p != 0) {
+        for (auto &global : part.globals()) {
+          if (global.isDeclaration())
+            continue;
+          global.setInitializer(nullptr);
+          global.setLinkage(GlobalValue::ExternalLinkage);
+          global.setComdat(nullptr);
+        }
+      }
+      if (auto err = part.materializeAll())
+        return report(std::move(err));
+      if (auto err = transformer(&part))
+        return report(std::move(err));
+
+      auto builder = jtmb;
+      auto tm = builder.createTargetMachine();
+      if (!tm)
+        return report(tm.takeError());
+      orc::SimpleCompiler compiler(**tm);
+      auto object = compiler(part);
+      if (!object)
+        return report(object.takeError());
+      objects[p] = std::move(*object);
+    });
+  }
+  pool.wait();
+
+  if (error)
+    return std::move(error);
+  return std::move(objects);
+}
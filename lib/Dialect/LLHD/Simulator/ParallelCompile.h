@@ -0,0 +1,57 @@
+//===- ParallelCompile.h - Parallel compilation of a design -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the functions used to split the lowered design in
+// partitions and to compile them concurrently.
+//
+//===----------------------------------------------------------------------===//
+
+// clang-tidy seems to expect the absolute path in the header guard on some
+// systems, so just disable it.
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef CIRCT_DIALECT_LLHD_SIMULATOR_PARALLELCOMPILE_H
+#define CIRCT_DIALECT_LLHD_SIMULATOR_PARALLELCOMPILE_H
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+#include <vector>
+
+namespace llvm {
+class Module;
+} // namespace llvm
+
+namespace circt {
+namespace llhd {
+namespace sim {
+
+/// Define a `_mlir_<name>(i8 **args)` wrapper for every function defined in
+/// the module, calling it with the arguments pointed to by `args`, as done by
+/// the mlir::ExecutionEngine.
+void packFunctionArguments(llvm::Module &module);
+
+/// Compile the functions defined in the module to object files, on
+/// `numThreads` threads. The functions are split in partitions of balanced
+/// size, each one parsed in an LLVM context of its own, optimized with
+/// `transformer` and compiled with a target machine built by `jtmb`. Global
+/// variables are all defined by the first partition. The module is left with
+/// all its symbols externally visible.
+llvm::Expected<std::vector<std::unique_ptr<llvm::MemoryBuffer>>>
+compileInParallel(llvm::Module &module,
+                  llvm::orc::JITTargetMachineBuilder jtmb,
+                  llvm::function_ref<llvm::Error(llvm::Module *)> transformer,
+                  unsigned numThreads);
+
+} // namespace sim
+} // namespace llhd
+} // namespace circt
+
+#endif // CIRCT_DIALECT_LLHD_SIMULATOR_PARALLELCOMPILE_H
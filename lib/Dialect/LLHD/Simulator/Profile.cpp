@@ -0,0 +1,186 @@
+//===- Profile.cpp - Simulation profiler ----------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the profiler used by the llhd-sim tool.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Profile.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace llvm;
+using namespace circt::llhd::sim;
+
+/// The maximum number of events kept for the Chrome trace, over all workers.
+static constexpr size_t maxEvents = 1 << 20;
+/// The maximum number of instances and signals listed in the report.
+static constexpr size_t maxReportEntries = 20;
+
+Profiler::Profiler(const State &state, unsigned numWorkers)
+    : state(state), start(Clock::now()),
+      invocations(state.instances.size()),
+      instanceTime(state.instances.size()),
+      signalChanges(state.signals.size()), events(numWorkers),
+      eventBudget(maxEvents / numWorkers) {}
+
+void Profiler::addEvent(unsigned worker, const Event &event) {
+  auto &workerEvents = events[worker];
+  if (workerEvents.size() < eventBudget)
+    workerEvents.push_back(event);
+}
+
+void Profiler::recordInstance(unsigned inst, unsigned worker,
+                              Clock::time_point begin, Clock::time_point end) {
+  auto beginStamp = getTimestamp(begin);
+  auto duration = getTimestamp(end) - beginStamp;
+  ++invocations[inst];
+  instanceTime[inst] += duration;
+  addEvent(worker, {inst, beginStamp, duration, 0});
+}
+
+void Profiler::recordCycle(const Time &time, uint64_t pendingEvents) {
+  pendingSum += pendingEvents;
+  maxPending = std::max(maxPending, pendingEvents);
+
+  // Sample the queue size once per real-time step.
+  if (cycles++ == 0 || time.time != currentRealTime) {
+    ++realSteps;
+    currentRealTime = time.time;
+    currentDeltas = 0;
+    addEvent(0, {~0U, getTimestamp(Clock::now()), 0, pendingEvents});
+  }
+  if (++currentDeltas > maxDeltas) {
+    maxDeltas = currentDeltas;
+    maxDeltasTime = currentRealTime;
+  }
+}
+
+void Profiler::printReport(raw_ostream &os) const {
+  auto totalTime =
+      std::accumulate(instanceTime.begin(), instanceTime.end(), uint64_t(0));
+  auto totalInvocations =
+      std::accumulate(invocations.begin(), invocations.end(), uint64_t(0));
+
+  os << "::------------------ Profile -------------------::\n";
+  os << "cycles: " << cycles << "\n";
+  os << "real-time steps: " << realSteps << "\n";
+  if (realSteps > 0) {
+    os << "delta cycles per real-time step: avg "
+       << format("%.2f", double(cycles) / realSteps) << ", max " << maxDeltas
+       << " at " << maxDeltasTime << "ps\n";
+    os << "pending events per cycle: avg "
+       << format("%.2f", double(pendingSum) / cycles) << ", max "
+       << maxPending << "\n";
+  }
+  os << "instance invocations: " << totalInvocations << ", total time "
+     << format("%.3f", totalTime / 1e6) << " ms\n";
+
+  // List the instances by decreasing wall time.
+  SmallVector<unsigned, 0> order;
+  for (unsigned i = 0, e = invocations.size(); i < e; ++i)
+    if (invocations[i] > 0)
+      order.push_back(i);
+  std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+    return instanceTime[a] > instanceTime[b];
+  });
+  os << "instances by wall time:\n";
+  os << "  time(ms)   share  invocations   avg(us)  instance\n";
+  for (auto i : makeArrayRef(order).take_front(maxReportEntries)) {
+    auto &inst = state.instances[i];
+    os << format("  %8.3f  %5.1f%%  %11llu  %8.3f", instanceTime[i] / 1e6,
+                 totalTime ? 100.0 * instanceTime[i] / totalTime : 0.0,
+                 (unsigned long long)invocations[i],
+                 instanceTime[i] / 1e3 / invocations[i])
+       << "  " << inst.path << " (" << inst.unit << ")\n";
+  }
+  if (order.size() > maxReportEntries)
+    os << "  (" << order.size() - maxReportEntries << " more)\n";
+
+  // List the signals by decreasing number of changes. Signals are named after
+  // the path of the instance owning them.
+  StringMap<StringRef> paths;
+  for (auto &inst : state.instances)
+    paths[inst.name] = inst.path;
+  order.clear();
+  for (unsigned i = 0, e = signalChanges.size(); i < e; ++i)
+    if (signalChanges[i] > 0)
+      order.push_back(i);
+  std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+    return signalChanges[a] > signalChanges[b];
+  });
+  os << "signals by changes:\n";
+  os << "   changes  signal\n";
+  for (auto i : makeArrayRef(order).take_front(maxReportEntries)) {
+    auto &sig = state.signals[i];
+    os << format("  %8llu", (unsigned long long)signalChanges[i]) << "  "
+       << paths.lookup(sig.owner) << "/" << sig.name << "\n";
+  }
+  if (order.size() > maxReportEntries)
+    os << "  (" << order.size() - maxReportEntries << " more)\n";
+  os << "::----------------------------------------------::\n";
+}
+
+void Profiler::writeChromeTrace(raw_ostream &os) const {
+  json::OStream json(os);
+  json.object([&] {
+    json.attributeArray("traceEvents", [&] {
+      for (unsigned w = 0, e = events.size(); w < e; ++w) {
+        json.object([&] {
+          json.attribute("name", "thread_name");
+          json.attribute("ph", "M");
+          json.attribute("pid", 0);
+          json.attribute("tid", w);
+          json.attributeObject("args", [&] {
+            json.attribute("name", "worker " + std::to_string(w));
+          });
+        });
+      }
+
+      for (unsigned w = 0, e = events.size(); w < e; ++w) {
+        for (auto &event : events[w]) {
+          json.object([&] {
+            if (event.inst == ~0U) {
+              json.attribute("name", "queue");
+              json.attribute("ph", "C");
+              json.attribute("ts", event.begin / 1e3);
+              json.attribute("pid", 0);
+              json.attributeObject("args", [&] {
+                json.attribute("pending events", int64_t(event.pending));
+              });
+              return;
+            }
+            auto &inst = state.instances[event.inst];
+            json.attribute("name", inst.path);
+            json.attribute("cat", inst.unit);
+            json.attribute("ph", "X");
+            json.attribute("ts", event.begin / 1e3);
+            json.attribute("dur", event.duration / 1e3);
+            json.attribute("pid", 0);
+            json.attribute("tid", w);
+          });
+        }
+      }
+    });
+    json.attribute("displayTimeUnit", "ns");
+    bool truncated = llvm::any_of(events, [&](const std::vector<Event> &e) {
+      return e.size() >= eventBudget;
+    });
+    if (truncated)
+      json.attributeObject("otherData", [&] {
+        json.attribute("truncated", "event budget exhausted");
+      });
+  });
+  os << "\n";
+}
@@ -0,0 +1,112 @@
+//===- Profile.h - Simulation profiler --------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the profiler used by the llhd-sim tool to find out where
+// the simulation time goes.
+//
+//===----------------------------------------------------------------------===//
+
+// clang-tidy seems to expect the absolute path in the header guard on some
+// systems, so just disable it.
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef CIRCT_DIALECT_LLHD_SIMULATOR_PROFILE_H
+#define CIRCT_DIALECT_LLHD_SIMULATOR_PROFILE_H
+
+#include "State.h"
+
+#include <chrono>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+namespace circt {
+namespace llhd {
+namespace sim {
+
+/// Gathers the per-instance invocation counts and wall time, the per-signal
+/// change counts, the number of delta cycles of each real-time step and the
+/// event queue size over a simulation run. Each instance runs at most once per
+/// delta cycle, such that its counters are only ever updated by one worker at
+/// a time.
+class Profiler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Create a profiler for the given state, evaluated by `numWorkers` threads.
+  Profiler(const State &state, unsigned numWorkers);
+
+  /// Record one invocation of an instance on the given worker.
+  void recordInstance(unsigned inst, unsigned worker, Clock::time_point begin,
+                      Clock::time_point end);
+
+  /// Record a change of the signal with the given index.
+  void recordSignalChange(unsigned sigIndex) { ++signalChanges[sigIndex]; }
+
+  /// Record the start of a delta cycle at the given simulation time, with the
+  /// given number of events pending in the queue.
+  void recordCycle(const Time &time, uint64_t pendingEvents);
+
+  /// Print the instances sorted by wall time, the signals sorted by number of
+  /// changes and the cycle and queue statistics.
+  void printReport(llvm::raw_ostream &os) const;
+
+  /// Write the instance invocations and the queue size in the Chrome trace
+  /// event format.
+  void writeChromeTrace(llvm::raw_ostream &os) const;
+
+private:
+  /// One instance invocation, or one queue size sample if `inst` is ~0U.
+  struct Event {
+    unsigned inst;
+    // The start and the duration of the event, in nanoseconds since the start
+    // of the profile.
+    uint64_t begin;
+    uint64_t duration;
+    // The number of pending events, for queue size samples.
+    uint64_t pending;
+  };
+
+  /// Return the time elapsed since the start of the profile, in nanoseconds.
+  uint64_t getTimestamp(Clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time - start)
+        .count();
+  }
+
+  /// Add an event to the given worker's trace, unless its budget is exhausted.
+  void addEvent(unsigned worker, const Event &event);
+
+  const State &state;
+  Clock::time_point start;
+
+  std::vector<uint64_t> invocations;
+  std::vector<uint64_t> instanceTime;
+  std::vector<uint64_t> signalChanges;
+
+  uint64_t cycles = 0;
+  uint64_t realSteps = 0;
+  uint64_t currentRealTime = 0;
+  uint64_t currentDeltas = 0;
+  uint64_t maxDeltas = 0;
+  uint64_t maxDeltasTime = 0;
+  uint64_t pendingSum = 0;
+  uint64_t maxPending = 0;
+
+  // The events recorded on each worker, for the Chrome trace. Queue size
+  // samples are recorded once per real-time step, with the events of worker 0.
+  // Recording stops once a worker reaches its budget.
+  std::vector<std::vector<Event>> events;
+  size_t eventBudget;
+};
+
+} // namespace sim
+} // namespace llhd
+} // namespace circt
+
+#endif // CIRCT_DIALECT_LLHD_SIMULATOR_PROFILE_H
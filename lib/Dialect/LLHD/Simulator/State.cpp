@@ -13,7 +13,9 @@
 
 #include "State.h"
 
+#include "llvm/Support/Alignment.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <string>
@@ -57,16 +59,16 @@ std::string Time::dump() {
 //===----------------------------------------------------------------------===//
 
 Signal::Signal(std::string name, std::string owner)
-    : name(name), owner(owner), size(0), value(nullptr) {}
+    : value(nullptr), size(0), name(name), owner(owner) {}
 
 Signal::Signal(std::string name, std::string owner, uint8_t *value,
                uint64_t size)
-    : name(name), owner(owner), size(size), value(value) {}
+    : value(value), size(size), name(name), owner(owner) {}
 
 bool Signal::operator==(const Signal &rhs) const {
   if (owner != rhs.owner || name != rhs.name || size != rhs.size)
     return false;
-  return std::memcmp(value.get(), rhs.value.get(), size);
+  return std::memcmp(value, rhs.value, size);
 }
 
 bool Signal::operator<(const Signal &rhs) const {
@@ -82,7 +84,7 @@ std::string Signal::dump() {
   raw_string_ostream ss(ret);
   ss << "0x";
   for (int i = size - 1; i >= 0; --i) {
-    ss << format_hex_no_prefix(static_cast<int>(value.get()[i]), 2);
+    ss << format_hex_no_prefix(static_cast<int>(value[i]), 2);
   }
   return ss.str();
 }
@@ -90,7 +92,7 @@ std::string Signal::dump() {
 std::string Signal::dump(unsigned elemIndex) {
   assert(elements.size() > 0 && "the signal type has to be tuple or array!");
   auto elemSize = elements[elemIndex].second;
-  auto ptr = value.get() + elements[elemIndex].first;
+  auto ptr = value + elements[elemIndex].first;
   std::string ret;
   raw_string_ostream ss(ret);
   ss << "0x";
@@ -109,30 +111,92 @@ bool Slot::operator>(const Slot &rhs) const { return rhs.time < time; }
 
 void Slot::insertChange(int index, int bitOffset, uint8_t *bytes,
                         unsigned width) {
-  // Get the amount of 64 bit words required to store the value in an APInt.
-  auto size = llvm::divideCeil(width, 64);
-
-  if (changesSize >= buffers.size()) {
-    // Create a new change buffer if we don't have any unused one available for
-    // reuse.
-    buffers.push_back(std::make_pair(
-        bitOffset,
-        APInt(width, makeArrayRef(reinterpret_cast<uint64_t *>(bytes), size))));
+  Change change = {static_cast<uint64_t>(bitOffset), width, 0};
+  auto numBytes = llvm::divideCeil(width, 8);
+
+  if (width <= 64) {
+    std::memcpy(&change.value, bytes, numBytes);
   } else {
-    // Reuse the first available buffer.
-    buffers[changesSize] = std::make_pair(
-        bitOffset,
-        APInt(width, makeArrayRef(reinterpret_cast<uint64_t *>(bytes), size)));
+    // Store wide values in the word arena. The arena keeps its capacity across
+    // slot reuses, such that no allocation happens once it is warmed up.
+    change.value = words.size();
+    words.resize(words.size() + llvm::divideCeil(width, 64));
+    std::memcpy(words.data() + change.value, bytes, numBytes);
   }
 
   // Map the signal index to the change buffer so we can retrieve
   // it after sorting.
-  changes.push_back(std::make_pair(index, changesSize));
-  ++changesSize;
+  changes.push_back(std::make_pair(index, buffers.size()));
+  buffers.push_back(change);
 }
 
 void Slot::insertChange(unsigned inst) { scheduled.push_back(inst); }
 
+//===----------------------------------------------------------------------===//
+// Bit splicing
+//===----------------------------------------------------------------------===//
+
+/// Write the lowest `numBits` bits of `value` in `dst` at bit position
+/// `bitPos`. The word is written with a single unaligned 64-bit
+/// read-modify-write whenever it fits in the buffer.
+static void writeWord(uint8_t *dst, uint64_t size, uint64_t bitPos,
+                      uint64_t value, unsigned numBits) {
+  if (numBits < 64)
+    value &= (uint64_t(1) << numBits) - 1;
+
+  uint64_t byte = bitPos / 8;
+  unsigned shift = bitPos % 8;
+  if (shift + numBits <= 64 && byte + 8 <= size) {
+    uint64_t mask = numBits == 64 ? ~uint64_t(0)
+                                  : ((uint64_t(1) << numBits) - 1) << shift;
+    uint64_t word;
+    std::memcpy(&word, dst + byte, 8);
+    word = (word & ~mask) | (value << shift);
+    std::memcpy(dst + byte, &word, 8);
+    return;
+  }
+
+  // Fall back to byte-wise splicing at the end of the buffer.
+  for (unsigned i = 0; i < numBits;) {
+    uint64_t b = (bitPos + i) / 8;
+    unsigned s = (bitPos + i) % 8;
+    unsigned n = std::min(8 - s, numBits - i);
+    if (b >= size)
+      break;
+    uint8_t mask = ((1u << n) - 1) << s;
+    dst[b] = (dst[b] & ~mask) | (((value >> i) << s) & mask);
+    i += n;
+  }
+}
+
+void circt::llhd::sim::insertBits(uint8_t *dst, uint64_t size,
+                                  const uint64_t *src, uint64_t width,
+                                  uint64_t bitOffset) {
+  uint64_t totalBits = size * 8;
+  if (bitOffset >= totalBits)
+    return;
+  width = std::min(width, totalBits - bitOffset);
+
+  // Byte-aligned drives are copied directly, only merging the last byte if it
+  // is partially driven.
+  if (bitOffset % 8 == 0) {
+    auto bytes = reinterpret_cast<const uint8_t *>(src);
+    uint64_t fullBytes = width / 8;
+    std::memcpy(dst + bitOffset / 8, bytes, fullBytes);
+    if (width % 8) {
+      uint8_t mask = (1u << (width % 8)) - 1;
+      uint8_t &last = dst[bitOffset / 8 + fullBytes];
+      last = (last & ~mask) | (bytes[fullBytes] & mask);
+    }
+    return;
+  }
+
+  // Splice one word at a time otherwise.
+  for (uint64_t pos = 0; pos < width; pos += 64)
+    writeWord(dst, size, bitOffset + pos, src[pos / 64],
+              std::min<uint64_t>(64, width - pos));
+}
+
 //===----------------------------------------------------------------------===//
 // UpdateQueue
 //===----------------------------------------------------------------------===//
@@ -140,6 +204,7 @@ void UpdateQueue::insertOrUpdate(Time time, int index, int bitOffset,
                                  uint8_t *bytes, unsigned width) {
   auto &slot = getOrCreateSlot(time);
   slot.insertChange(index, bitOffset, bytes, width);
+  ++stats.drives;
 }
 
 void UpdateQueue::insertOrUpdate(Time time, unsigned inst) {
@@ -147,85 +212,204 @@ void UpdateQueue::insertOrUpdate(Time time, unsigned inst) {
   slot.insertChange(inst);
 }
 
-Slot &UpdateQueue::getOrCreateSlot(Time time) {
-  auto &top = begin()[topSlot];
+Slot &UpdateQueue::getSlotForDrives(Time time, unsigned numDrives) {
+  auto &slot = getOrCreateSlot(time);
+  slot.changes.reserve(slot.changes.size() + numDrives);
+  slot.buffers.reserve(slot.buffers.size() + numDrives);
+  stats.drives += numDrives;
+  return slot;
+}
 
-  // Directly add to top slot.
-  if (!top.unused && time == top.time) {
-    return top;
+Slot &UpdateQueue::getOrCreateSlot(Time time) {
+  // Directly return the slot if one already exists for the given time.
+  auto it = index.find(time);
+  if (it != index.end())
+    return slots[it->second];
+
+  // Spawn new event using an existing slot if one is available, else generate
+  // a new one.
+  unsigned slot;
+  if (!unused.empty()) {
+    slot = unused.pop_back_val();
+    slots[slot].unused = false;
+    slots[slot].time = time;
+  } else {
+    slot = slots.size();
+    slots.push_back(Slot(time));
+    ++stats.slotsCreated;
   }
 
-  // We need to search through the queue for an existing slot only if we're
-  // spawning an event later than the top slot. Adding to an existing slot
-  // scheduled earlier than the top slot should never happens, as then it should
-  // be the top.
-  if (events > 0 && top.time < time) {
-    for (size_t i = 0, e = size(); i < e; ++i) {
-      if (time == begin()[i].time) {
-        return begin()[i];
-      }
-    }
+  index[time] = slot;
+  if (time.time == now)
+    ++stats.nearInserts;
+  else if (getLevel(time.time) < wheelLevels)
+    ++stats.wheelInserts;
+  else
+    ++stats.overflowInserts;
+  schedule(slot);
+
+  ++events;
+  stats.maxPending = std::max<uint64_t>(stats.maxPending, events);
+  return slots[slot];
+}
+
+unsigned UpdateQueue::getLevel(uint64_t time) const {
+  assert(time > now && "cannot schedule a slot in the past!");
+  // Slots are placed on the level containing the highest bit in which their
+  // time differs from the current one. All the higher bits are shared with the
+  // current time, and the level digit is always greater than the current one.
+  unsigned highBit = 63 - llvm::countLeadingZeros(time ^ now);
+  return std::min(highBit / wheelBits, unsigned(wheelLevels));
+}
+
+void UpdateQueue::schedule(unsigned slot) {
+  auto time = slots[slot].time.time;
+  auto later = [&](unsigned a, unsigned b) { return isLater(a, b); };
+
+  // Slots in the current real-time step are ordered by delta and epsilon.
+  if (time == now) {
+    near.push_back(slot);
+    std::push_heap(near.begin(), near.end(), later);
+    return;
   }
 
-  // Spawn new event using an existing slot.
-  if (!unused.empty()) {
-    auto firstUnused = unused.pop_back_val();
-    auto &newSlot = begin()[firstUnused];
-    newSlot.unused = false;
-    newSlot.time = time;
-
-    // Update the top of the queue either if it is currently unused or the new
-    // timestamp is earlier than it.
-    if (top.unused || time < top.time)
-      topSlot = firstUnused;
-
-    ++events;
-    return newSlot;
+  auto level = getLevel(time);
+  if (level == wheelLevels) {
+    overflow.push_back(slot);
+    std::push_heap(overflow.begin(), overflow.end(), later);
+    return;
   }
 
-  // We do not have pre-allocated slots available, generate a new one.
-  push_back(Slot(time));
+  auto &wheelLevel = wheel[level];
+  unsigned bucket = (time >> (level * wheelBits)) & (wheelSize - 1);
+  wheelLevel.buckets[bucket].push_back(slot);
+  wheelLevel.occupied[bucket / 64] |= uint64_t(1) << (bucket % 64);
+  ++wheelLevel.count;
+}
 
-  // Update the top of the queue either if it is currently unused or the new
-  // timestamp is earlier than it.
-  if (top.unused || time < top.time)
-    topSlot = size() - 1;
+void UpdateQueue::advance() {
+  auto later = [&](unsigned a, unsigned b) { return isLater(a, b); };
+  llvm::SmallVector<unsigned, 8> cascade;
+
+  while (near.empty()) {
+    // Find the finest non-empty wheel level. All the slots stored on it are
+    // scheduled earlier than any slot stored on coarser levels.
+    unsigned level = 0;
+    while (level < wheelLevels && wheel[level].count == 0)
+      ++level;
+
+    if (level == wheelLevels) {
+      // The wheel is empty, jump directly to the earliest overflowing slot and
+      // move all the slots that now fit in the wheel out of the overflow heap.
+      assert(!overflow.empty() && "advancing an empty queue!");
+      now = slots[overflow.front()].time.time;
+      while (!overflow.empty() &&
+             (slots[overflow.front()].time.time == now ||
+              getLevel(slots[overflow.front()].time.time) < wheelLevels)) {
+        std::pop_heap(overflow.begin(), overflow.end(), later);
+        schedule(overflow.pop_back_val());
+      }
+      continue;
+    }
 
-  ++events;
-  return back();
+    // Get the earliest non-empty bucket on the level.
+    auto &wheelLevel = wheel[level];
+    unsigned bucket = 0;
+    for (unsigned i = 0, e = wheelLevel.occupied.size(); i < e; ++i) {
+      if (wheelLevel.occupied[i]) {
+        bucket = i * 64 + llvm::countTrailingZeros(wheelLevel.occupied[i]);
+        break;
+      }
+    }
+
+    // Move the current time to the beginning of the bucket, keeping the bits
+    // above the level and clearing the ones below it.
+    unsigned shift = level * wheelBits;
+    uint64_t highMask = ~((uint64_t(1) << (shift + wheelBits)) - 1);
+    now = (now & highMask) | (uint64_t(bucket) << shift);
+
+    // Redistribute the bucket's slots on the finer levels, or on the current
+    // step heap for the ones scheduled exactly at the new time.
+    cascade.clear();
+    std::swap(cascade, wheelLevel.buckets[bucket]);
+    wheelLevel.occupied[bucket / 64] &= ~(uint64_t(1) << (bucket % 64));
+    wheelLevel.count -= cascade.size();
+    for (auto slot : cascade)
+      schedule(slot);
+    if (level > 0)
+      stats.cascades += cascade.size();
+  }
 }
 
 const Slot &UpdateQueue::top() {
-  assert(topSlot < size() && "top is pointing out of bounds!");
+  assert(events > 0 && "the event queue is empty!");
+  if (near.empty())
+    advance();
 
   // Sort the changes of the top slot such that all changes to the same signal
   // are in succession.
-  auto &top = begin()[topSlot];
-  llvm::sort(top.changes.begin(), top.changes.begin() + top.changesSize);
+  auto &top = slots[near.front()];
+  llvm::sort(top.changes);
   return top;
 }
 
 void UpdateQueue::pop() {
+  assert(!near.empty() && "top has to be called before popping the queue!");
+  auto later = [&](unsigned a, unsigned b) { return isLater(a, b); };
+  std::pop_heap(near.begin(), near.end(), later);
+  auto topSlot = near.pop_back_val();
+
   // Reset internal structures and decrease the event counter.
-  auto &curr = begin()[topSlot];
+  auto &curr = slots[topSlot];
+  index.erase(curr.time);
   curr.unused = true;
-  curr.changesSize = 0;
   curr.scheduled.clear();
   curr.changes.clear();
+  curr.buffers.clear();
+  curr.words.clear();
   curr.time = Time();
   --events;
 
   // Add to unused slots list for easy retrieval.
   unused.push_back(topSlot);
+}
 
-  // Update the current top of the queue.
-  topSlot = std::distance(
-      begin(),
-      std::min_element(begin(), end(), [](const auto &a, const auto &b) {
-        // a is "smaller" than b if either a's timestamp is earlier than b's, or
-        // b is unused (i.e. b has no actual meaning).
-        return !a.unused && (a < b || b.unused);
-      }));
+void UpdateQueue::forEachSlot(
+    llvm::function_ref<void(const Slot &)> fn) const {
+  llvm::SmallVector<unsigned, 16> pending;
+  pending.reserve(index.size());
+  for (auto &entry : index)
+    pending.push_back(entry.second);
+  llvm::sort(pending, [&](unsigned a, unsigned b) { return isLater(b, a); });
+  for (auto slot : pending)
+    fn(slots[slot]);
+}
+
+//===----------------------------------------------------------------------===//
+// DriveBuffer
+//===----------------------------------------------------------------------===//
+
+void DriveBuffer::beginInstance(unsigned inst) {
+  currentInst = inst;
+  runs.push_back(std::make_pair(inst, entries.size()));
+}
+
+void DriveBuffer::insertChange(Time time, int index, int bitOffset,
+                               uint8_t *bytes, unsigned width) {
+  auto numBytes = llvm::divideCeil(width, 8);
+  entries.push_back(
+      {time, index, bitOffset, width, currentInst, values.size()});
+  values.append(bytes, bytes + numBytes);
+}
+
+void DriveBuffer::insertWakeup(Time time, unsigned inst) {
+  entries.push_back({time, -1, 0, 0, inst, 0});
+}
+
+void DriveBuffer::clear() {
+  entries.clear();
+  values.clear();
+  runs.clear();
 }
 
 //===----------------------------------------------------------------------===//
@@ -238,6 +422,10 @@ State::~State() {
       std::free(inst.procState->senses);
     }
   }
+  // The values are still owned by the signals until the arena is allocated.
+  if (!signalArena)
+    for (auto &sig : signals)
+      std::free(sig.value);
 }
 
 Slot State::popQueue() {
@@ -253,6 +441,41 @@ void State::pushQueue(Time t, unsigned inst) {
   instances[inst].expectedWakeup = newTime;
 }
 
+void State::mergeDriveBuffers(
+    MutableArrayRef<DriveBuffer> buffers,
+    function_ref<bool(const DriveBuffer::Entry &, const uint8_t *)> apply) {
+  // Gather the runs of all the buffers, as (instance, buffer, run) tuples.
+  SmallVector<std::tuple<unsigned, unsigned, unsigned>, 16> runs;
+  for (unsigned b = 0, e = buffers.size(); b < e; ++b)
+    for (unsigned r = 0, re = buffers[b].runs.size(); r < re; ++r)
+      runs.push_back(std::make_tuple(buffers[b].runs[r].first, b, r));
+  llvm::sort(runs);
+
+  for (auto &run : runs) {
+    auto &buffer = buffers[std::get<1>(run)];
+    auto r = std::get<2>(run);
+    unsigned begin = buffer.runs[r].second;
+    unsigned end = r + 1 < buffer.runs.size() ? buffer.runs[r + 1].second
+                                              : buffer.entries.size();
+    for (unsigned i = begin; i < end; ++i) {
+      auto &entry = buffer.entries[i];
+      if (entry.sigIndex < 0) {
+        queue.insertOrUpdate(entry.time, entry.inst);
+        instances[entry.inst].expectedWakeup = entry.time;
+        continue;
+      }
+      auto *value = buffer.values.data() + entry.valueOffset;
+      if (apply && apply(entry, value))
+        continue;
+      queue.insertOrUpdate(entry.time, entry.sigIndex, entry.bitOffset, value,
+                           entry.width);
+    }
+  }
+
+  for (auto &buffer : buffers)
+    buffer.clear();
+}
+
 llvm::SmallVectorTemplateCommon<Instance>::iterator
 State::getInstanceIterator(std::string instName) {
   auto it =
@@ -269,12 +492,14 @@ int State::addSignal(std::string name, std::string owner) {
   return signals.size() - 1;
 }
 
-void State::addProcPtr(std::string name, ProcState *procStatePtr) {
+void State::addProcPtr(std::string name, ProcState *procStatePtr,
+                       uint64_t size) {
   auto it = getInstanceIterator(name);
 
   // Store instance index in process state.
   procStatePtr->inst = it - instances.begin();
   (*it).procState = std::unique_ptr<ProcState>(procStatePtr);
+  (*it).stateSize = size;
 }
 
 int State::addSignalData(int index, std::string owner, uint8_t *value,
@@ -285,30 +510,114 @@ int State::addSignalData(int index, std::string owner, uint8_t *value,
   auto &sig = signals[globalIdx];
 
   // Add pointer and size to global signal table entry.
-  sig.value = std::unique_ptr<uint8_t>(value);
+  sig.value = value;
   sig.size = size;
 
   // Add the value pointer to the signal detail struct for each instance this
   // signal appears in.
-  for (auto inst : signals[globalIdx].triggers) {
-    for (auto &detail : instances[inst].sensitivityList) {
-      if (detail.globalIndex == globalIdx) {
-        detail.value = sig.value.get();
-      }
-    }
+  for (auto trigger : getTriggers(globalIdx)) {
+    instances[trigger.inst].sensitivityList[trigger.slot].value = sig.value;
   }
   return globalIdx;
 }
 
+void State::allocateSignalArena() {
+  assert(!signalArena && "the signal arena is already allocated");
+  constexpr uint64_t cacheLine = 64;
+
+  // Small signals are packed next to each other, while signals spanning
+  // multiple cache lines start on a line of their own. Every signal occupies
+  // twice its size, as done by the allocation in the lowered code.
+  SmallVector<uint64_t, 0> offsets;
+  offsets.reserve(signals.size());
+  uint64_t arenaSize = 0;
+  for (auto &sig : signals) {
+    arenaSize = alignTo(arenaSize, sig.size >= cacheLine ? cacheLine : 8);
+    offsets.push_back(arenaSize);
+    arenaSize += 2 * sig.size;
+  }
+
+  signalArena = std::make_unique<uint8_t[]>(arenaSize + cacheLine);
+  auto *base = reinterpret_cast<uint8_t *>(
+      alignAddr(signalArena.get(), Align(cacheLine)));
+
+  for (size_t i = 0, e = signals.size(); i < e; ++i) {
+    auto &sig = signals[i];
+    auto *value = base + offsets[i];
+    if (sig.value)
+      std::memcpy(value, sig.value, sig.size);
+
+    // Relocate the signal pointers of the instances, preserving their offset
+    // in the signal.
+    for (auto trigger : getTriggers(i)) {
+      auto &detail = instances[trigger.inst].sensitivityList[trigger.slot];
+      if (detail.value)
+        detail.value = value + (detail.value - sig.value);
+    }
+    std::free(sig.value);
+    sig.value = value;
+  }
+}
+
 void State::addSignalElement(unsigned index, unsigned offset, unsigned size) {
   signals[index].elements.push_back(std::make_pair(offset, size));
 }
 
+std::unique_ptr<State> State::cloneLayout() const {
+  auto clone = std::make_unique<State>();
+  clone->root = root;
+
+  // Only copy the parts of the instances and signals built from the design,
+  // leaving the ones filled in by the init function empty.
+  clone->instances.reserve(instances.size());
+  for (auto &inst : instances) {
+    Instance copy(inst.name);
+    copy.path = inst.path;
+    copy.unit = inst.unit;
+    copy.isEntity = inst.isEntity;
+    copy.nArgs = inst.nArgs;
+    copy.sensitivityList = inst.sensitivityList;
+    for (auto &detail : copy.sensitivityList)
+      detail.value = nullptr;
+    copy.probedSlots = inst.probedSlots;
+    copy.drivenSlots = inst.drivenSlots;
+    copy.hasRegisters = inst.hasRegisters;
+    clone->instances.push_back(std::move(copy));
+  }
+  clone->signals.reserve(signals.size());
+  for (auto &sig : signals) {
+    clone->signals.emplace_back(sig.name, sig.owner);
+    clone->signals.back().width = sig.width;
+    clone->signals.back().elementWidths = sig.elementWidths;
+  }
+  clone->triggers = triggers;
+  clone->triggersBegin = triggersBegin;
+  return clone;
+}
+
+void State::buildTriggers() {
+  // Count the triggers of each signal, then fill them in instance order.
+  triggersBegin.assign(signals.size() + 1, 0);
+  for (auto &inst : instances)
+    for (auto &detail : inst.sensitivityList)
+      ++triggersBegin[detail.globalIndex + 1];
+  for (size_t i = 1, e = triggersBegin.size(); i < e; ++i)
+    triggersBegin[i] += triggersBegin[i - 1];
+
+  triggers.resize(triggersBegin.back());
+  std::vector<unsigned> next(triggersBegin.begin(), triggersBegin.end() - 1);
+  for (unsigned i = 0, e = instances.size(); i < e; ++i) {
+    auto &sensList = instances[i].sensitivityList;
+    for (unsigned j = 0, f = sensList.size(); j < f; ++j)
+      triggers[next[sensList[j].globalIndex]++] = {i, j};
+  }
+}
+
 void State::dumpSignal(llvm::raw_ostream &out, int index) {
   auto &sig = signals[index];
-  for (auto inst : sig.triggers) {
-    out << time.dump() << "  " << instances[inst].path << "/" << sig.name
-        << "  " << sig.dump() << "\n";
+  for (auto trigger : getTriggers(index)) {
+    out << time.dump() << "  " << instances[trigger.inst].path << "/"
+        << sig.name << "  " << sig.dump() << "\n";
   }
 }
 
@@ -331,8 +640,8 @@ void State::dumpSignalTriggers() {
   llvm::errs() << "::------------- Signal information -------------::\n";
   for (size_t i = 0, e = signals.size(); i < e; ++i) {
     llvm::errs() << signals[i].owner << "/" << signals[i].name << " triggers: ";
-    for (auto trig : signals[i].triggers) {
-      llvm::errs() << trig << " ";
+    for (auto trigger : getTriggers(i)) {
+      llvm::errs() << trigger.inst << " ";
     }
     llvm::errs() << "\n";
   }
@@ -15,9 +15,14 @@
 #define CIRCT_DIALECT_LLHD_SIMULATOR_STATE_H
 
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
 
+#include <array>
 #include <map>
 #include <queue>
 
@@ -56,6 +61,33 @@ struct Time {
 private:
 };
 
+} // namespace sim
+} // namespace llhd
+} // namespace circt
+
+namespace llvm {
+template <>
+struct DenseMapInfo<circt::llhd::sim::Time> {
+  static circt::llhd::sim::Time getEmptyKey() {
+    return circt::llhd::sim::Time(~0ULL, ~0ULL, ~0ULL);
+  }
+  static circt::llhd::sim::Time getTombstoneKey() {
+    return circt::llhd::sim::Time(~0ULL - 1, ~0ULL, ~0ULL);
+  }
+  static unsigned getHashValue(const circt::llhd::sim::Time &time) {
+    return llvm::hash_combine(time.time, time.delta, time.eps);
+  }
+  static bool isEqual(const circt::llhd::sim::Time &lhs,
+                      const circt::llhd::sim::Time &rhs) {
+    return lhs == rhs;
+  }
+};
+} // namespace llvm
+
+namespace circt {
+namespace llhd {
+namespace sim {
+
 /// Detail structure that can be easily accessed by the lowered code.
 struct SignalDetail {
   uint8_t *value;
@@ -64,6 +96,28 @@ struct SignalDetail {
   uint64_t globalIndex;
 };
 
+/// Log of the drives issued by a unit lowered with drive logs. The lowered code
+/// appends an entry for each drive as long as `size + entry size` fits in
+/// `capacity`, and the simulator drains the log once the unit returns.
+struct DriveLog {
+  uint8_t *data;
+  uint64_t size;
+  uint64_t capacity;
+};
+
+/// Header of an entry in a drive log. It is followed by the driven value,
+/// padded such that `size`, the size of the whole entry, is a multiple of 8.
+struct DriveLogEntry {
+  uint64_t size;
+  uint64_t time;
+  uint64_t delta;
+  uint64_t eps;
+  SignalDetail signal;
+  uint64_t width;
+};
+static_assert(sizeof(DriveLogEntry) == 72,
+              "the drive log entry layout has to match the lowered code");
+
 /// The simulator's internal representation of a signal.
 struct Signal {
   /// Construct an "empty" signal.
@@ -93,13 +147,39 @@ struct Signal {
   /// format.
   std::string dump(unsigned);
 
+  // The value of the signal. Points into the state's signal arena once it is
+  // allocated. The value is followed by `size` bytes of padding, such that
+  // shifts past the end of the signal stay in bounds.
+  uint8_t *value;
+  uint64_t size;
   std::string name;
   std::string owner;
-  // The list of instances this signal triggers.
-  std::vector<unsigned> triggers;
-  uint64_t size;
-  std::unique_ptr<uint8_t> value;
   std::vector<std::pair<unsigned, unsigned>> elements;
+  // The width in bits of the signal's value, and of each of its elements for
+  // signals of array or tuple type. Zero if not known.
+  uint64_t width = 0;
+  std::vector<unsigned> elementWidths;
+};
+
+/// An instance sensitive to a signal.
+struct Trigger {
+  /// The index of the instance.
+  unsigned inst;
+  /// The position of the signal in the instance's sensitivity list, which is
+  /// also the index of its entry in a process's `senses` array.
+  unsigned slot;
+};
+
+/// A signal drive stored in a queue slot. Values up to 64 bits wide are stored
+/// inline, while wider values are stored in the slot's word arena.
+struct Change {
+  /// The bit offset of the drive in the signal.
+  uint64_t bitOffset;
+  /// The width of the driven value in bits.
+  uint64_t width;
+  /// The driven value if it fits in 64 bits, the index of its first word in
+  /// the slot's word arena otherwise.
+  uint64_t value;
 };
 
 /// The simulator's internal representation of one queue slot.
@@ -119,13 +199,19 @@ struct Slot {
   /// Insert a scheduled process wakeup.
   void insertChange(unsigned inst);
 
+  /// Return a pointer to the words holding the value of the given change.
+  const uint64_t *getValue(const Change &change) const {
+    return change.width <= 64 ? &change.value : words.data() + change.value;
+  }
+
   // A map from signal indexes to change buffers. Makes it easy to sort the
   // changes such that we can process one signal at a time.
   llvm::SmallVector<std::pair<unsigned, unsigned>, 32> changes;
   // Buffers for the signal changes.
-  llvm::SmallVector<std::pair<unsigned, llvm::APInt>, 32> buffers;
-  // The number of used change buffers in the slot.
-  size_t changesSize = 0;
+  llvm::SmallVector<Change, 32> buffers;
+  // Storage for the values of changes wider than 64 bits. It is only cleared
+  // when the slot is popped, such that its memory is reused by later events.
+  llvm::SmallVector<uint64_t, 0> words;
 
   // Processes with scheduled wakeup.
   llvm::SmallVector<unsigned, 4> scheduled;
@@ -133,12 +219,40 @@ struct Slot {
   bool unused = false;
 };
 
-/// This is equivalent to and std::priorityQueue<Slot> ordered using the greater
-/// operator, which adds an insertion method to add changes to a slot.
-class UpdateQueue : public llvm::SmallVector<Slot, 8> {
-  unsigned topSlot = 0;
-  llvm::SmallVector<unsigned, 4> unused;
+/// Insert the lowest `width` bits of the little-endian words in `src` into the
+/// `size` bytes long buffer `dst`, starting at bit `bitOffset`. Bits falling
+/// outside the buffer are discarded.
+void insertBits(uint8_t *dst, uint64_t size, const uint64_t *src,
+                uint64_t width, uint64_t bitOffset);
+
+/// Counters describing the load of the event queue over a simulation run.
+struct QueueStatistics {
+  /// The number of slots ever created.
+  uint64_t slotsCreated = 0;
+  /// The maximum number of slots pending at the same time.
+  uint64_t maxPending = 0;
+  /// The number of slots scheduled in the current real-time step.
+  uint64_t nearInserts = 0;
+  /// The number of slots scheduled in the timing wheel.
+  uint64_t wheelInserts = 0;
+  /// The number of slots scheduled beyond the range of the timing wheel.
+  uint64_t overflowInserts = 0;
+  /// The number of slots moved down to a finer wheel level.
+  uint64_t cascades = 0;
+  /// The number of signal drives scheduled.
+  uint64_t drives = 0;
+};
 
+/// The simulator's event queue. Slots scheduled for the real-time step the
+/// queue is currently at are kept in a small binary heap ordered by delta and
+/// epsilon. Slots scheduled for later real-time steps are stored in a
+/// hierarchical timing wheel, where each slot is placed on the level given by
+/// the highest bit in which its real time differs from the current one, and
+/// cascaded down to finer levels as the queue advances. Slots too far in the
+/// future to be represented by the wheel are kept in an overflow heap. A hash
+/// index from time to slot makes it possible to add changes to an existing
+/// slot without searching for it.
+class UpdateQueue {
 public:
   /// Check wheter a slot for the given time already exists. If that's the case,
   /// add the new change to it, else create a new slot and push it to the queue.
@@ -155,6 +269,12 @@ public:
   /// to a fresh slot is returned.
   Slot &getOrCreateSlot(Time time);
 
+  /// Return a reference to the slot with the given timestamp, creating it if
+  /// needed, with room for `numDrives` more signal changes. The caller appends
+  /// the changes to the slot, such that a batch of drives scheduled at the
+  /// same time only looks up the slot once.
+  Slot &getSlotForDrives(Time time, unsigned numDrives);
+
   /// Get a reference to the current top of the queue (the earliest event
   /// available).
   const Slot &top();
@@ -163,7 +283,98 @@ public:
   /// unused and resets its internal structures such that they can be reused.
   void pop();
 
+  /// Return true if no events are pending.
+  bool empty() const { return events == 0; }
+
+  /// Call the given function on every pending slot, in ascending time order.
+  void forEachSlot(llvm::function_ref<void(const Slot &)> fn) const;
+
+  /// Return the load statistics of the queue.
+  const QueueStatistics &getStatistics() const { return stats; }
+
   unsigned events = 0;
+
+private:
+  /// The number of bits of the real time resolved by each wheel level.
+  static constexpr unsigned wheelBits = 8;
+  static constexpr unsigned wheelSize = 1 << wheelBits;
+  static constexpr unsigned wheelLevels = 4;
+
+  /// One level of the timing wheel. A bit is set in `occupied` for each
+  /// non-empty bucket, such that the earliest bucket can be found without
+  /// scanning all of them.
+  struct WheelLevel {
+    std::array<uint64_t, wheelSize / 64> occupied = {};
+    std::array<llvm::SmallVector<unsigned, 2>, wheelSize> buckets;
+    unsigned count = 0;
+  };
+
+  /// Return the wheel level for the given real time, or wheelLevels if it
+  /// does not fit in the wheel.
+  unsigned getLevel(uint64_t time) const;
+
+  /// Place a slot either in the current step heap, in the wheel or in the
+  /// overflow heap, depending on its time.
+  void schedule(unsigned slot);
+
+  /// Move the queue forward to the next real-time step containing events.
+  void advance();
+
+  /// Return true if slot a is scheduled later than slot b. Used to keep the
+  /// heaps ordered as min-heaps.
+  bool isLater(unsigned a, unsigned b) const {
+    return slots[b].time < slots[a].time;
+  }
+
+  llvm::SmallVector<Slot, 8> slots;
+  llvm::SmallVector<unsigned, 4> unused;
+  llvm::DenseMap<Time, unsigned> index;
+  // Slots scheduled in the current real-time step.
+  llvm::SmallVector<unsigned, 8> near;
+  // Slots scheduled in future real-time steps.
+  std::array<WheelLevel, wheelLevels> wheel;
+  // Slots scheduled beyond the range of the wheel.
+  llvm::SmallVector<unsigned, 4> overflow;
+  // The real-time step the queue is currently at.
+  uint64_t now = 0;
+  QueueStatistics stats;
+};
+
+/// Buffer recording the drives and scheduled wakeups issued by the instances
+/// evaluated on one worker thread. The buffers of all the workers are merged in
+/// the event queue once all the instances of a delta cycle have run, in the
+/// same order a sequential evaluation would have inserted them.
+struct DriveBuffer {
+  /// One recorded event. Wakeups are marked by a negative signal index.
+  struct Entry {
+    Time time;
+    int sigIndex;
+    int bitOffset;
+    unsigned width;
+    unsigned inst;
+    size_t valueOffset;
+  };
+
+  /// Mark the beginning of the given instance's evaluation. All the following
+  /// events are attributed to it.
+  void beginInstance(unsigned inst);
+
+  /// Record a signal drive.
+  void insertChange(Time time, int index, int bitOffset, uint8_t *bytes,
+                    unsigned width);
+
+  /// Record a scheduled process wakeup.
+  void insertWakeup(Time time, unsigned inst);
+
+  /// Clear the buffer, keeping its memory for reuse.
+  void clear();
+
+  llvm::SmallVector<Entry, 16> entries;
+  llvm::SmallVector<uint8_t, 64> values;
+  // The instances evaluated on the worker, each with the index of its first
+  // entry.
+  llvm::SmallVector<std::pair<unsigned, unsigned>, 16> runs;
+  unsigned currentInst = 0;
 };
 
 /// State structure for process persistence across suspension.
@@ -193,6 +404,15 @@ struct Instance {
   llvm::SmallVector<SignalDetail, 0> sensitivityList;
   std::unique_ptr<ProcState> procState;
   std::unique_ptr<uint8_t> entityState;
+  // The size in bytes of the process or entity state.
+  uint64_t stateSize = 0;
+  // The byte offsets of the signals a process persists by value in its state.
+  llvm::SmallVector<uint64_t, 0> persistedSignals;
+  // The sensitivity list slots an entity probes and drives with llhd.drv, and
+  // whether it contains registers. Used to levelize the entities.
+  llvm::SmallVector<unsigned, 0> probedSlots;
+  llvm::SmallVector<unsigned, 0> drivenSlots;
+  bool hasRegisters = false;
   Time expectedWakeup;
   // A pointer to the base unit jitted function.
   void (*unitFPtr)(void **);
@@ -214,6 +434,16 @@ struct State {
   /// Push a new scheduled wakeup event in the event queue.
   void pushQueue(Time time, unsigned inst);
 
+  /// Insert the events recorded in the given buffers in the event queue. The
+  /// events are inserted in ascending order of the instance that issued them,
+  /// and in issue order for each instance, and the buffers are cleared. Drives
+  /// for which `apply` returns true are consumed by it instead of being
+  /// inserted.
+  void mergeDriveBuffers(
+      llvm::MutableArrayRef<DriveBuffer> buffers,
+      llvm::function_ref<bool(const DriveBuffer::Entry &, const uint8_t *)>
+          apply = nullptr);
+
   /// Find an instance in the instances list by name and return an
   /// iterator for it.
   llvm::SmallVectorTemplateCommon<Instance>::iterator
@@ -227,8 +457,30 @@ struct State {
 
   void addSignalElement(unsigned, unsigned, unsigned);
 
-  /// Add a pointer to the process persistence state to a process instance.
-  void addProcPtr(std::string name, ProcState *procStatePtr);
+  /// Add a pointer to the process persistence state of `size` bytes to a
+  /// process instance.
+  void addProcPtr(std::string name, ProcState *procStatePtr, uint64_t size);
+
+  /// Move the values of all the signals to a single cache-line aligned arena,
+  /// and update the signal pointers of the instances. Has to be called once the
+  /// design is initialized, before any unit runs.
+  void allocateSignalArena();
+
+  /// Return a new state with the instance layout and the signals of this one,
+  /// to be initialized by another invocation of the design's init function.
+  std::unique_ptr<State> cloneLayout() const;
+
+  /// Build the triggers of all signals from the instances' sensitivity lists.
+  /// Has to be called once the instance layout is complete.
+  void buildTriggers();
+
+  /// Return the instances the signal with the given index triggers, one entry
+  /// for every appearance of the signal in a sensitivity list.
+  llvm::ArrayRef<Trigger> getTriggers(unsigned sigIndex) const {
+    return llvm::makeArrayRef(triggers).slice(
+        triggersBegin[sigIndex],
+        triggersBegin[sigIndex + 1] - triggersBegin[sigIndex]);
+  }
 
   /// Dump a signal to the out stream. One entry is added for every instance
   /// the signal appears in.
@@ -244,6 +496,13 @@ struct State {
   std::string root;
   llvm::SmallVector<Instance, 0> instances;
   llvm::SmallVector<Signal, 0> signals;
+  // The storage of the signal values, in signal order. Allocated with enough
+  // room to align the first signal to a cache line.
+  std::unique_ptr<uint8_t[]> signalArena;
+  // The triggers of all signals, stored contiguously. The triggers of signal
+  // `i` are in the range [triggersBegin[i], triggersBegin[i + 1]).
+  std::vector<Trigger> triggers;
+  std::vector<unsigned> triggersBegin;
   UpdateQueue queue;
 };
 
@@ -13,26 +13,71 @@
 
 #include "Trace.h"
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/GlobPattern.h"
 #include "llvm/Support/raw_ostream.h"
 
-#include <regex>
-
 using namespace circt::llhd::sim;
 
+/// Returns true if the name matches the default signal name pattern
+/// `(sig)?[0-9]*`.
+static bool isDefaultName(llvm::StringRef name) {
+  name.consume_front("sig");
+  return llvm::all_of(name, llvm::isDigit);
+}
+
 Trace::Trace(std::unique_ptr<State> const &state, llvm::raw_ostream &out,
-             TraceMode mode)
+             TraceMode mode, llvm::ArrayRef<llvm::GlobPattern> filters)
     : out(out), state(state), mode(mode) {
   auto root = state->root;
-  for (auto &sig : state->signals) {
-    if (mode != full && mode != merged && sig.owner != root) {
+  // The root is always the last instance in the instances list.
+  unsigned rootInst = state->instances.size() - 1;
+  bool allInstances = mode == full || mode == merged || mode == vcd ||
+                      mode == llhdwave;
+  std::string path;
+
+  llvm::SmallVector<unsigned, 4> insts;
+
+  tracedInstsBegin.reserve(state->signals.size() + 1);
+  for (size_t i = 0, e = state->signals.size(); i < e; ++i) {
+    auto &sig = state->signals[i];
+    tracedInstsBegin.push_back(tracedInsts.size());
+    if (!allInstances && sig.owner != root) {
       isTraced.push_back(false);
-    } else if (mode == namedOnly &&
-               std::regex_match(sig.name, std::regex("(sig)?[0-9]*"))) {
+      continue;
+    }
+    if (mode == namedOnly && isDefaultName(sig.name)) {
       isTraced.push_back(false);
+      continue;
+    }
+
+    insts.clear();
+    if (allInstances) {
+      for (auto trigger : state->getTriggers(i))
+        insts.push_back(trigger.inst);
     } else {
-      isTraced.push_back(true);
+      insts.push_back(rootInst);
+    }
+
+    for (auto inst : insts) {
+      if (!filters.empty()) {
+        path = state->instances[inst].path + '/' + sig.name;
+        if (llvm::none_of(filters, [&](const llvm::GlobPattern &filter) {
+              return filter.match(path);
+            }))
+          continue;
+      }
+      tracedInsts.push_back(inst);
     }
+    isTraced.push_back(tracedInsts.size() > tracedInstsBegin.back());
   }
+  tracedInstsBegin.push_back(tracedInsts.size());
+
+  if (mode == vcd)
+    waveform = createVCDWriter(state, out, *this);
+  else if (mode == llhdwave)
+    waveform = createLLHDWaveWriter(state, out, *this);
 }
 
 //===----------------------------------------------------------------------===//
@@ -80,16 +125,16 @@ void Trace::pushAllChanges(unsigned inst, unsigned sigIndex) {
 
 void Trace::addChange(unsigned sigIndex) {
   currentTime = state->time;
-  if (isTraced[sigIndex]) {
+  if (waveform) {
+    waveform->addChange(sigIndex);
+  } else if (isTraced[sigIndex]) {
     if (mode == full) {
-      auto &sig = state->signals[sigIndex];
       // Add a change for each connected instance.
-      for (auto inst : sig.triggers) {
+      for (auto inst : getTracedInstances(sigIndex)) {
         pushAllChanges(inst, sigIndex);
       }
     } else if (mode == reduced) {
-      // The root is always the last instance in the instances list.
-      pushAllChanges(state->instances.size() - 1, sigIndex);
+      pushAllChanges(getTracedInstances(sigIndex).front(), sigIndex);
     } else if (mode == merged || mode == mergedReduce || mode == namedOnly) {
       addChangeMerged(sigIndex);
     }
@@ -124,7 +169,12 @@ void Trace::sortChanges() {
 }
 
 void Trace::flush(bool force) {
-  if (mode == full || mode == reduced)
+  if (waveform) {
+    if (state->time.time > currentTime.time || force)
+      waveform->flush(currentTime.time);
+    if (force)
+      waveform->finish();
+  } else if (mode == full || mode == reduced)
     flushFull();
   else if (mode == merged || mode == mergedReduce || mode == namedOnly)
     if (state->time.time > currentTime.time || force)
@@ -148,17 +198,11 @@ void Trace::flushMerged() {
   for (auto elem : mergedChanges) {
     auto sigIndex = elem.first.first;
     auto sigElem = elem.first.second;
-    auto &sig = state->signals[sigIndex];
-    auto change = elem.second;
 
-    if (mode == merged) {
-      // Add the changes for all connected instances.
-      for (auto inst : sig.triggers) {
-        pushChange(inst, sigIndex, sigElem);
-      }
-    } else {
-      // The root is always the last instance in the instances list.
-      pushChange(state->instances.size() - 1, sigIndex, sigElem);
+    // Add the changes for all traced instances, only the root in the reduced
+    // formats.
+    for (auto inst : getTracedInstances(sigIndex)) {
+      pushChange(inst, sigIndex, sigElem);
     }
   }
 
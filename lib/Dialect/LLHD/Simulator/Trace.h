@@ -18,11 +18,13 @@
 #define CIRCT_DIALECT_LLHD_SIMULATOR_TRACE_H
 
 #include "State.h"
+#include "Waveform.h"
 
 #include <map>
 #include <vector>
 
 namespace llvm {
+class GlobPattern;
 class raw_ostream;
 } // namespace llvm
 
@@ -30,7 +32,15 @@ namespace circt {
 namespace llhd {
 namespace sim {
 
-enum TraceMode { full, reduced, merged, mergedReduce, namedOnly };
+enum TraceMode {
+  full,
+  reduced,
+  merged,
+  mergedReduce,
+  namedOnly,
+  vcd,
+  llhdwave
+};
 
 class Trace {
   llvm::raw_ostream &out;
@@ -39,12 +49,17 @@ class Trace {
   Time currentTime;
   // Each entry defines if the respective signal is active for tracing.
   std::vector<bool> isTraced;
+  // The instances each signal is traced for, indexed by `tracedInstsBegin`.
+  std::vector<unsigned> tracedInsts;
+  std::vector<unsigned> tracedInstsBegin;
   // Buffer of changes ready to be flushed.
   std::vector<std::pair<std::string, std::string>> changes;
   // Buffer of changes for the merged formats.
   std::map<std::pair<unsigned, int>, std::string> mergedChanges;
   // Buffer of last dumped change for each signal.
   std::map<std::pair<std::string, int>, std::string> lastValue;
+  // The waveform writer used by the vcd and llhdwave formats.
+  std::unique_ptr<WaveformWriter> waveform;
 
   /// Push one change to the changes vector.
   void pushChange(unsigned inst, unsigned sigIndex, int elem);
@@ -64,15 +79,28 @@ class Trace {
   void flushMerged();
 
 public:
+  /// Create a trace for the given mode. If any filter is given, only the
+  /// signals whose hierarchical name, in the form `<instance path>/<signal>`,
+  /// matches one of the filters in one of their instances are traced.
   Trace(std::unique_ptr<State> const &state, llvm::raw_ostream &out,
-        TraceMode mode);
+        TraceMode mode, llvm::ArrayRef<llvm::GlobPattern> filters = {});
+
+  /// Returns true if the signal with the given index is traced.
+  bool isSignalTraced(unsigned sigIndex) const { return isTraced[sigIndex]; }
+
+  /// Return the instances the signal with the given index is traced for.
+  llvm::ArrayRef<unsigned> getTracedInstances(unsigned sigIndex) const {
+    return llvm::makeArrayRef(tracedInsts)
+        .slice(tracedInstsBegin[sigIndex],
+               tracedInstsBegin[sigIndex + 1] - tracedInstsBegin[sigIndex]);
+  }
 
   /// Add a value change to the trace changes buffer.
   void addChange(unsigned);
 
   /// Flush the changes buffer to the output stream. The flush can be forced for
   /// merged changes, flushing even if the next real-time step has not been
-  /// reached.
+  /// reached. A forced flush also terminates the vcd and llhdwave waveforms.
   void flush(bool force = false);
 };
 } // namespace sim
@@ -0,0 +1,377 @@
+//===- Waveform.cpp - Simulation waveform writers -------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the waveform writers used by the llhd-sim tool to dump
+// the signal trace in the VCD and the compressed binary formats.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Waveform.h"
+#include "Trace.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace llvm;
+using namespace circt::llhd::sim;
+
+/// Compare two hierarchical paths component by component, such that all the
+/// children of an instance are sorted right after it.
+static bool pathLess(StringRef lhs, StringRef rhs) {
+  for (size_t i = 0, e = std::min(lhs.size(), rhs.size()); i < e; ++i) {
+    if (lhs[i] == rhs[i])
+      continue;
+    if (lhs[i] == '/')
+      return true;
+    if (rhs[i] == '/')
+      return false;
+    return lhs[i] < rhs[i];
+  }
+  return lhs.size() < rhs.size();
+}
+
+//===----------------------------------------------------------------------===//
+// WaveformWriter
+//===----------------------------------------------------------------------===//
+
+WaveformWriter::WaveformWriter(std::unique_ptr<State> const &state,
+                               raw_ostream &out, const Trace &trace)
+    : out(out), state(state), trace(trace) {}
+
+void WaveformWriter::initialize() {
+  auto &signals = state->signals;
+  unsigned lastOffset = 0;
+  // Fall back to all the bits of a value's bytes if its width is not known.
+  auto getWidth = [](uint64_t width, unsigned size) {
+    return static_cast<unsigned>(
+        width ? std::min<uint64_t>(width, size * 8) : size * 8);
+  };
+
+  firstVariable.reserve(signals.size() + 1);
+  for (size_t i = 0, e = signals.size(); i < e; ++i) {
+    firstVariable.push_back(variables.size());
+    if (!trace.isSignalTraced(i))
+      continue;
+
+    auto &sig = signals[i];
+    if (sig.elements.empty()) {
+      auto size = static_cast<unsigned>(sig.size);
+      variables.push_back({static_cast<unsigned>(i), 0, size,
+                           getWidth(sig.width, size), lastOffset, sig.name});
+      lastOffset += sig.size;
+      continue;
+    }
+    for (size_t j = 0, f = sig.elements.size(); j < f; ++j) {
+      auto elem = sig.elements[j];
+      uint64_t width = j < sig.elementWidths.size() ? sig.elementWidths[j] : 0;
+      variables.push_back({static_cast<unsigned>(i), elem.first, elem.second,
+                           getWidth(width, elem.second), lastOffset,
+                           sig.name + "[" + std::to_string(j) + "]"});
+      lastOffset += elem.second;
+    }
+  }
+  firstVariable.push_back(variables.size());
+  lastValues.resize(lastOffset);
+  isDirty.resize(signals.size());
+
+  // A variable is visible in every instance its signal is traced for.
+  for (unsigned v = 0, e = variables.size(); v < e; ++v) {
+    auto traced = trace.getTracedInstances(variables[v].signal);
+    SmallVector<unsigned, 4> insts(traced.begin(), traced.end());
+    llvm::sort(insts);
+    insts.erase(std::unique(insts.begin(), insts.end()), insts.end());
+    for (auto inst : insts)
+      references.push_back({inst, v});
+  }
+  std::stable_sort(references.begin(), references.end(),
+                   [&](const Reference &lhs, const Reference &rhs) {
+                     if (lhs.inst != rhs.inst)
+                       return pathLess(state->instances[lhs.inst].path,
+                                       state->instances[rhs.inst].path);
+                     return variables[lhs.var].name < variables[rhs.var].name;
+                   });
+
+  initialized = true;
+}
+
+void WaveformWriter::addChange(unsigned sigIndex) {
+  if (!initialized)
+    initialize();
+  if (!trace.isSignalTraced(sigIndex) || isDirty[sigIndex])
+    return;
+  isDirty[sigIndex] = true;
+  dirty.push_back(sigIndex);
+}
+
+void WaveformWriter::flush(uint64_t time) {
+  if (dirty.empty())
+    return;
+
+  changedVars.clear();
+  for (auto sigIndex : dirty) {
+    isDirty[sigIndex] = false;
+    for (unsigned v = firstVariable[sigIndex], e = firstVariable[sigIndex + 1];
+         v < e; ++v) {
+      auto &var = variables[v];
+      auto *value = getValue(var);
+      auto *last = lastValues.data() + var.lastOffset;
+      if (!firstStep && std::memcmp(value, last, var.size) == 0)
+        continue;
+      std::memcpy(last, value, var.size);
+      changedVars.push_back(v);
+    }
+  }
+  dirty.clear();
+
+  if (changedVars.empty())
+    return;
+  llvm::sort(changedVars);
+
+  if (firstStep) {
+    writeHeader();
+    firstStep = false;
+  }
+  writeStep(time, changedVars);
+}
+
+//===----------------------------------------------------------------------===//
+// VCD writer
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Writer for the Value Change Dump format, as defined by IEEE 1364. Signals
+/// are dumped as bit vectors, and signals connected to multiple instances are
+/// declared in each of the instances' scopes with the same identifier.
+class VCDWriter : public WaveformWriter {
+public:
+  using WaveformWriter::WaveformWriter;
+
+  ~VCDWriter() override { finish(); }
+
+  void finish() override {
+    out << buffer;
+    buffer.clear();
+  }
+
+private:
+  void writeHeader() override;
+  void writeStep(uint64_t time, ArrayRef<unsigned> vars) override;
+
+  /// Write the printable identifier code of a variable.
+  void writeIdentifier(unsigned id) {
+    do {
+      buffer.push_back('!' + id % 94);
+      id /= 94;
+    } while (id);
+  }
+
+  /// Output is gathered here and written in large chunks.
+  SmallString<0> buffer;
+  static constexpr size_t bufferSize = 1 << 16;
+};
+} // namespace
+
+void VCDWriter::writeHeader() {
+  raw_svector_ostream os(buffer);
+  os << "$version llhd-sim $end\n";
+  os << "$timescale 1ps $end\n";
+
+  SmallVector<StringRef, 8> scope;
+  unsigned currentInst = ~0U;
+  for (auto &ref : references) {
+    if (ref.inst != currentInst) {
+      currentInst = ref.inst;
+      SmallVector<StringRef, 8> path;
+      StringRef(state->instances[ref.inst].path).split(path, '/');
+
+      // Close the scopes not shared with the new instance, and open its own.
+      size_t common = 0;
+      while (common < scope.size() && common < path.size() &&
+             scope[common] == path[common])
+        ++common;
+      for (size_t i = common, e = scope.size(); i < e; ++i)
+        os << "$upscope $end\n";
+      for (size_t i = common, e = path.size(); i < e; ++i)
+        os << "$scope module " << path[i] << " $end\n";
+      scope = std::move(path);
+    }
+
+    auto &var = variables[ref.var];
+    os << "$var wire " << var.width << ' ';
+    writeIdentifier(ref.var);
+    os << ' ' << var.name << " $end\n";
+  }
+  for (size_t i = 0, e = scope.size(); i < e; ++i)
+    os << "$upscope $end\n";
+  os << "$enddefinitions $end\n";
+}
+
+void VCDWriter::writeStep(uint64_t time, ArrayRef<unsigned> vars) {
+  buffer.push_back('#');
+  buffer.append(utostr(time));
+  buffer.push_back('\n');
+
+  for (auto v : vars) {
+    auto &var = variables[v];
+    auto *value = getValue(var);
+    buffer.push_back('b');
+    for (unsigned bit = var.width; bit-- > 0;)
+      buffer.push_back(value[bit / 8] & (1 << bit % 8) ? '1' : '0');
+
+    buffer.push_back(' ');
+    writeIdentifier(v);
+    buffer.push_back('\n');
+  }
+
+  if (buffer.size() >= bufferSize) {
+    out << buffer;
+    buffer.clear();
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Compressed binary writer
+//===----------------------------------------------------------------------===//
+//
+// The file starts with the magic string "LLHDWAVE", followed by a header and a
+// sequence of blocks. All integers are ULEB128 encoded.
+//
+//   header  ::= version num-vars var-size* num-refs ref*
+//   ref     ::= var-id name-length name
+//   block   ::= 'B' data-size stored-size data
+//   trailer ::= 'E' last-time
+//
+// The reference names are hierarchical paths, with '/' as separator. A block's
+// stored size is zero if its data is stored uncompressed, and the size of the
+// zlib deflated data otherwise. The block data is a sequence of time steps:
+//
+//   step    ::= time-delta num-changes change*
+//   change  ::= var-id-delta value
+//
+// Time deltas are relative to the previous step, starting at zero in each
+// block. Identifier deltas are relative to the previous change in the step.
+// Values are stored as raw little-endian bytes, with the size declared in the
+// header.
+//
+//===----------------------------------------------------------------------===//
+
+namespace {
+class LLHDWaveWriter : public WaveformWriter {
+public:
+  using WaveformWriter::WaveformWriter;
+
+  ~LLHDWaveWriter() override { finish(); }
+
+  void finish() override;
+
+private:
+  void writeHeader() override;
+  void writeStep(uint64_t time, ArrayRef<unsigned> vars) override;
+
+  /// Write the current block to the output stream.
+  void writeBlock();
+
+  static constexpr unsigned version = 1;
+  static constexpr size_t blockSize = 1 << 20;
+
+  SmallString<0> block;
+  SmallVector<char, 0> compressed;
+  uint64_t blockTime = 0;
+  uint64_t lastTime = 0;
+  bool headerWritten = false;
+  bool finished = false;
+};
+} // namespace
+
+void LLHDWaveWriter::writeHeader() {
+  out << "LLHDWAVE";
+  encodeULEB128(version, out);
+  encodeULEB128(variables.size(), out);
+  for (auto &var : variables)
+    encodeULEB128(var.size, out);
+
+  encodeULEB128(references.size(), out);
+  SmallString<128> name;
+  for (auto &ref : references) {
+    name = state->instances[ref.inst].path;
+    name.push_back('/');
+    name.append(variables[ref.var].name);
+    encodeULEB128(ref.var, out);
+    encodeULEB128(name.size(), out);
+    out << name;
+  }
+  headerWritten = true;
+}
+
+void LLHDWaveWriter::writeStep(uint64_t time, ArrayRef<unsigned> vars) {
+  raw_svector_ostream os(block);
+  encodeULEB128(time - blockTime, os);
+  encodeULEB128(vars.size(), os);
+  unsigned lastVar = 0;
+  for (auto v : vars) {
+    auto &var = variables[v];
+    encodeULEB128(v - lastVar, os);
+    os.write(reinterpret_cast<const char *>(getValue(var)), var.size);
+    lastVar = v;
+  }
+  blockTime = time;
+  lastTime = time;
+
+  if (block.size() >= blockSize)
+    writeBlock();
+}
+
+void LLHDWaveWriter::writeBlock() {
+  if (block.empty())
+    return;
+
+  out << 'B';
+  encodeULEB128(block.size(), out);
+
+  StringRef data = block;
+  compressed.clear();
+  if (zlib::isAvailable()) {
+    if (auto err = zlib::compress(block, compressed))
+      consumeError(std::move(err));
+    else if (compressed.size() < block.size())
+      data = StringRef(compressed.data(), compressed.size());
+  }
+  encodeULEB128(data.size() == block.size() ? 0 : data.size(), out);
+  out << data;
+
+  block.clear();
+  blockTime = 0;
+}
+
+void LLHDWaveWriter::finish() {
+  if (!headerWritten || finished)
+    return;
+  writeBlock();
+  out << 'E';
+  encodeULEB128(lastTime, out);
+  finished = true;
+}
+
+std::unique_ptr<WaveformWriter>
+circt::llhd::sim::createVCDWriter(std::unique_ptr<State> const &state,
+                                  raw_ostream &out, const Trace &trace) {
+  return std::make_unique<VCDWriter>(state, out, trace);
+}
+
+std::unique_ptr<WaveformWriter>
+circt::llhd::sim::createLLHDWaveWriter(std::unique_ptr<State> const &state,
+                                       raw_ostream &out, const Trace &trace) {
+  return std::make_unique<LLHDWaveWriter>(state, out, trace);
+}
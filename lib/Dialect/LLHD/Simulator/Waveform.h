@@ -0,0 +1,134 @@
+//===- Waveform.h - Simulation waveform writers -----------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the waveform writers used by the llhd-sim tool to dump the
+// signal trace in the VCD and the compressed binary formats.
+//
+//===----------------------------------------------------------------------===//
+
+// clang-tidy seems to expect the absolute path in the header guard on some
+// systems, so just disable it.
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef CIRCT_DIALECT_LLHD_SIMULATOR_WAVEFORM_H
+#define CIRCT_DIALECT_LLHD_SIMULATOR_WAVEFORM_H
+
+#include "State.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <memory>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+namespace circt {
+namespace llhd {
+namespace sim {
+
+class Trace;
+
+/// Base class of the waveform writers. Every traced signal, or every element of
+/// a traced signal of structured type, is assigned an integer identifier once,
+/// when the first change is recorded. Changes are detected by comparing the
+/// raw bytes of the signal against a copy of the last dumped value, such that
+/// no value or path strings are built while simulating.
+class WaveformWriter {
+public:
+  WaveformWriter(std::unique_ptr<State> const &state, llvm::raw_ostream &out,
+                 const Trace &trace);
+  virtual ~WaveformWriter() = default;
+
+  /// Record a change of the signal with the given index.
+  void addChange(unsigned sigIndex);
+
+  /// Dump the values that changed since the last flush at the given real time.
+  void flush(uint64_t time);
+
+  /// Flush all buffered output and write the format's trailer, if any.
+  virtual void finish() {}
+
+protected:
+  /// A dumped variable, either a full signal or one element of it.
+  struct Variable {
+    /// The global index of the signal.
+    unsigned signal;
+    /// The byte offset of the variable in the signal.
+    unsigned offset;
+    /// The size of the variable in bytes.
+    unsigned size;
+    /// The width of the variable in bits.
+    unsigned width;
+    /// The offset of the last dumped value in `lastValues`.
+    unsigned lastOffset;
+    /// The name of the variable, without hierarchical path.
+    std::string name;
+  };
+
+  /// A hierarchical reference to a variable, one for each instance connected
+  /// to the signal.
+  struct Reference {
+    /// The index of the instance the variable is visible in.
+    unsigned inst;
+    /// The identifier of the variable.
+    unsigned var;
+  };
+
+  /// Write the variable declarations.
+  virtual void writeHeader() = 0;
+
+  /// Write a time step with the given changed variables, sorted by identifier.
+  virtual void writeStep(uint64_t time, llvm::ArrayRef<unsigned> vars) = 0;
+
+  /// Return a pointer to the current value of a variable.
+  const uint8_t *getValue(const Variable &var) const {
+    return state->signals[var.signal].value + var.offset;
+  }
+
+  llvm::raw_ostream &out;
+  std::unique_ptr<State> const &state;
+  std::vector<Variable> variables;
+  /// The variable references, sorted by instance path and variable name.
+  std::vector<Reference> references;
+
+private:
+  /// Assign the variable identifiers, once the signal layout is known.
+  void initialize();
+
+  const Trace &trace;
+  bool initialized = false;
+  /// The first variable of each signal. Has an extra entry at the end.
+  std::vector<unsigned> firstVariable;
+  /// The last dumped value of each variable.
+  std::vector<uint8_t> lastValues;
+  /// Signals changed since the last flush.
+  std::vector<bool> isDirty;
+  llvm::SmallVector<unsigned, 0> dirty;
+  llvm::SmallVector<unsigned, 0> changedVars;
+  bool firstStep = true;
+};
+
+/// Create a writer for the Value Change Dump format.
+std::unique_ptr<WaveformWriter>
+createVCDWriter(std::unique_ptr<State> const &state, llvm::raw_ostream &out,
+                const Trace &trace);
+
+/// Create a writer for the llhd-sim specific compressed binary waveform format.
+/// Value changes are grouped in blocks, which are deflated if zlib is
+/// available. The format is documented in Waveform.cpp.
+std::unique_ptr<WaveformWriter>
+createLLHDWaveWriter(std::unique_ptr<State> const &state,
+                     llvm::raw_ostream &out, const Trace &trace);
+
+} // namespace sim
+} // namespace llhd
+} // namespace circt
+
+#endif // CIRCT_DIALECT_LLHD_SIMULATOR_WAVEFORM_H
@@ -18,6 +18,12 @@
 using namespace llvm;
 using namespace circt::llhd::sim;
 
+/// The buffer recording the events issued on the current thread. Events are
+/// directly inserted in the state's event queue if no buffer is set.
+static thread_local DriveBuffer *activeDriveBuffer = nullptr;
+
+void setDriveBuffer(DriveBuffer *buffer) { activeDriveBuffer = buffer; }
+
 //===----------------------------------------------------------------------===//
 // Runtime interface
 //===----------------------------------------------------------------------===//
@@ -41,38 +47,115 @@ void addSigStructElement(State *state, unsigned index, unsigned offset,
   state->addSignalElement(index, offset, size);
 }
 
-void allocProc(State *state, char *owner, ProcState *procState) {
+void allocProc(State *state, char *owner, ProcState *procState,
+               uint64_t size) {
   assert(state && "alloc_proc: state not found");
   std::string sOwner(owner);
-  state->addProcPtr(sOwner, procState);
+  state->addProcPtr(sOwner, procState, size);
 }
 
-void allocEntity(State *state, char *owner, uint8_t *entityState) {
+void addProcSignalRef(State *state, char *owner, uint64_t offset) {
+  assert(state && "add_proc_signal_ref: state not found");
+  auto it = state->getInstanceIterator(owner);
+  (*it).persistedSignals.push_back(offset);
+}
+
+void allocEntity(State *state, char *owner, uint8_t *entityState,
+                 uint64_t size) {
   assert(state && "alloc_entity: state not found");
   auto it = state->getInstanceIterator(owner);
   (*it).entityState = std::unique_ptr<uint8_t>(entityState);
+  (*it).stateSize = size;
+}
+
+/// Return the bit offset in its signal of the value pointed to by `detail`.
+static int getBitOffset(State *state, const SignalDetail &detail) {
+  return (detail.value - state->signals[detail.globalIndex].value) * 8 +
+         detail.offset;
+}
+
+/// Drive a value onto the signal pointed to by `detail`.
+static void drive(State *state, const SignalDetail &detail, uint8_t *value,
+                  uint64_t width, Time delay) {
+  auto globalIndex = detail.globalIndex;
+  int bitOffset = getBitOffset(state, detail);
+
+  // Spawn a new event, or record it if the instance is evaluated in parallel
+  // with other ones.
+  auto eventTime = state->time + delay;
+  if (activeDriveBuffer)
+    activeDriveBuffer->insertChange(eventTime, globalIndex, bitOffset, value,
+                                    width);
+  else
+    state->queue.insertOrUpdate(eventTime, globalIndex, bitOffset, value,
+                                width);
 }
 
 void driveSignal(State *state, SignalDetail *detail, uint8_t *value,
-                 uint64_t width, int time, int delta, int eps) {
+                 uint64_t width, uint64_t time, uint64_t delta, uint64_t eps) {
   assert(state && "drive_signal: state not found");
+  drive(state, *detail, value, width, Time(time, delta, eps));
+}
 
-  auto globalIndex = detail->globalIndex;
-  auto offset = detail->offset;
+void flushDriveLog(State *state, DriveLog *log) {
+  assert(state && "flush_drive_log: state not found");
+  auto getEntry = [&](uint64_t offset) {
+    return reinterpret_cast<DriveLogEntry *>(log->data + offset);
+  };
+  auto getValue = [&](uint64_t offset) {
+    return log->data + offset + sizeof(DriveLogEntry);
+  };
 
-  int bitOffset =
-      (detail->value - state->signals[globalIndex].value.get()) * 8 + offset;
+  // Instances evaluated in parallel record their drives in the buffer of
+  // their worker, which is merged into the queue after the delta cycle.
+  if (activeDriveBuffer) {
+    for (uint64_t offset = 0; offset < log->size;) {
+      auto *entry = getEntry(offset);
+      drive(state, entry->signal, getValue(offset), entry->width,
+            Time(entry->time, entry->delta, entry->eps));
+      offset += entry->size;
+    }
+    log->size = 0;
+    return;
+  }
+
+  // Merge the log into the change buffers of the queue slots in bulk. The
+  // entries are split in runs sharing the same delay, usually a single one,
+  // and each run is appended to its slot after one lookup.
+  for (uint64_t offset = 0; offset < log->size;) {
+    auto *first = getEntry(offset);
+    uint64_t end = offset;
+    unsigned numDrives = 0;
+    while (end < log->size) {
+      auto *entry = getEntry(end);
+      if (entry->time != first->time || entry->delta != first->delta ||
+          entry->eps != first->eps)
+        break;
+      end += entry->size;
+      ++numDrives;
+    }
 
-  // Spawn a new event.
-  state->queue.insertOrUpdate(state->time + Time(time, delta, eps), globalIndex,
-                              bitOffset, value, width);
+    auto &slot = state->queue.getSlotForDrives(
+        state->time + Time(first->time, first->delta, first->eps), numDrives);
+    while (offset < end) {
+      auto *entry = getEntry(offset);
+      slot.insertChange(entry->signal.globalIndex,
+                        getBitOffset(state, entry->signal), getValue(offset),
+                        entry->width);
+      offset += entry->size;
+    }
+  }
+  log->size = 0;
 }
 
-void llhdSuspend(State *state, ProcState *procState, int time, int delta,
-                 int eps) {
+void llhdSuspend(State *state, ProcState *procState, uint64_t time,
+                 uint64_t delta, uint64_t eps) {
   // Add a new scheduled wake up if a time is specified.
   if (time || delta || eps) {
     Time sTime(time, delta, eps);
-    state->pushQueue(sTime, procState->inst);
+    if (activeDriveBuffer)
+      activeDriveBuffer->insertWakeup(state->time + sTime, procState->inst);
+    else
+      state->pushQueue(sTime, procState->inst);
   }
 }
@@ -15,6 +15,11 @@
 
 #include "State.h"
 
+/// Set the buffer recording the drives and wakeups issued by the instances
+/// evaluated on the calling thread. Passing null makes them go directly to the
+/// event queue again.
+void setDriveBuffer(circt::llhd::sim::DriveBuffer *buffer);
+
 extern "C" {
 
 //===----------------------------------------------------------------------===//
@@ -36,23 +41,34 @@ void addSigArrayElements(circt::llhd::sim::State *state, unsigned index,
 void addSigStructElement(circt::llhd::sim::State *state, unsigned index,
                          unsigned offset, unsigned size);
 
-/// Add allocated constructs to a process instance.
+/// Add allocated constructs to a process instance. `size` is the size of the
+/// process state in bytes, including the persisted values.
 void allocProc(circt::llhd::sim::State *state, char *owner,
-               circt::llhd::sim::ProcState *procState);
+               circt::llhd::sim::ProcState *procState, uint64_t size);
+
+/// Register a signal persisted by value at the given byte offset of a process
+/// state, such that its value pointer can be relocated when restoring a
+/// checkpoint.
+void addProcSignalRef(circt::llhd::sim::State *state, char *owner,
+                      uint64_t offset);
 
-/// Add allocated entity state to the given instance.
+/// Add allocated entity state of `size` bytes to the given instance.
 void allocEntity(circt::llhd::sim::State *state, char *owner,
-                 uint8_t *entityState);
+                 uint8_t *entityState, uint64_t size);
 
 /// Drive a value onto a signal.
 void driveSignal(circt::llhd::sim::State *state,
                  circt::llhd::sim::SignalDetail *index, uint8_t *value,
-                 uint64_t width, int time, int delta, int eps);
+                 uint64_t width, uint64_t time, uint64_t delta, uint64_t eps);
+
+/// Issue the drives recorded in a drive log, in order, and empty it.
+void flushDriveLog(circt::llhd::sim::State *state,
+                   circt::llhd::sim::DriveLog *log);
 
 /// Suspend a process.
 void llhdSuspend(circt::llhd::sim::State *state,
-                 circt::llhd::sim::ProcState *procState, int time, int delta,
-                 int eps);
+                 circt::llhd::sim::ProcState *procState, uint64_t time,
+                 uint64_t delta, uint64_t eps);
 }
 
 #endif // CIRCT_DIALECT_LLHD_SIMULATOR_SIGNALS_RUNTIME_WRAPPERS_H
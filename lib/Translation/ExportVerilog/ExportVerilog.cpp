@@ -20,12 +20,24 @@
 #include "circt/Dialect/SV/SVVisitors.h"
 #include "circt/Support/LLVM.h"
 #include "mlir/IR/BuiltinOps.h"
+#include "mlir/Support/FileUtilities.h"
 #include "mlir/Translation.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LineIterator.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <atomic>
+
 using namespace circt;
 
 using namespace comb;
@@ -405,6 +417,7 @@ public:
       : VerilogEmitterBase(state) {}
 
   void emitMLIRModule(ModuleOp module);
+  void emitTopLevelOperation(Operation &op);
   void emitRTLModule(RTLModuleOp module);
   void emitRTLExternModule(RTLModuleExternOp module);
   void emitExpression(Value exp, SmallPtrSet<Operation *, 8> &emittedExprs,
@@ -2257,17 +2270,20 @@ void ModuleEmitter::emitOperation(Operation *op) {
 }
 
 void ModuleEmitter::emitMLIRModule(ModuleOp module) {
-  for (auto &op : *module.getBody()) {
-    if (auto module = dyn_cast<RTLModuleOp>(op))
-      ModuleEmitter(state).emitRTLModule(module);
-    else if (auto module = dyn_cast<RTLModuleExternOp>(op))
-      ModuleEmitter(state).emitRTLExternModule(module);
-    else if (isa<InterfaceOp>(op) || isa<VerbatimOp>(op) || isa<IfDefOp>(op) ||
-             isa<IfDefProceduralOp>(op))
-      ModuleEmitter(state).emitOperation(&op);
-    else if (!isa<ModuleTerminatorOp>(op))
-      op.emitError("unknown operation");
-  }
+  for (auto &op : *module.getBody())
+    emitTopLevelOperation(op);
+}
+
+void ModuleEmitter::emitTopLevelOperation(Operation &op) {
+  if (auto module = dyn_cast<RTLModuleOp>(op))
+    ModuleEmitter(state).emitRTLModule(module);
+  else if (auto module = dyn_cast<RTLModuleExternOp>(op))
+    ModuleEmitter(state).emitRTLExternModule(module);
+  else if (isa<InterfaceOp>(op) || isa<VerbatimOp>(op) || isa<IfDefOp>(op) ||
+           isa<IfDefProceduralOp>(op))
+    ModuleEmitter(state).emitOperation(&op);
+  else if (!isa<ModuleTerminatorOp>(op))
+    op.emitError("unknown operation");
 }
 
 void ModuleEmitter::emitRTLExternModule(RTLModuleExternOp module) {
@@ -2413,10 +2429,211 @@ void ModuleEmitter::emitRTLModule(RTLModuleOp module) {
 // MLIRModuleEmitter
 //===----------------------------------------------------------------------===//
 
+/// Call `fn` with the index of each of `numOps` top-level operations, on a
+/// thread pool if the context allows multithreading.  The diagnostics of the
+/// calls are reported in the order of the indices.
+static void parallelForEachOp(MLIRContext *context, size_t numOps,
+                              function_ref<void(size_t)> fn) {
+  if (!context->isMultithreadingEnabled() || numOps < 2) {
+    for (size_t i = 0; i != numOps; ++i)
+      fn(i);
+    return;
+  }
+
+  // The reserved words are cached on their first use.  Fill the cache before
+  // the threads share it.
+  (void)getReservedWords();
+
+  mlir::ParallelDiagnosticHandler diagHandler(context);
+  llvm::ThreadPool pool(llvm::hardware_concurrency());
+  for (size_t i = 0; i != numOps; ++i) {
+    pool.async([&, i] {
+      diagHandler.setOrderIDForThread(i);
+      fn(i);
+      diagHandler.eraseOrderIDForThread();
+    });
+  }
+  pool.wait();
+}
+
 LogicalResult circt::exportVerilog(ModuleOp module, llvm::raw_ostream &os) {
-  VerilogEmitterState state(os);
-  ModuleEmitter(state).emitMLIRModule(module);
-  return failure(state.encounteredError);
+  if (!module.getContext()->isMultithreadingEnabled()) {
+    VerilogEmitterState state(os);
+    ModuleEmitter(state).emitMLIRModule(module);
+    return failure(state.encounteredError);
+  }
+
+  // Each top-level operation is emitted into a buffer of its own, in parallel,
+  // and the buffers are then written in order.  The names the emitter picks
+  // are local to each module, so this is the same output.
+  SmallVector<Operation *> ops;
+  for (auto &op : *module.getBody())
+    ops.push_back(&op);
+
+  std::vector<std::string> outputs(ops.size());
+  std::atomic<bool> encounteredError(false);
+  parallelForEachOp(module.getContext(), ops.size(), [&](size_t i) {
+    llvm::raw_string_ostream stringStream(outputs[i]);
+    VerilogEmitterState state(stringStream);
+    ModuleEmitter(state).emitTopLevelOperation(*ops[i]);
+    stringStream.flush();
+    if (state.encounteredError)
+      encounteredError = true;
+  });
+
+  for (auto &output : outputs)
+    os << output;
+  return failure(encounteredError);
+}
+
+/// Return the name of the file a module or interface is emitted to by
+/// exportSplitVerilog.
+static std::string getSplitFileName(Operation *op) {
+  auto name = op->getAttrOfType<StringAttr>(SymbolTable::getSymbolAttrName());
+  return (name.getValue() + ".sv").str();
+}
+
+/// The name of the file in the output directory of exportSplitVerilog that
+/// records the emitted files and their digests, in the format of md5sum.  It
+/// is used to find the files of the modules which are gone.
+static const char manifestName[] = "manifest.md5";
+
+/// Return the MD5 digest of the contents of a file, in hexadecimal.
+static std::string getDigest(StringRef contents) {
+  llvm::MD5 hash;
+  hash.update(contents);
+  llvm::MD5::MD5Result result;
+  hash.final(result);
+  return result.digest().str().str();
+}
+
+/// Read the digests of the files of a manifest.  A missing manifest has none.
+/// Only the plain file names of the output directory are accepted, such that
+/// the stale files removed from a damaged manifest cannot be anywhere else.
+static void readManifest(StringRef path,
+                         llvm::StringMap<std::string> &digests) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return;
+  for (llvm::line_iterator line(**buffer), end; line != end; ++line) {
+    StringRef digest, fileName;
+    std::tie(digest, fileName) = line->split("  ");
+    if (fileName.empty() || fileName.find_first_of("/\\") != StringRef::npos ||
+        fileName.find("..") != StringRef::npos)
+      continue;
+    digests[fileName] = digest.str();
+  }
+}
+
+/// Write a file of the output directory.  If `onlyIfChanged` is set, a file
+/// which already has the given contents is left alone, such that the tools
+/// watching it do not see it modified.
+static LogicalResult writeFile(Operation *op, StringRef path,
+                               StringRef contents, bool onlyIfChanged = true) {
+  if (onlyIfChanged) {
+    auto existing = llvm::MemoryBuffer::getFile(path);
+    if (existing && (*existing)->getBuffer() == contents)
+      return success();
+  }
+  std::string errorMessage;
+  auto output = mlir::openOutputFile(path, &errorMessage);
+  if (!output)
+    return op->emitError(errorMessage);
+  output->os() << contents;
+  output->keep();
+  return success();
+}
+
+LogicalResult circt::exportSplitVerilog(ModuleOp module, StringRef dirname,
+                                        bool incremental) {
+  // The modules and interfaces go into files of their own.  The other
+  // top-level operations, such as the definitions of the macros, are emitted
+  // at the top of each file.
+  std::string header;
+  llvm::raw_string_ostream headerStream(header);
+  VerilogEmitterState headerState(headerStream);
+  SmallVector<Operation *> fileOps;
+  SmallVector<std::string> fileNames;
+  for (auto &op : *module.getBody()) {
+    if (isa<RTLModuleOp>(op) || isa<InterfaceOp>(op)) {
+      fileOps.push_back(&op);
+      fileNames.push_back(getSplitFileName(&op));
+    } else if (!isa<RTLModuleExternOp>(op)) {
+      ModuleEmitter(headerState).emitTopLevelOperation(op);
+    }
+  }
+  headerStream.flush();
+
+  if (auto error = llvm::sys::fs::create_directories(dirname))
+    return module.emitError("cannot create output directory '")
+           << dirname << "': " << error.message();
+
+  SmallString<128> manifestPath(dirname);
+  llvm::sys::path::append(manifestPath, manifestName);
+  llvm::StringMap<std::string> oldDigests;
+  readManifest(manifestPath, oldDigests);
+  std::vector<std::string> digests(fileOps.size());
+
+  std::atomic<bool> encounteredError(headerState.encounteredError);
+  parallelForEachOp(module.getContext(), fileOps.size(), [&](size_t i) {
+    SmallString<128> path(dirname);
+    llvm::sys::path::append(path, fileNames[i]);
+
+    std::string contents;
+    llvm::raw_string_ostream os(contents);
+    os << header;
+    VerilogEmitterState state(os);
+    ModuleEmitter(state).emitTopLevelOperation(*fileOps[i]);
+    os.flush();
+    if (state.encounteredError)
+      encounteredError = true;
+
+    // When emitting incrementally, a file whose contents on disk are those
+    // emitted is left alone, such that the tools reading it do not see it
+    // modified.  Files changed by anything else are written again.
+    if (failed(writeFile(fileOps[i], path, contents, incremental))) {
+      encounteredError = true;
+      return;
+    }
+    digests[i] = getDigest(contents);
+  });
+
+  // List the files in the order of the operations.
+  SmallString<128> filelistPath(dirname);
+  llvm::sys::path::append(filelistPath, "filelist.f");
+  std::string filelist;
+  for (auto &fileName : fileNames)
+    filelist += fileName + '\n';
+  if (failed(writeFile(module, filelistPath, filelist)))
+    return failure();
+
+  // Record the emitted files for the next emission.  An incremental emission
+  // removes the files of the modules which are gone, while the other ones
+  // keep listing them, such that a later incremental emission removes them.
+  std::string manifest;
+  for (size_t i = 0, e = fileNames.size(); i != e; ++i)
+    if (!digests[i].empty())
+      manifest += digests[i] + "  " + fileNames[i] + '\n';
+  llvm::StringSet<> currentFileNames;
+  for (auto &fileName : fileNames)
+    currentFileNames.insert(fileName);
+  SmallVector<StringRef> staleFileNames;
+  for (auto &entry : oldDigests)
+    if (!currentFileNames.count(entry.getKey()))
+      staleFileNames.push_back(entry.getKey());
+  llvm::sort(staleFileNames);
+  for (auto fileName : staleFileNames) {
+    SmallString<128> path(dirname);
+    llvm::sys::path::append(path, fileName);
+    if (incremental)
+      (void)llvm::sys::fs::remove(path);
+    else if (llvm::sys::fs::exists(path))
+      manifest += oldDigests[fileName] + "  " + fileName.str() + '\n';
+  }
+  if (failed(writeFile(module, manifestPath, manifest)))
+    return failure();
+
+  return failure(encounteredError);
 }
 
 void circt::registerToVerilogTranslation() {
@@ -2424,4 +2641,25 @@ void circt::registerToVerilogTranslation() {
       "export-verilog", exportVerilog, [](DialectRegistry &registry) {
         registry.insert<CombDialect, RTLDialect, SVDialect>();
       });
+
+  static llvm::cl::opt<std::string> directory(
+      "split-verilog-dir",
+      llvm::cl::desc("Directory the files of -export-split-verilog are "
+                     "written to"),
+      llvm::cl::init("."));
+
+  static llvm::cl::opt<bool> incremental(
+      "split-verilog-incremental",
+      llvm::cl::desc("Only write the files of -export-split-verilog whose "
+                     "contents changed"),
+      llvm::cl::init(false));
+
+  mlir::TranslateFromMLIRRegistration toSplitVerilog(
+      "export-split-verilog",
+      [](ModuleOp module, llvm::raw_ostream &) {
+        return exportSplitVerilog(module, directory, incremental);
+      },
+      [](DialectRegistry &registry) {
+        registry.insert<CombDialect, RTLDialect, SVDialect>();
+      });
 }
@@ -0,0 +1,38 @@
+// RUN: circt-opt %s --convert-llhd-to-llvm=drive-logs=true | FileCheck %s
+
+// CHECK-LABEL: llvm.func @flushDriveLog(!llvm.ptr<i8>, !llvm.ptr<struct<(ptr<i8>, i64, i64)>>)
+// CHECK-LABEL: llvm.func @driveSignal(
+
+// CHECK-LABEL: llvm.func @drive(
+// CHECK-SAME:    %[[STATE:.*]]: !llvm.ptr<i8>,
+// CHECK-SAME:    %{{.*}}: !llvm.ptr<struct<()>>,
+// CHECK-SAME:    %{{.*}}: !llvm.ptr<struct<(ptr<i8>, i64, i64, i64)>>,
+// CHECK-SAME:    %[[LOG:.*]]: !llvm.ptr<struct<(ptr<i8>, i64, i64)>>) {
+// CHECK:         %[[SIZE:.*]] = llvm.load %{{.*}} : !llvm.ptr<i64>
+// CHECK:         %[[CAPACITY:.*]] = llvm.load %{{.*}} : !llvm.ptr<i64>
+// CHECK:         %[[NEW_SIZE:.*]] = llvm.add %[[SIZE]], %{{.*}} : i64
+// CHECK:         %[[FITS:.*]] = llvm.icmp "ule" %[[NEW_SIZE]], %[[CAPACITY]] : i64
+// CHECK:         llvm.cond_br %[[FITS]], ^[[APPEND:.*]], ^[[FALLBACK:.*]]
+// CHECK:       ^[[APPEND]]:
+// CHECK:         llvm.store %[[NEW_SIZE]], %{{.*}} : !llvm.ptr<i64>
+// CHECK:         llvm.br ^[[CONTINUE:.*]]
+// CHECK:       ^[[FALLBACK]]:
+// CHECK:         llvm.call @flushDriveLog(%[[STATE]], %[[LOG]])
+// CHECK:         llvm.call @driveSignal(%[[STATE]],
+// CHECK:         llvm.br ^[[CONTINUE]]
+// CHECK:       ^[[CONTINUE]]:
+// CHECK:         llvm.return
+llhd.entity @drive () -> () {
+  %0 = llhd.const 0 : i8
+  %s = llhd.sig "s" %0 : i8
+  %1 = llhd.const 1 : i8
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %s, %1 after %t : !llhd.sig<i8>
+}
+
+// The process units take the drive log as last argument as well.
+// CHECK-LABEL: llvm.func @process(
+// CHECK-SAME:    %{{.*}}: !llvm.ptr<struct<(ptr<i8>, i64, i64)>>) {
+llhd.proc @process () -> () {
+  llhd.halt
+}
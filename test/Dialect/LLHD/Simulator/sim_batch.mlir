@@ -0,0 +1,49 @@
+// RUN: llhd-sim %s -T 3000 --checkpoint-at=2000 --checkpoint-file=%t.ckpt --trace-format=merged-reduce > %t.log
+// RUN: llhd-sim %s -T 3000 --batch=init,%t.ckpt,init --trace-format=merged-reduce | FileCheck %s
+// RUN: llhd-sim %s -T 3000 --batch=init,%t.ckpt,init --batch-jobs=2 --trace-format=merged-reduce | FileCheck %s
+// RUN: not llhd-sim %s -T 3000 --batch=init --checkpoint-at=2000 2>&1 | FileCheck %s --check-prefix=ERROR
+// RUN: not llhd-sim %s -T 3000 --batch=init --profile 2>&1 | FileCheck %s --check-prefix=ERROR
+
+// ERROR: --batch cannot be combined with --checkpoint-at, --restore, --profile or --profile-trace
+
+// Each run starts from the initial state or from the given checkpoint,
+// independently of the runs before it, and the traces are written in order.
+// CHECK: 0ps
+// CHECK-NEXT: root/s  0x00
+// CHECK-NEXT: 1000ps
+// CHECK-NEXT: root/s  0x10
+// CHECK-NEXT: 2000ps
+// CHECK-NEXT: root/s  0x20
+// CHECK-NEXT: 3000ps
+// CHECK-NEXT: root/s  0x30
+// CHECK-NEXT: 1000ps
+// CHECK-NEXT: root/s  0x10
+// CHECK-NEXT: 2000ps
+// CHECK-NEXT: root/s  0x20
+// CHECK-NEXT: 3000ps
+// CHECK-NEXT: root/s  0x30
+// CHECK-NEXT: 0ps
+// CHECK-NEXT: root/s  0x00
+// CHECK-NEXT: 1000ps
+// CHECK-NEXT: root/s  0x10
+// CHECK-NEXT: 2000ps
+// CHECK-NEXT: root/s  0x20
+// CHECK-NEXT: 3000ps
+// CHECK-NEXT: root/s  0x30
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i8
+  %s = llhd.sig "s" %0 : i8
+  llhd.inst "cnt" @cnt () -> (%s) : () -> (!llhd.sig<i8>)
+}
+
+llhd.proc @cnt () -> (%s : !llhd.sig<i8>) {
+  %hi = llhd.extract_slice %s, 4 : !llhd.sig<i8> -> !llhd.sig<i4>
+  br ^loop
+^loop:
+  %1 = llhd.prb %hi : !llhd.sig<i4>
+  %c1 = llhd.const 1 : i4
+  %2 = addi %1, %c1 : i4
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %hi, %2 after %t : !llhd.sig<i4>
+  llhd.wait for %t, ^loop
+}
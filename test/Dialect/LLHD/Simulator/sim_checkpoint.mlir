@@ -0,0 +1,54 @@
+// RUN: llhd-sim %s -T 5000 --checkpoint-at=3000 --checkpoint-file=%t.ckpt --trace-format=merged-reduce | FileCheck %s
+// RUN: llhd-sim %s -T 5000 --restore=%t.ckpt --trace-format=merged-reduce | FileCheck %s --check-prefix=RESTORED
+// RUN: %python -c "import sys; d = open(sys.argv[1], 'rb').read(); open(sys.argv[2], 'wb').write(d[:-8] + bytes([255] * 8))" %t.ckpt %t.damaged
+// RUN: not llhd-sim %s -T 5000 --restore=%t.damaged 2>&1 | FileCheck %s --check-prefix=DAMAGED
+// RUN: not llhd-sim %s -T 5000 --checkpoint-at=3000 --checkpoint-file=%t.missing/ckpt 2>&1 | FileCheck %s --check-prefix=UNWRITABLE
+
+// CHECK: 0ps
+// CHECK-NEXT: root/s  0x00
+// CHECK-NEXT: 1000ps
+// CHECK-NEXT: root/s  0x10
+// CHECK-NEXT: 2000ps
+// CHECK-NEXT: root/s  0x20
+// CHECK-NEXT: 3000ps
+// CHECK-NEXT: root/s  0x30
+// CHECK-NEXT: 4000ps
+// CHECK-NEXT: root/s  0x40
+// CHECK-NEXT: 5000ps
+// CHECK-NEXT: root/s  0x50
+
+// The checkpoint is taken after the last step before 3000ps. The process
+// resumes with the persisted signal slice relocated to the restored signal.
+// RESTORED-NOT: 1000ps
+// RESTORED: 2000ps
+// RESTORED-NEXT: root/s  0x20
+// RESTORED-NEXT: 3000ps
+// RESTORED-NEXT: root/s  0x30
+// RESTORED-NEXT: 4000ps
+// RESTORED-NEXT: root/s  0x40
+// RESTORED-NEXT: 5000ps
+// RESTORED-NEXT: root/s  0x50
+
+// The last word of the checkpoint is the process wakeup scheduled at 3000ps.
+// An out-of-range instance index is rejected.
+// DAMAGED: failed to restore checkpoint: checkpoint '{{.*}}.damaged' was taken from a different design
+
+// A checkpoint which cannot be saved fails the run.
+// UNWRITABLE: {{.*}}.missing/ckpt
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i8
+  %s = llhd.sig "s" %0 : i8
+  llhd.inst "cnt" @cnt () -> (%s) : () -> (!llhd.sig<i8>)
+}
+
+llhd.proc @cnt () -> (%s : !llhd.sig<i8>) {
+  %hi = llhd.extract_slice %s, 4 : !llhd.sig<i8> -> !llhd.sig<i4>
+  br ^loop
+^loop:
+  %1 = llhd.prb %hi : !llhd.sig<i4>
+  %c1 = llhd.const 1 : i4
+  %2 = addi %1, %c1 : i4
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %hi, %2 after %t : !llhd.sig<i4>
+  llhd.wait for %t, ^loop
+}
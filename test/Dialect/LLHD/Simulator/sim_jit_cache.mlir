@@ -0,0 +1,31 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: llhd-sim %s -n 4 -r Foo --jit-cache-dir=%t | FileCheck %s
+// RUN: ls %t | FileCheck %s --check-prefix=CACHE
+// RUN: llhd-sim %s -n 4 -r Foo --jit-cache-dir=%t 2>&1 | FileCheck %s --check-prefixes=CHECK,HIT
+
+// A damaged cached object is reported, then replaced by the recompiled
+// design, which the next run loads again.
+// RUN: %python -c "import glob, sys; [open(f, 'w').write('junk') for f in glob.glob(sys.argv[1] + '/*.o')]" %t
+// RUN: llhd-sim %s -n 4 -r Foo --jit-cache-dir=%t 2>&1 | FileCheck %s --check-prefixes=CHECK,JUNK
+// RUN: llhd-sim %s -n 4 -r Foo --jit-cache-dir=%t 2>&1 | FileCheck %s --check-prefixes=CHECK,HIT
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: llhd-sim %s -n 4 -r Foo --jit-cache-dir=%t --compile-threads 2 | FileCheck %s
+// RUN: llhd-sim %s -n 4 -r Foo --jit-cache-dir=%t | FileCheck %s
+
+// CACHE: llhd-sim-{{[0-9A-F]+}}.o
+
+// HIT-NOT: Ignoring the cached object
+// JUNK: Ignoring the cached object {{.*}}llhd-sim-{{[0-9A-F]+}}.o:
+
+// CHECK: 0ps 0d 0e  Foo/toggle  0x00
+// CHECK-NEXT: 1000ps 0d 0e  Foo/toggle  0x01
+// CHECK-NEXT: 2000ps 0d 0e  Foo/toggle  0x00
+// CHECK-NEXT: 3000ps 0d 0e  Foo/toggle  0x01
+llhd.entity @Foo () -> () {
+  %0 = llhd.const 0 : i1
+  %toggle = llhd.sig "toggle" %0 : i1
+  %1 = llhd.prb %toggle : !llhd.sig<i1>
+  %2 = llhd.not %1 : i1
+  %dt = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %toggle, %2 after %dt : !llhd.sig<i1>
+}
@@ -0,0 +1,64 @@
+// RUN: llhd-sim %s -T 4000 --trace-format=merged-reduce | FileCheck %s
+// RUN: llhd-sim %s -T 4000 --trace-format=merged-reduce --levelize | FileCheck %s
+// RUN: llhd-sim %s -T 4000 --trace-format=merged-reduce --levelize -j 4 | FileCheck %s
+
+// The combinational logic settles within the delta cycle of the register
+// update in levelized mode, with the same values at the end of each real-time
+// step as the event-driven mode.
+// CHECK: 0ps
+// CHECK-NEXT:   root/a  0x01
+// CHECK-NEXT:   root/b  0x02
+// CHECK-NEXT:   root/clk  0x00
+// CHECK-NEXT:   root/q  0x00
+// CHECK-NEXT: 1000ps
+// CHECK-NEXT:   root/a  0x03
+// CHECK-NEXT:   root/b  0x04
+// CHECK-NEXT:   root/clk  0x01
+// CHECK-NEXT:   root/q  0x02
+// CHECK-NEXT: 2000ps
+// CHECK-NEXT:   root/clk  0x00
+// CHECK-NEXT: 3000ps
+// CHECK-NEXT:   root/a  0x05
+// CHECK-NEXT:   root/b  0x06
+// CHECK-NEXT:   root/clk  0x01
+// CHECK-NEXT:   root/q  0x04
+// CHECK-NEXT: 4000ps
+// CHECK-NEXT:   root/clk  0x00
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i1
+  %1 = llhd.const 0 : i8
+  %clk = llhd.sig "clk" %0 : i1
+  %q = llhd.sig "q" %1 : i8
+  %a = llhd.sig "a" %1 : i8
+  %b = llhd.sig "b" %1 : i8
+  llhd.inst "clock" @clock () -> (%clk) : () -> (!llhd.sig<i1>)
+  // The logic levels are instantiated in reverse order.
+  llhd.inst "inc1" @inc (%a) -> (%b) : (!llhd.sig<i8>) -> (!llhd.sig<i8>)
+  llhd.inst "inc0" @inc (%q) -> (%a) : (!llhd.sig<i8>) -> (!llhd.sig<i8>)
+  llhd.inst "reg" @reg (%clk, %b) -> (%q) : (!llhd.sig<i1>, !llhd.sig<i8>) -> (!llhd.sig<i8>)
+}
+
+llhd.entity @inc (%in : !llhd.sig<i8>) -> (%out : !llhd.sig<i8>) {
+  %0 = llhd.prb %in : !llhd.sig<i8>
+  %1 = llhd.const 1 : i8
+  %2 = addi %0, %1 : i8
+  %t = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time
+  llhd.drv %out, %2 after %t : !llhd.sig<i8>
+}
+
+llhd.entity @reg (%clk : !llhd.sig<i1>, %d : !llhd.sig<i8>) -> (%q : !llhd.sig<i8>) {
+  %0 = llhd.prb %clk : !llhd.sig<i1>
+  %1 = llhd.prb %d : !llhd.sig<i8>
+  %t = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time
+  llhd.reg %q, (%1, "rise" %0 after %t : i8) : !llhd.sig<i8>
+}
+
+llhd.proc @clock () -> (%clk : !llhd.sig<i1>) {
+  br ^tick
+^tick:
+  %0 = llhd.prb %clk : !llhd.sig<i1>
+  %1 = llhd.not %0 : i1
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %clk, %1 after %t : !llhd.sig<i1>
+  llhd.wait for %t, ^tick
+}
@@ -0,0 +1,24 @@
+// RUN: llhd-sim %s --levelize -n 20 --trace-format=no-trace 2>&1 | FileCheck %s --check-prefix=CYCLES --allow-empty
+// RUN: llhd-sim %s --levelize -n 200 --trace-format=no-trace 2>&1 | FileCheck %s --check-prefix=LOOP
+
+// The passes over an oscillating ring of inverters count against the cycle
+// limit, and the ring goes through the event queue once it does not settle.
+// CYCLES-NOT: Combinational loop
+// LOOP: Combinational loop not settling at 0ps 0d {{[0-9]+}}e after 64 passes, scheduling its drives as events
+// LOOP-NOT: Combinational loop
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i1
+  %a = llhd.sig "a" %0 : i1
+  %b = llhd.sig "b" %0 : i1
+  %c = llhd.sig "c" %0 : i1
+  llhd.inst "inv0" @inv (%a) -> (%b) : (!llhd.sig<i1>) -> (!llhd.sig<i1>)
+  llhd.inst "inv1" @inv (%b) -> (%c) : (!llhd.sig<i1>) -> (!llhd.sig<i1>)
+  llhd.inst "inv2" @inv (%c) -> (%a) : (!llhd.sig<i1>) -> (!llhd.sig<i1>)
+}
+
+llhd.entity @inv (%in : !llhd.sig<i1>) -> (%out : !llhd.sig<i1>) {
+  %0 = llhd.prb %in : !llhd.sig<i1>
+  %1 = llhd.not %0 : i1
+  %t = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time
+  llhd.drv %out, %1 after %t : !llhd.sig<i1>
+}
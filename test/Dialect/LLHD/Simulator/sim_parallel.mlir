@@ -0,0 +1,50 @@
+// RUN: llhd-sim %s -j 1 | FileCheck %s
+// RUN: llhd-sim %s -j 4 | FileCheck %s
+// RUN: llhd-sim %s -j 4 --drive-logs | FileCheck %s
+// RUN: llhd-sim %s -j 4 --compile-threads 4 | FileCheck %s
+
+// Conflicting drives are resolved in instance order, independently of the
+// number of threads used to evaluate the instances.
+// CHECK: 0ps 0d 0e  root/a/s  0x00
+// CHECK-NEXT: 0ps 0d 0e  root/b/s  0x00
+// CHECK-NEXT: 0ps 0d 0e  root/inv/n  0x00
+// CHECK-NEXT: 0ps 0d 0e  root/inv/s  0x00
+// CHECK-NEXT: 0ps 0d 0e  root/n  0x00
+// CHECK-NEXT: 0ps 0d 0e  root/s  0x00
+// CHECK-NEXT: 0ps 0d 1e  root/inv/n  0xff
+// CHECK-NEXT: 0ps 0d 1e  root/n  0xff
+// CHECK-NEXT: 1000ps 0d 0e  root/a/s  0x02
+// CHECK-NEXT: 1000ps 0d 0e  root/b/s  0x02
+// CHECK-NEXT: 1000ps 0d 0e  root/inv/s  0x02
+// CHECK-NEXT: 1000ps 0d 0e  root/s  0x02
+// CHECK-NEXT: 1000ps 0d 1e  root/inv/n  0xfd
+// CHECK-NEXT: 1000ps 0d 1e  root/n  0xfd
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i8
+  %s = llhd.sig "s" %0 : i8
+  %n = llhd.sig "n" %0 : i8
+  llhd.inst "a" @drvA () -> (%s) : () -> (!llhd.sig<i8>)
+  llhd.inst "b" @drvB () -> (%s) : () -> (!llhd.sig<i8>)
+  llhd.inst "inv" @inv (%s) -> (%n) : (!llhd.sig<i8>) -> (!llhd.sig<i8>)
+}
+
+llhd.entity @inv (%in : !llhd.sig<i8>) -> (%out : !llhd.sig<i8>) {
+  %0 = llhd.prb %in : !llhd.sig<i8>
+  %1 = llhd.not %0 : i8
+  %t = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time
+  llhd.drv %out, %1 after %t : !llhd.sig<i8>
+}
+
+llhd.proc @drvA () -> (%s : !llhd.sig<i8>) {
+  %c = llhd.const 1 : i8
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %s, %c after %t : !llhd.sig<i8>
+  llhd.halt
+}
+
+llhd.proc @drvB () -> (%s : !llhd.sig<i8>) {
+  %c = llhd.const 2 : i8
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %s, %c after %t : !llhd.sig<i8>
+  llhd.halt
+}
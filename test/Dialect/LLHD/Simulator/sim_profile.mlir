@@ -0,0 +1,29 @@
+// RUN: llhd-sim %s -n 4 -r Foo --trace-format=no-trace --profile --profile-trace=%t.json 2>&1 | FileCheck %s
+// RUN: FileCheck %s --check-prefix=TRACE < %t.json
+
+// CHECK: Profile
+// CHECK-NEXT: cycles: 4
+// CHECK-NEXT: real-time steps: 4
+// CHECK-NEXT: delta cycles per real-time step: avg 1.00, max 1 at 0ps
+// CHECK-NEXT: pending events per cycle: avg 1.00, max 1
+// CHECK-NEXT: instance invocations: 4, total time {{[0-9.]+}} ms
+// CHECK-NEXT: instances by wall time:
+// CHECK-NEXT: time(ms) share invocations avg(us) instance
+// CHECK-NEXT: {{[0-9.]+}} 100.0% 4 {{[0-9.]+}} Foo (Foo)
+// CHECK-NEXT: signals by changes:
+// CHECK-NEXT: changes signal
+// CHECK-NEXT: 3 Foo/toggle
+
+// TRACE: "traceEvents":[
+// TRACE-SAME: {"name":"queue","ph":"C","ts":{{[0-9.e-]+}},"pid":0,"args":{"pending events":1}}
+// TRACE-SAME: {"name":"Foo","cat":"Foo","ph":"X","ts":{{[0-9.e-]+}},"dur":{{[0-9.e-]+}},"pid":0,"tid":0}
+// TRACE-SAME: "displayTimeUnit":"ns"
+
+llhd.entity @Foo () -> () {
+  %0 = llhd.const 0 : i1
+  %toggle = llhd.sig "toggle" %0 : i1
+  %1 = llhd.prb %toggle : !llhd.sig<i1>
+  %2 = llhd.not %1 : i1
+  %dt = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %toggle, %2 after %dt : !llhd.sig<i1>
+}
@@ -0,0 +1,48 @@
+// RUN: llhd-sim %s | FileCheck %s
+// RUN: llhd-sim %s --trace-format=no-trace --dump-queue-stats 2>&1 | FileCheck %s --check-prefix=STATS
+
+// CHECK: 0ps 0d 0e  root/proc/s  0x00
+// CHECK-NEXT: 0ps 0d 0e  root/s  0x00
+// CHECK-NEXT: 0ps 0d 1e  root/proc/s  0x05
+// CHECK-NEXT: 0ps 0d 1e  root/s  0x05
+// CHECK-NEXT: 0ps 0d 2e  root/proc/s  0x04
+// CHECK-NEXT: 0ps 0d 2e  root/s  0x04
+// CHECK-NEXT: 1000ps 0d 0e  root/proc/s  0x03
+// CHECK-NEXT: 1000ps 0d 0e  root/s  0x03
+// CHECK-NEXT: 300000ps 0d 0e  root/proc/s  0x02
+// CHECK-NEXT: 300000ps 0d 0e  root/s  0x02
+// CHECK-NEXT: 5000000000ps 0d 0e  root/proc/s  0x01
+// CHECK-NEXT: 5000000000ps 0d 0e  root/s  0x01
+
+// STATS: Finished at 5000000000ps 0d 0e
+// STATS: slots created: 5
+// STATS-NEXT: max pending slots: 5
+// STATS-NEXT: current step inserts: 3
+// STATS-NEXT: timing wheel inserts: 2
+// STATS-NEXT: overflow inserts: 1
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i8
+  %1 = llhd.sig "s" %0 : i8
+  llhd.inst "proc" @p () -> (%1) : () -> (!llhd.sig<i8>)
+}
+
+// Schedule drives out of order, such that they are spread across the current
+// step, the timing wheel levels and the overflow queue.
+llhd.proc @p () -> (%s : !llhd.sig<i8>) {
+  %c1 = llhd.const 1 : i8
+  %c2 = llhd.const 2 : i8
+  %c3 = llhd.const 3 : i8
+  %c4 = llhd.const 4 : i8
+  %c5 = llhd.const 5 : i8
+  %t1 = llhd.const #llhd.time<5ms, 0d, 0e> : !llhd.time
+  %t2 = llhd.const #llhd.time<300ns, 0d, 0e> : !llhd.time
+  %t3 = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  %t4 = llhd.const #llhd.time<0ns, 0d, 2e> : !llhd.time
+  %t5 = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time
+  llhd.drv %s, %c1 after %t1 : !llhd.sig<i8>
+  llhd.drv %s, %c2 after %t2 : !llhd.sig<i8>
+  llhd.drv %s, %c3 after %t3 : !llhd.sig<i8>
+  llhd.drv %s, %c4 after %t4 : !llhd.sig<i8>
+  llhd.drv %s, %c5 after %t5 : !llhd.sig<i8>
+  llhd.halt
+}
@@ -0,0 +1,43 @@
+// RUN: llhd-sim %s --trace-filter='root/inv/*' | FileCheck %s
+// RUN: llhd-sim %s --trace-filter='root/inv/*' --trace-filter='root/s' --trace-format=merged | FileCheck %s --check-prefix=MERGED
+// RUN: not llhd-sim %s --trace-filter='root/[' 2>&1 | FileCheck %s --check-prefix=ERR
+
+// CHECK: 0ps 0d 0e  root/inv/n  0x00
+// CHECK-NEXT: 0ps 0d 0e  root/inv/s  0x00
+// CHECK-NEXT: 0ps 0d 1e  root/inv/n  0xff
+// CHECK-NEXT: 1000ps 0d 0e  root/inv/s  0x05
+// CHECK-NEXT: 1000ps 0d 1e  root/inv/n  0xfa
+// CHECK-NOT: root/
+
+// MERGED: 0ps
+// MERGED-NEXT: root/inv/n  0xff
+// MERGED-NEXT: root/inv/s  0x00
+// MERGED-NEXT: root/s  0x00
+// MERGED-NEXT: 1000ps
+// MERGED-NEXT: root/inv/n  0xfa
+// MERGED-NEXT: root/inv/s  0x05
+// MERGED-NEXT: root/s  0x05
+// MERGED-NOT: root/
+
+// ERR: invalid trace filter:
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i8
+  %s = llhd.sig "s" %0 : i8
+  %n = llhd.sig "n" %0 : i8
+  llhd.inst "a" @drv () -> (%s) : () -> (!llhd.sig<i8>)
+  llhd.inst "inv" @inv (%s) -> (%n) : (!llhd.sig<i8>) -> (!llhd.sig<i8>)
+}
+
+llhd.entity @inv (%in : !llhd.sig<i8>) -> (%out : !llhd.sig<i8>) {
+  %0 = llhd.prb %in : !llhd.sig<i8>
+  %1 = llhd.not %0 : i8
+  %t = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time
+  llhd.drv %out, %1 after %t : !llhd.sig<i8>
+}
+
+llhd.proc @drv () -> (%s : !llhd.sig<i8>) {
+  %c = llhd.const 5 : i8
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %s, %c after %t : !llhd.sig<i8>
+  llhd.halt
+}
@@ -0,0 +1,53 @@
+// RUN: llhd-sim %s --trace-format=vcd | FileCheck %s
+// RUN: llhd-sim %s --trace-format=llhdwave | FileCheck %s --check-prefix=WAVE
+
+// Signals connected to multiple instances are declared in each scope with the
+// same identifier, and only the final value of each real-time step is dumped.
+// Values are declared and dumped with the bit width of their signal.
+// CHECK: $timescale 1ps $end
+// CHECK-NEXT: $scope module root $end
+// CHECK-NEXT: $var wire 8 " n $end
+// CHECK-NEXT: $var wire 8 ! s $end
+// CHECK-NEXT: $var wire 4 # w $end
+// CHECK-NEXT: $scope module a $end
+// CHECK-NEXT: $var wire 8 ! s $end
+// CHECK-NEXT: $upscope $end
+// CHECK-NEXT: $scope module inv $end
+// CHECK-NEXT: $var wire 8 " n $end
+// CHECK-NEXT: $var wire 8 ! s $end
+// CHECK-NEXT: $upscope $end
+// CHECK-NEXT: $upscope $end
+// CHECK-NEXT: $enddefinitions $end
+// CHECK-NEXT: #0
+// CHECK-NEXT: b00000000 !
+// CHECK-NEXT: b11111111 "
+// CHECK-NEXT: b0110 #
+// CHECK-NEXT: #1000
+// CHECK-NEXT: b00000101 !
+// CHECK-NEXT: b11111010 "
+// CHECK-NOT: #
+
+// WAVE: LLHDWAVE
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i8
+  %s = llhd.sig "s" %0 : i8
+  %n = llhd.sig "n" %0 : i8
+  %c6 = llhd.const 6 : i4
+  %w = llhd.sig "w" %c6 : i4
+  llhd.inst "a" @drv () -> (%s) : () -> (!llhd.sig<i8>)
+  llhd.inst "inv" @inv (%s) -> (%n) : (!llhd.sig<i8>) -> (!llhd.sig<i8>)
+}
+
+llhd.entity @inv (%in : !llhd.sig<i8>) -> (%out : !llhd.sig<i8>) {
+  %0 = llhd.prb %in : !llhd.sig<i8>
+  %1 = llhd.not %0 : i8
+  %t = llhd.const #llhd.time<0ns, 0d, 1e> : !llhd.time
+  llhd.drv %out, %1 after %t : !llhd.sig<i8>
+}
+
+llhd.proc @drv () -> (%s : !llhd.sig<i8>) {
+  %c = llhd.const 5 : i8
+  %t = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  llhd.drv %s, %c after %t : !llhd.sig<i8>
+  llhd.halt
+}
@@ -0,0 +1,24 @@
+// RUN: llhd-sim %s | FileCheck %s
+// RUN: llhd-sim %s --drive-logs | FileCheck %s
+
+// CHECK: 0ps 0d 0e  root/bus  0x0000000000000000000000000000000000000000000000000000000000000000
+// CHECK-NEXT: 1000ps 0d 0e  root/bus  0x0000000000000000048d159e26af37bc0000007ffffffffffffffffffffffff8
+// CHECK-NEXT: 2000ps 0d 0e  root/bus  0xaa00000000000000048d159e26af37bc0000007ffffffffffffffffffffffff8
+llhd.entity @root () -> () {
+  %0 = llhd.const 0 : i256
+  %bus = llhd.sig "bus" %0 : i256
+  %ones = llhd.const 1267650600228229401496703205375 : i100
+  %word = llhd.const 0x0123456789abcdef : i64
+  %top = llhd.const 0x55 : i7
+  %t1 = llhd.const #llhd.time<1ns, 0d, 0e> : !llhd.time
+  %t2 = llhd.const #llhd.time<2ns, 0d, 0e> : !llhd.time
+  // Unaligned drive wider than a word.
+  %e0 = llhd.extract_slice %bus, 3 : !llhd.sig<i256> -> !llhd.sig<i100>
+  // Unaligned word-sized drive.
+  %e1 = llhd.extract_slice %bus, 130 : !llhd.sig<i256> -> !llhd.sig<i64>
+  // Unaligned drive ending on the last bit of the signal.
+  %e2 = llhd.extract_slice %bus, 249 : !llhd.sig<i256> -> !llhd.sig<i7>
+  llhd.drv %e0, %ones after %t1 : !llhd.sig<i100>
+  llhd.drv %e1, %word after %t1 : !llhd.sig<i64>
+  llhd.drv %e2, %top after %t2 : !llhd.sig<i7>
+}
@@ -0,0 +1,67 @@
+// RUN: rm -rf %t
+// RUN: circt-translate %s -export-split-verilog -split-verilog-dir=%t -split-verilog-incremental
+// RUN: FileCheck %s --check-prefix=MANIFEST < %t/manifest.md5
+
+// Modify Top, and add a file of a module which is gone.  Only Top is written
+// again, and the stale file is removed.
+// RUN: touch -t 200001010000 %t/Leaf.sv
+// RUN: touch -t 200101010000 %t/stamp
+// RUN: echo "// modified" >> %t/Top.sv
+// RUN: echo "00000000000000000000000000000000  Gone.sv" >> %t/manifest.md5
+// RUN: touch %t/Gone.sv
+// RUN: circt-translate %s -export-split-verilog -split-verilog-dir=%t -split-verilog-incremental
+// RUN: find %t -name Leaf.sv -newer %t/stamp | count 0
+// RUN: FileCheck %s --check-prefix=TOP < %t/Top.sv
+// RUN: FileCheck %s --check-prefix=MANIFEST < %t/manifest.md5
+// RUN: not test -e %t/Gone.sv
+
+// Names of the manifest which are not plain file names are ignored, and their
+// files are not removed.
+// RUN: mkdir -p %t/sub
+// RUN: touch %t/sub/Kept.sv
+// RUN: echo "00000000000000000000000000000000  sub/Kept.sv" >> %t/manifest.md5
+// RUN: echo "00000000000000000000000000000000  ../sub/Kept.sv" >> %t/manifest.md5
+// RUN: circt-translate %s -export-split-verilog -split-verilog-dir=%t -split-verilog-incremental
+// RUN: test -e %t/sub/Kept.sv
+// RUN: FileCheck %s --check-prefix=MANIFEST < %t/manifest.md5
+
+// Nothing is written again when nothing changed.
+// RUN: touch -t 200001010000 %t/Leaf.sv %t/Top.sv %t/filelist.f %t/manifest.md5
+// RUN: circt-translate %s -export-split-verilog -split-verilog-dir=%t -split-verilog-incremental
+// RUN: find %t -name Leaf.sv -newer %t/stamp | count 0
+// RUN: find %t -name Top.sv -newer %t/stamp | count 0
+// RUN: find %t -name filelist.f -newer %t/stamp | count 0
+// RUN: find %t -name manifest.md5 -newer %t/stamp | count 0
+
+// A full emission of another design in between is overwritten by the next
+// incremental emission.
+// RUN: echo 'sv.verbatim "// variant"' > %t.variant.mlir
+// RUN: cat %s >> %t.variant.mlir
+// RUN: circt-translate %t.variant.mlir -export-split-verilog -split-verilog-dir=%t
+// RUN: FileCheck %s --check-prefix=VARIANT < %t/Leaf.sv
+// RUN: circt-translate %s -export-split-verilog -split-verilog-dir=%t -split-verilog-incremental
+// RUN: FileCheck %s --check-prefix=LEAF < %t/Leaf.sv
+// RUN: FileCheck %s --check-prefix=TOP < %t/Top.sv
+
+rtl.module @Leaf(%a: i1) -> (%b: i1) {
+  rtl.output %a : i1
+}
+
+rtl.module @Top(%a: i1) -> (%b: i1) {
+  %0 = rtl.instance "leaf" @Leaf(%a) : (i1) -> i1
+  rtl.output %0 : i1
+}
+
+// MANIFEST:      {{^[0-9a-f]+}}  Leaf.sv
+// MANIFEST-NEXT: {{^[0-9a-f]+}}  Top.sv
+// MANIFEST-NOT:  Gone.sv
+// MANIFEST-NOT:  Kept.sv
+
+// VARIANT: // variant
+
+// LEAF-NOT: // variant
+// LEAF:     module Leaf(
+
+// TOP-NOT: // variant
+// TOP:     module Top(
+// TOP-NOT: // modified
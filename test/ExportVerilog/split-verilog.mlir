@@ -0,0 +1,54 @@
+// RUN: rm -rf %t
+// RUN: circt-translate %s -export-split-verilog -split-verilog-dir=%t
+// RUN: FileCheck %s --check-prefix=FILELIST < %t/filelist.f
+// RUN: FileCheck %s --check-prefix=IFACE < %t/data_vr.sv
+// RUN: FileCheck %s --check-prefix=LEAF < %t/Leaf.sv
+// RUN: FileCheck %s --check-prefix=TOP < %t/Top.sv
+// RUN: circt-translate %s -export-verilog | FileCheck %s --check-prefix=SINGLE
+
+sv.verbatim "// Standard header"
+
+sv.interface @data_vr {
+  sv.interface.signal @data : i32
+}
+
+rtl.module.extern @Ext(%a: i1) -> (%b: i1)
+
+rtl.module @Leaf(%a: i1) -> (%b: i1) {
+  rtl.output %a : i1
+}
+
+rtl.module @Top(%a: i1) -> (%b: i1) {
+  %0 = rtl.instance "leaf" @Leaf(%a) : (i1) -> i1
+  %1 = rtl.instance "ext" @Ext(%0) : (i1) -> i1
+  rtl.output %1 : i1
+}
+
+// FILELIST:      data_vr.sv
+// FILELIST-NEXT: Leaf.sv
+// FILELIST-NEXT: Top.sv
+// FILELIST-NOT:  Ext
+
+// IFACE:      // Standard header
+// IFACE:      interface data_vr;
+// IFACE:      endinterface
+
+// LEAF:      // Standard header
+// LEAF:      module Leaf(
+// LEAF-NOT:  module Top
+// LEAF:      endmodule
+
+// TOP:     // Standard header
+// TOP-NOT: module Leaf
+// TOP:     module Top(
+// TOP:       Leaf leaf (
+// TOP:       Ext ext (
+// TOP:     endmodule
+
+// The modules are emitted in order whether or not they are emitted in
+// parallel.
+// SINGLE:      // Standard header
+// SINGLE:      interface data_vr;
+// SINGLE:      // external module Ext
+// SINGLE:      module Leaf(
+// SINGLE:      module Top(
@@ -1,5 +1,6 @@
 // RUN: handshake-runner %s | FileCheck %s
 // RUN: circt-opt -create-dataflow %s | handshake-runner | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner --jit | FileCheck %s
 // CHECK: 0
 
 module {
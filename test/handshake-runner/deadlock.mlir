@@ -0,0 +1,16 @@
+// RUN: handshake-runner %s 1 5 | FileCheck %s
+// RUN: handshake-runner --interpret %s 1 5 | FileCheck %s
+// CHECK: 5
+// RUN: not handshake-runner %s 0 5 2>&1 | FileCheck %s --check-prefix=DEADLOCK
+// RUN: not handshake-runner --interpret %s 0 5 2>&1 | FileCheck %s --check-prefix=DEADLOCK
+// DEADLOCK: error: no operation is ready to execute, the function is deadlocked
+
+// The result is only produced when the condition is true, such that the
+// function waits forever for it otherwise.
+module {
+  handshake.func @main(%arg0: i1, %arg1: index, %arg2: none, ...) -> (index, none) {
+    %0, %1 = "handshake.conditional_branch"(%arg0, %arg1) {control = false} : (i1, index) -> (index, index)
+    "handshake.sink"(%1) : (index) -> ()
+    handshake.return %0, %arg2 : index, none
+  }
+}
@@ -1,5 +1,8 @@
 // RUN: handshake-runner %s 2 | FileCheck %s
 // RUN: circt-opt -create-dataflow %s | handshake-runner - 2 | FileCheck %s
+// RUN: handshake-runner --interpret %s 2 | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner --interpret - 2 | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner --jit - 2 | FileCheck %s
 // CHECK: 1
 
 module {
@@ -0,0 +1,16 @@
+// RUN: handshake-runner --memref-output=%t. %s 5,6,7,8 | FileCheck %s --check-prefix=WRITE
+// RUN: handshake-runner %s @%t.0.bin | FileCheck %s --check-prefix=READ
+// RUN: handshake-runner --map-memrefs=false %s @%t.0.bin | FileCheck %s --check-prefix=READ
+// RUN: handshake-runner --interpret %s @%t.0.bin | FileCheck %s --check-prefix=READ
+// WRITE: 5 @{{.*}}.0.bin
+// READ: 5 5,6,7,5
+
+module {
+  func @main(%0: memref<4xi32>) -> i32 {
+    %c0 = constant 0 : index
+    %c3 = constant 3 : index
+    %1 = load %0[%c0] : memref<4xi32>
+    store %1, %0[%c3] : memref<4xi32>
+    return %1 : i32
+  }
+}
@@ -0,0 +1,25 @@
+// RUN: handshake-runner %s 1.5 2.5,0 | FileCheck %s
+// RUN: handshake-runner --interpret %s 1.5 2.5,0 | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner - 1.5 2.5,0 | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner --interpret - 1.5 2.5,0 | FileCheck %s
+// CHECK: 4 2.5,4
+// RUN: handshake-runner --toplevelFunction=half %s 1 | FileCheck %s --check-prefix=HALF
+// RUN: handshake-runner --interpret --toplevelFunction=half %s 1 | FileCheck %s --check-prefix=HALF
+// HALF: 0
+
+module {
+  func @main(%arg0: f32, %arg1: memref<2xf32>) -> f32 {
+    %c0 = constant 0 : index
+    %c1 = constant 1 : index
+    %0 = load %arg1[%c0] : memref<2xf32>
+    %1 = addf %0, %arg0 : f32
+    store %1, %arg1[%c1] : memref<2xf32>
+    return %1 : f32
+  }
+
+  func @half(%arg0: index) -> f16 {
+    %0 = alloc() : memref<2xf16>
+    %1 = load %0[%arg0] : memref<2xf16>
+    return %1 : f16
+  }
+}
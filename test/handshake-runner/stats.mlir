@@ -0,0 +1,43 @@
+// RUN: circt-opt -create-dataflow -handshake-insert-buffer %s | handshake-runner --runStats --toplevelFunction=loop - | FileCheck %s --check-prefix=LOOP
+// RUN: circt-opt -create-dataflow %s | handshake-runner --runStats --toplevelFunction=loadstore - 2 | FileCheck %s --check-prefix=MEM
+// RUN: circt-opt -create-dataflow %s | handshake-runner --jit --runStats --toplevelFunction=loadstore - 2 | FileCheck %s --check-prefix=MEM
+
+// LOOP: 42
+// LOOP-LABEL: Operation statistics:
+// LOOP: handshake.buffer at {{.*}}: {{[1-9][0-9]*}} fires
+// LOOP-NEXT: occupancy histogram: 0:{{[0-9]+}} 1:{{[0-9]+}} 2:{{[0-9]+}}
+// LOOP: std.addi at {{.*}}: 41 fires
+// LOOP-NEXT: stall cycles per input: {{[0-9]+}} {{[0-9]+}}
+// LOOP-LABEL: Critical path, {{[1-9][0-9]*}} cycles:
+// LOOP: {{[0-9]+}}: #{{[0-9]+}} std.addi at
+
+// MEM: 1
+// MEM-LABEL: Operation statistics:
+// MEM: handshake.memory at {{.*}}: {{[1-9][0-9]*}} fires
+// MEM: port accesses: load0 1 ({{[0-9.]+}}%) store0 1 ({{[0-9.]+}}%)
+// MEM-LABEL: Critical path, {{[1-9][0-9]*}} cycles:
+// MEM: {{[0-9]+}}: #{{[0-9]+}} handshake.memory at
+
+module {
+  func @loop() -> index {
+    %c1 = constant 1 : index
+    %c42 = constant 42 : index
+    br ^bb1(%c1 : index)
+  ^bb1(%0: index):
+    %1 = cmpi slt, %0, %c42 : index
+    cond_br %1, ^bb2, ^bb3
+  ^bb2:
+    %2 = addi %0, %c1 : index
+    br ^bb1(%2 : index)
+  ^bb3:
+    return %0 : index
+  }
+
+  func @loadstore(%arg0: index) -> (i8) {
+    %0 = alloc() : memref<10xi8>
+    %c1 = constant 1 : i8
+    store %c1, %0[%arg0] : memref<10xi8>
+    %1 = load %0[%arg0] : memref<10xi8>
+    return %1 : i8
+  }
+}
@@ -0,0 +1,24 @@
+// RUN: echo 1 > %t.vectors
+// RUN: echo 2 >> %t.vectors
+// RUN: echo "# Blank lines and comments are skipped." >> %t.vectors
+// RUN: echo >> %t.vectors
+// RUN: echo 3 >> %t.vectors
+// RUN: echo 4 >> %t.vectors
+// RUN: echo 5 >> %t.vectors
+// RUN: handshake-runner --input-vectors=%t.vectors --threads=4 %s | FileCheck %s
+// RUN: handshake-runner --interpret --input-vectors=%t.vectors %s | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner --input-vectors=%t.vectors - | FileCheck %s
+// RUN: circt-opt -create-dataflow %s | handshake-runner --jit --input-vectors=%t.vectors - | FileCheck %s
+// CHECK: 3
+// CHECK-NEXT: 6
+// CHECK-NEXT: 9
+// CHECK-NEXT: 12
+// CHECK-NEXT: 15
+
+module {
+  func @main(%arg0: index) -> index {
+    %c3 = constant 3 : index
+    %0 = muli %arg0, %c3 : index
+    return %0 : index
+  }
+}
@@ -78,12 +78,31 @@ static cl::opt<bool>
                        cl::desc("ignore the @info locations in the .fir file"),
                        cl::init(false));
 
-enum OutputFormatKind { OutputMLIR, OutputVerilog, OutputDisabled };
+static cl::opt<bool>
+    parseInParallel("parse-in-parallel",
+                    cl::desc("parse the modules of the .fir file in parallel"),
+                    cl::init(false));
+
+static cl::opt<bool> incrementalVerilog(
+    "incremental",
+    cl::desc("with -split-verilog, only write the files whose contents "
+             "changed since the last run"),
+    cl::init(false));
+
+enum OutputFormatKind {
+  OutputMLIR,
+  OutputVerilog,
+  OutputSplitVerilog,
+  OutputDisabled
+};
 
 static cl::opt<OutputFormatKind> outputFormat(
     cl::desc("Specify output format:"),
     cl::values(clEnumValN(OutputMLIR, "mlir", "Emit MLIR dialect"),
                clEnumValN(OutputVerilog, "verilog", "Emit Verilog"),
+               clEnumValN(OutputSplitVerilog, "split-verilog",
+                          "Emit Verilog, one file per module, into the "
+                          "directory named by -o"),
                clEnumValN(OutputDisabled, "disable-output",
                           "Do not output anything")),
     cl::init(OutputMLIR));
@@ -107,8 +126,10 @@ processBuffer(std::unique_ptr<llvm::MemoryBuffer> ownedBuffer,
   sourceMgr.AddNewSourceBuffer(std::move(ownedBuffer), llvm::SMLoc());
   SourceMgrDiagnosticHandler sourceMgrHandler(sourceMgr, &context);
 
-  // Nothing in the parser is threaded.  Disable synchronization overhead.
-  context.disableMultithreading();
+  // Nothing in the parser is threaded, unless it parses the modules in
+  // parallel.  Disable synchronization overhead.
+  if (!parseInParallel)
+    context.disableMultithreading();
 
   // Apply any pass manager command line options.
   PassManager pm(&context);
@@ -119,6 +140,7 @@ processBuffer(std::unique_ptr<llvm::MemoryBuffer> ownedBuffer,
   if (inputFormat == InputFIRFile) {
     firrtl::FIRParserOptions options;
     options.ignoreInfoLocators = ignoreFIRLocations;
+    options.parseModulesInParallel = parseInParallel;
     module = importFIRRTL(sourceMgr, &context, options);
 
     // If we parsed a FIRRTL file and have optimizations enabled, clean it up.
@@ -169,6 +191,9 @@ processBuffer(std::unique_ptr<llvm::MemoryBuffer> ownedBuffer,
     if (lowerToRTL)
       return exportVerilog(module.get(), os);
     return exportFIRRTLToVerilog(module.get(), os);
+  case OutputSplitVerilog:
+    return exportSplitVerilog(module.get(), outputFilename,
+                              incrementalVerilog);
   }
 };
 
@@ -203,15 +228,28 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  auto output = openOutputFile(outputFilename, &errorMessage);
-  if (!output) {
-    llvm::errs() << errorMessage << "\n";
-    return 1;
+  // Split Verilog is written to the directory named by the output filename,
+  // rather than to the output file.
+  std::unique_ptr<ToolOutputFile> output;
+  if (outputFormat == OutputSplitVerilog) {
+    if (!lowerToRTL || outputFilename == "-") {
+      llvm::errs() << "-split-verilog requires -lower-to-rtl and an output "
+                      "directory specified with -o\n";
+      return 1;
+    }
+  } else {
+    output = openOutputFile(outputFilename, &errorMessage);
+    if (!output) {
+      llvm::errs() << errorMessage << "\n";
+      return 1;
+    }
   }
 
-  if (failed(processBuffer(std::move(input), output->os())))
+  if (failed(processBuffer(std::move(input),
+                           output ? output->os() : llvm::nulls())))
     return 1;
 
-  output->keep();
+  if (output)
+    output->keep();
   return 0;
 }
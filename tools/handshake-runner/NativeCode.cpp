@@ -0,0 +1,555 @@
+//===- NativeCode.cpp - Native code of handshake functions ----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the compilation of the instructions of a pre-compiled
+// handshake function to LLVM IR, one function per instruction, which is then
+// compiled to native code by the LLVM JIT.
+//
+//===----------------------------------------------------------------------===//
+
+#include "NativeCode.h"
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include <algorithm>
+
+namespace sim = circt::handshake::sim;
+
+using sim::InstKind;
+using sim::NativeFunction;
+using sim::SlotKind;
+
+namespace {
+/// Emit the LLVM IR function firing each instruction of a handshake function.
+class FireBuilder {
+public:
+  FireBuilder(const sim::Function &func, llvm::Module &module)
+      : func(func), module(module), context(module.getContext()),
+        builder(context) {}
+
+  /// Emit the function firing the given instruction, or return false if the
+  /// program has to fire it.
+  bool emit(unsigned index, llvm::StringRef name);
+
+private:
+  unsigned operand(unsigned i) const {
+    return func.slotList[inst->operands + i];
+  }
+  unsigned result(unsigned i) const {
+    return func.slotList[inst->results + i];
+  }
+  bool isNative(unsigned slot) const {
+    return func.slots[slot].kind != SlotKind::WideInt;
+  }
+
+  // Access the slots, at a constant or computed index.
+  llvm::Value *index(unsigned slot) { return builder.getInt64(slot); }
+  llvm::Value *bitsPtr(llvm::Value *slot) {
+    return builder.CreateInBoundsGEP(builder.getInt64Ty(), bits, slot);
+  }
+  llvm::Value *timePtr(llvm::Value *slot) {
+    return builder.CreateInBoundsGEP(builder.getDoubleTy(), times, slot);
+  }
+  llvm::Value *validPtr(llvm::Value *slot) {
+    return builder.CreateInBoundsGEP(builder.getInt8Ty(), valid, slot);
+  }
+  llvm::Value *isValid(llvm::Value *slot) {
+    return builder.CreateICmpNE(
+        builder.CreateLoad(builder.getInt8Ty(), validPtr(slot)),
+        builder.getInt8(0));
+  }
+  llvm::Value *isValid(unsigned slot) { return isValid(index(slot)); }
+  void setValid(llvm::Value *slot, bool value) {
+    builder.CreateStore(builder.getInt8(value), validPtr(slot));
+  }
+  void setValid(unsigned slot, bool value) { setValid(index(slot), value); }
+  llvm::Value *loadTime(llvm::Value *slot) {
+    return builder.CreateLoad(builder.getDoubleTy(), timePtr(slot));
+  }
+  llvm::Value *loadTime(unsigned slot) { return loadTime(index(slot)); }
+  void storeTime(llvm::Value *slot, llvm::Value *time) {
+    builder.CreateStore(time, timePtr(slot));
+  }
+  void storeTime(unsigned slot, llvm::Value *time) {
+    storeTime(index(slot), time);
+  }
+  llvm::Value *loadBits(llvm::Value *slot) {
+    return builder.CreateLoad(builder.getInt64Ty(), bitsPtr(slot));
+  }
+  llvm::Value *loadBits(unsigned slot) { return loadBits(index(slot)); }
+  void storeBits(llvm::Value *slot, llvm::Value *value) {
+    builder.CreateStore(value, bitsPtr(slot));
+  }
+  void storeBits(unsigned slot, llvm::Value *value) {
+    storeBits(index(slot), value);
+  }
+  void copy(llvm::Value *dst, llvm::Value *src) {
+    storeBits(dst, loadBits(src));
+  }
+  void copy(unsigned dst, unsigned src) { copy(index(dst), index(src)); }
+
+  /// Load an integer token at its width, and store one zero-extended.
+  llvm::Value *loadInt(unsigned slot) {
+    return builder.CreateTrunc(loadBits(slot),
+                               builder.getIntNTy(func.slots[slot].width));
+  }
+  void storeInt(unsigned slot, llvm::Value *value) {
+    storeBits(slot, builder.CreateZExt(value, builder.getInt64Ty()));
+  }
+  /// Load a float token as a double, and store one rounded to the precision
+  /// of the slot.
+  llvm::Value *loadFloat(unsigned slot) {
+    return builder.CreateBitCast(loadBits(slot), builder.getDoubleTy());
+  }
+  void storeFloat(unsigned slot, llvm::Value *value) {
+    if (func.slots[slot].kind == SlotKind::Float)
+      value = builder.CreateFPExt(
+          builder.CreateFPTrunc(value, builder.getFloatTy()),
+          builder.getDoubleTy());
+    storeBits(slot, builder.CreateBitCast(value, builder.getInt64Ty()));
+  }
+
+  /// The latest of two times, as std::max.
+  llvm::Value *maxTime(llvm::Value *lhs, llvm::Value *rhs) {
+    return builder.CreateSelect(builder.CreateFCmpOLT(lhs, rhs), rhs, lhs);
+  }
+
+  /// Mark a result as produced, at the given position of `produced`.
+  void produce(unsigned position, llvm::Value *slot) {
+    builder.CreateStore(
+        builder.CreateTrunc(slot, builder.getInt32Ty()),
+        builder.CreateConstInBoundsGEP1_32(builder.getInt32Ty(), produced,
+                                           position));
+  }
+
+  /// Branch to a block returning -1, unless the condition holds.
+  void notReadyUnless(llvm::Value *cond) {
+    auto *ready = llvm::BasicBlock::Create(context, "ready", fn);
+    auto *notReady = llvm::BasicBlock::Create(context, "not_ready", fn);
+    builder.CreateCondBr(cond, ready, notReady);
+    builder.SetInsertPoint(notReady);
+    builder.CreateRet(builder.getInt32(-1));
+    builder.SetInsertPoint(ready);
+  }
+
+  bool emitCompute();
+  void emitAllOperands();
+  void emitMerge();
+  void emitMux();
+  void emitConditionalBranch();
+  void emitLoad();
+
+  const sim::Function &func;
+  llvm::Module &module;
+  llvm::LLVMContext &context;
+  llvm::IRBuilder<> builder;
+
+  // The instruction and the function being emitted.
+  const sim::Instruction *inst = nullptr;
+  llvm::Function *fn = nullptr;
+  llvm::Value *bits = nullptr, *times = nullptr, *valid = nullptr,
+              *produced = nullptr;
+};
+} // namespace
+
+static llvm::CmpInst::Predicate getPredicate(mlir::CmpIPredicate predicate) {
+  switch (predicate) {
+  case mlir::CmpIPredicate::eq:
+    return llvm::CmpInst::ICMP_EQ;
+  case mlir::CmpIPredicate::ne:
+    return llvm::CmpInst::ICMP_NE;
+  case mlir::CmpIPredicate::slt:
+    return llvm::CmpInst::ICMP_SLT;
+  case mlir::CmpIPredicate::sle:
+    return llvm::CmpInst::ICMP_SLE;
+  case mlir::CmpIPredicate::sgt:
+    return llvm::CmpInst::ICMP_SGT;
+  case mlir::CmpIPredicate::sge:
+    return llvm::CmpInst::ICMP_SGE;
+  case mlir::CmpIPredicate::ult:
+    return llvm::CmpInst::ICMP_ULT;
+  case mlir::CmpIPredicate::ule:
+    return llvm::CmpInst::ICMP_ULE;
+  case mlir::CmpIPredicate::ugt:
+    return llvm::CmpInst::ICMP_UGT;
+  case mlir::CmpIPredicate::uge:
+    return llvm::CmpInst::ICMP_UGE;
+  }
+  llvm_unreachable("unknown integer comparison predicate");
+}
+
+static llvm::CmpInst::Predicate getPredicate(mlir::CmpFPredicate predicate) {
+  switch (predicate) {
+  case mlir::CmpFPredicate::AlwaysFalse:
+    return llvm::CmpInst::FCMP_FALSE;
+  case mlir::CmpFPredicate::OEQ:
+    return llvm::CmpInst::FCMP_OEQ;
+  case mlir::CmpFPredicate::OGT:
+    return llvm::CmpInst::FCMP_OGT;
+  case mlir::CmpFPredicate::OGE:
+    return llvm::CmpInst::FCMP_OGE;
+  case mlir::CmpFPredicate::OLT:
+    return llvm::CmpInst::FCMP_OLT;
+  case mlir::CmpFPredicate::OLE:
+    return llvm::CmpInst::FCMP_OLE;
+  case mlir::CmpFPredicate::ONE:
+    return llvm::CmpInst::FCMP_ONE;
+  case mlir::CmpFPredicate::ORD:
+    return llvm::CmpInst::FCMP_ORD;
+  case mlir::CmpFPredicate::UEQ:
+    return llvm::CmpInst::FCMP_UEQ;
+  case mlir::CmpFPredicate::UGT:
+    return llvm::CmpInst::FCMP_UGT;
+  case mlir::CmpFPredicate::UGE:
+    return llvm::CmpInst::FCMP_UGE;
+  case mlir::CmpFPredicate::ULT:
+    return llvm::CmpInst::FCMP_ULT;
+  case mlir::CmpFPredicate::ULE:
+    return llvm::CmpInst::FCMP_ULE;
+  case mlir::CmpFPredicate::UNE:
+    return llvm::CmpInst::FCMP_UNE;
+  case mlir::CmpFPredicate::UNO:
+    return llvm::CmpInst::FCMP_UNO;
+  case mlir::CmpFPredicate::AlwaysTrue:
+    return llvm::CmpInst::FCMP_TRUE;
+  }
+  llvm_unreachable("unknown float comparison predicate");
+}
+
+/// Emit the computation of the results from the operands, as the compute
+/// handlers of the program.
+bool FireBuilder::emitCompute() {
+  using sim::ComputeOp;
+  auto intBinary = [&](llvm::Instruction::BinaryOps opcode) {
+    storeInt(result(0), builder.CreateBinOp(opcode, loadInt(operand(0)),
+                                            loadInt(operand(1))));
+  };
+  auto floatBinary = [&](llvm::Instruction::BinaryOps opcode) {
+    storeFloat(result(0), builder.CreateBinOp(opcode, loadFloat(operand(0)),
+                                              loadFloat(operand(1))));
+  };
+
+  switch (inst->computeOp) {
+  case ComputeOp::Constant:
+    storeBits(result(0),
+              builder.getInt64(func.constants[inst->aux].getZExtValue()));
+    return true;
+  case ComputeOp::AddI:
+    intBinary(llvm::Instruction::Add);
+    return true;
+  case ComputeOp::SubI:
+    intBinary(llvm::Instruction::Sub);
+    return true;
+  case ComputeOp::MulI:
+    intBinary(llvm::Instruction::Mul);
+    return true;
+  case ComputeOp::SignedDivI:
+    intBinary(llvm::Instruction::SDiv);
+    return true;
+  case ComputeOp::UnsignedDivI:
+    intBinary(llvm::Instruction::UDiv);
+    return true;
+  case ComputeOp::CmpI:
+    storeInt(result(0),
+             builder.CreateICmp(
+                 getPredicate(static_cast<mlir::CmpIPredicate>(inst->aux)),
+                 loadInt(operand(0)), loadInt(operand(1))));
+    return true;
+  case ComputeOp::AddF:
+    floatBinary(llvm::Instruction::FAdd);
+    return true;
+  case ComputeOp::SubF:
+    floatBinary(llvm::Instruction::FSub);
+    return true;
+  case ComputeOp::MulF:
+    floatBinary(llvm::Instruction::FMul);
+    return true;
+  case ComputeOp::DivF:
+    floatBinary(llvm::Instruction::FDiv);
+    return true;
+  case ComputeOp::CmpF:
+    storeInt(result(0),
+             builder.CreateFCmp(
+                 getPredicate(static_cast<mlir::CmpFPredicate>(inst->aux)),
+                 loadFloat(operand(0)), loadFloat(operand(1))));
+    return true;
+  case ComputeOp::SignExtendI:
+    storeInt(result(0),
+             builder.CreateSExtOrTrunc(
+                 loadInt(operand(0)),
+                 builder.getIntNTy(func.slots[result(0)].width)));
+    return true;
+  case ComputeOp::ZeroExtendI:
+    storeInt(result(0),
+             builder.CreateZExtOrTrunc(
+                 loadInt(operand(0)),
+                 builder.getIntNTy(func.slots[result(0)].width)));
+    return true;
+  case ComputeOp::Forward:
+    for (unsigned i = 0; i < inst->numResults; ++i)
+      copy(result(i), operand(i));
+    return true;
+  case ComputeOp::Fork:
+    for (unsigned i = 0; i < inst->numResults; ++i)
+      copy(result(i), operand(0));
+    return true;
+  case ComputeOp::None:
+    return true;
+  }
+  return false;
+}
+
+/// Emit the firing of a compute or general instruction, consuming all the
+/// operands and producing all the results after the latency.
+void FireBuilder::emitAllOperands() {
+  if (inst->kind == InstKind::General) {
+    llvm::Value *ready = builder.getTrue();
+    for (unsigned i = 0; i < inst->numOperands; ++i)
+      ready = builder.CreateAnd(ready, isValid(operand(i)));
+    for (unsigned i = 0; i < inst->numResults; ++i)
+      ready = builder.CreateAnd(ready, builder.CreateNot(isValid(result(i))));
+    notReadyUnless(ready);
+  }
+
+  llvm::Value *time = llvm::ConstantFP::get(builder.getDoubleTy(), 0.0);
+  for (unsigned i = 0; i < inst->numOperands; ++i) {
+    time = maxTime(time, loadTime(operand(i)));
+    setValid(operand(i), false);
+  }
+  time = builder.CreateFAdd(
+      time, llvm::ConstantFP::get(builder.getDoubleTy(), inst->latency));
+  emitCompute();
+  for (unsigned i = 0; i < inst->numResults; ++i) {
+    storeTime(result(i), time);
+    setValid(result(i), true);
+    produce(i, index(result(i)));
+  }
+  builder.CreateRet(builder.getInt32(inst->numResults));
+}
+
+/// Emit the firing of a merge or control merge, taking the operands holding a
+/// token in order, the last one winning.
+void FireBuilder::emitMerge() {
+  llvm::Value *found = builder.getFalse();
+  for (unsigned i = 0; i < inst->numOperands; ++i) {
+    auto *check = builder.GetInsertBlock();
+    auto *take = llvm::BasicBlock::Create(context, "take", fn);
+    auto *next = llvm::BasicBlock::Create(context, "next", fn);
+    builder.CreateCondBr(isValid(operand(i)), take, next);
+
+    builder.SetInsertPoint(take);
+    auto *time = loadTime(operand(i));
+    copy(result(0), operand(i));
+    storeTime(result(0), time);
+    if (inst->kind == InstKind::ControlMerge) {
+      storeBits(result(1), builder.getInt64(i));
+      storeTime(result(1), time);
+    }
+    setValid(operand(i), false);
+    builder.CreateBr(next);
+
+    builder.SetInsertPoint(next);
+    auto *phi = builder.CreatePHI(builder.getInt1Ty(), 2);
+    phi->addIncoming(found, check);
+    phi->addIncoming(builder.getTrue(), take);
+    found = phi;
+  }
+  notReadyUnless(found);
+  for (unsigned i = 0; i < inst->numResults; ++i) {
+    setValid(result(i), true);
+    produce(i, index(result(i)));
+  }
+  builder.CreateRet(builder.getInt32(inst->numResults));
+}
+
+void FireBuilder::emitMux() {
+  unsigned select = operand(0);
+  notReadyUnless(isValid(select));
+  auto *in = builder.CreateSelect(
+      builder.CreateICmpEQ(loadInt(select),
+                           llvm::ConstantInt::get(
+                               builder.getIntNTy(func.slots[select].width), 0)),
+      index(operand(1)), index(operand(2)));
+  notReadyUnless(isValid(in));
+  copy(index(result(0)), in);
+  storeTime(result(0), maxTime(loadTime(select), loadTime(in)));
+  setValid(result(0), true);
+  produce(0, index(result(0)));
+  setValid(select, false);
+  setValid(in, false);
+  builder.CreateRet(builder.getInt32(1));
+}
+
+void FireBuilder::emitConditionalBranch() {
+  unsigned cond = operand(0), in = operand(1);
+  notReadyUnless(builder.CreateAnd(isValid(cond), isValid(in)));
+  auto *out = builder.CreateSelect(
+      builder.CreateICmpNE(loadBits(cond), builder.getInt64(0)),
+      index(result(0)), index(result(1)));
+  copy(out, index(in));
+  storeTime(out, maxTime(loadTime(cond), loadTime(in)));
+  setValid(out, true);
+  produce(0, out);
+  setValid(cond, false);
+  setValid(in, false);
+  builder.CreateRet(builder.getInt32(1));
+}
+
+/// Emit the firing of a handshake load, forwarding the address once it and
+/// the nonce hold a token, or the data from the memory otherwise.
+void FireBuilder::emitLoad() {
+  unsigned address = operand(0), data = operand(1), nonce = operand(2);
+  auto *hasAddress = isValid(address);
+  auto *hasNonce = isValid(nonce);
+  auto *forwardAddress = llvm::BasicBlock::Create(context, "address", fn);
+  auto *checkData = llvm::BasicBlock::Create(context, "check_data", fn);
+  builder.CreateCondBr(builder.CreateAnd(hasAddress, hasNonce), forwardAddress,
+                       checkData);
+
+  builder.SetInsertPoint(forwardAddress);
+  copy(result(1), address);
+  storeTime(result(1), maxTime(loadTime(address), loadTime(nonce)));
+  setValid(result(1), true);
+  produce(0, index(result(1)));
+  setValid(address, false);
+  setValid(nonce, false);
+  builder.CreateRet(builder.getInt32(1));
+
+  builder.SetInsertPoint(checkData);
+  notReadyUnless(builder.CreateAnd(
+      builder.CreateNot(builder.CreateOr(hasAddress, hasNonce)),
+      isValid(data)));
+  copy(result(0), data);
+  storeTime(result(0), loadTime(data));
+  setValid(result(0), true);
+  produce(0, index(result(0)));
+  setValid(data, false);
+  builder.CreateRet(builder.getInt32(1));
+}
+
+bool FireBuilder::emit(unsigned instIndex, llvm::StringRef name) {
+  inst = &func.instructions[instIndex];
+  switch (inst->kind) {
+  case InstKind::Compute:
+  case InstKind::General:
+  case InstKind::Merge:
+  case InstKind::ControlMerge:
+  case InstKind::Mux:
+  case InstKind::ConditionalBranch:
+  case InstKind::HandshakeLoad:
+  case InstKind::Sink:
+    break;
+  default:
+    return false;
+  }
+  for (unsigned i = 0; i < inst->numOperands; ++i)
+    if (!isNative(operand(i)))
+      return false;
+  for (unsigned i = 0; i < inst->numResults; ++i)
+    if (!isNative(result(i)))
+      return false;
+
+  auto *fnType = llvm::FunctionType::get(
+      builder.getInt32Ty(),
+      {builder.getInt64Ty()->getPointerTo(),
+       builder.getDoubleTy()->getPointerTo(),
+       builder.getInt8Ty()->getPointerTo(),
+       builder.getInt32Ty()->getPointerTo()},
+      false);
+  fn = llvm::Function::Create(fnType, llvm::GlobalValue::ExternalLinkage, name,
+                              module);
+  for (auto &arg : fn->args())
+    arg.addAttr(llvm::Attribute::NoAlias);
+  bits = fn->getArg(0);
+  times = fn->getArg(1);
+  valid = fn->getArg(2);
+  produced = fn->getArg(3);
+  builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", fn));
+
+  switch (inst->kind) {
+  case InstKind::Compute:
+  case InstKind::General:
+    emitAllOperands();
+    break;
+  case InstKind::Merge:
+  case InstKind::ControlMerge:
+    emitMerge();
+    break;
+  case InstKind::Mux:
+    emitMux();
+    break;
+  case InstKind::ConditionalBranch:
+    emitConditionalBranch();
+    break;
+  case InstKind::HandshakeLoad:
+    emitLoad();
+    break;
+  case InstKind::Sink:
+    setValid(operand(0), false);
+    builder.CreateRet(builder.getInt32(0));
+    break;
+  default:
+    llvm_unreachable("instruction without native code");
+  }
+  return true;
+}
+
+llvm::Expected<std::unique_ptr<NativeFunction>>
+sim::NativeFunction::compile(const Function &func) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  auto jit = llvm::orc::LLJITBuilder().create();
+  if (!jit)
+    return jit.takeError();
+
+  auto context = std::make_unique<llvm::LLVMContext>();
+  auto module = std::make_unique<llvm::Module>("handshake", *context);
+  module->setDataLayout((*jit)->getDataLayout());
+
+  FireBuilder builder(func, *module);
+  std::vector<std::string> names(func.instructions.size());
+  for (unsigned i = 0; i < func.instructions.size(); ++i) {
+    std::string name = "fire" + std::to_string(i);
+    if (builder.emit(i, name))
+      names[i] = std::move(name);
+  }
+  if (llvm::verifyModule(*module, &llvm::errs()))
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "invalid native code generated");
+
+  if (auto err = (*jit)->addIRModule(
+          llvm::orc::ThreadSafeModule(std::move(module), std::move(context))))
+    return std::move(err);
+
+  std::unique_ptr<NativeFunction> native(new NativeFunction());
+  native->fires.resize(func.instructions.size());
+  for (unsigned i = 0; i < names.size(); ++i) {
+    if (names[i].empty())
+      continue;
+    auto symbol = (*jit)->lookup(names[i]);
+    if (!symbol)
+      return symbol.takeError();
+    native->fires[i] = reinterpret_cast<FireFn>(symbol->getAddress());
+  }
+  native->jit = std::move(*jit);
+  return std::move(native);
+}
+
+sim::NativeFunction::~NativeFunction() = default;
+
+unsigned sim::NativeFunction::getNumCompiled() const {
+  return std::count_if(fires.begin(), fires.end(),
+                       [](FireFn fire) { return fire != nullptr; });
+}
@@ -0,0 +1,69 @@
+//===- NativeCode.h - Native code of handshake functions --------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the compilation of the instructions of a pre-compiled
+// handshake function to native code, with the LLVM JIT.
+//
+//===----------------------------------------------------------------------===//
+
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef HANDSHAKE_RUNNER_NATIVECODE_H
+#define HANDSHAKE_RUNNER_NATIVECODE_H
+
+#include "Program.h"
+#include "llvm/Support/Error.h"
+
+namespace llvm {
+namespace orc {
+class LLJIT;
+} // namespace orc
+} // namespace llvm
+
+namespace circt {
+namespace handshake {
+namespace sim {
+
+/// The native code firing the instructions of a handshake function. The slot
+/// indices, constants and latencies of each instruction are folded into its
+/// code, such that firing it does not look at the instruction at all.
+class NativeFunction {
+public:
+  /// Fire an instruction, given the inline tokens, times and validity bytes of
+  /// the slots of its frame, with the semantics of the program's firing. The
+  /// slots of the produced results are written to `produced`, and their number
+  /// returned, or -1 if the instruction is not ready.
+  using FireFn = int32_t (*)(uint64_t *bits, double *times, uint8_t *valid,
+                             uint32_t *produced);
+
+  /// Compile the instructions of a handshake function. The instructions
+  /// needing the runtime, such as memories, returns and the ones on wide
+  /// integers, are left without native code.
+  static llvm::Expected<std::unique_ptr<NativeFunction>>
+  compile(const Function &func);
+
+  ~NativeFunction();
+
+  /// Get the native code of an instruction, or null if the program has to
+  /// fire it.
+  FireFn getFire(unsigned inst) const { return fires[inst]; }
+
+  /// Get the number of instructions with native code.
+  unsigned getNumCompiled() const;
+
+private:
+  NativeFunction() = default;
+
+  std::unique_ptr<llvm::orc::LLJIT> jit;
+  std::vector<FireFn> fires;
+};
+
+} // namespace sim
+} // namespace handshake
+} // namespace circt
+
+#endif // HANDSHAKE_RUNNER_NATIVECODE_H
@@ -0,0 +1,1372 @@
+//===- Program.cpp - Pre-compiled functions of handshake-runner -----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the compilation of std and handshake functions to
+// slot-based instructions, and their execution. The execution follows the
+// semantics and the timing of the interpreter in Simulation.cpp.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Program.h"
+#include "NativeCode.h"
+
+#include "circt/Dialect/Handshake/HandshakeOps.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+#define DEBUG_TYPE "runner"
+
+using namespace llvm;
+using namespace circt;
+using namespace circt::handshake::sim;
+
+/// The width of the index values, as INDEX_WIDTH in the interpreter.
+static constexpr unsigned indexWidth = 32;
+
+/// The index of the producer of the slots which are not produced by an
+/// instruction.
+static constexpr unsigned noInstruction = ~0u;
+static constexpr unsigned noFiring = ~0u;
+
+//===----------------------------------------------------------------------===//
+// Frame
+//===----------------------------------------------------------------------===//
+
+namespace circt {
+namespace handshake {
+namespace sim {
+/// The tokens of one invocation of a function, and the time they were
+/// produced at. In handshake functions, a slot holds a token while its byte
+/// in `valid` is set.
+struct Frame {
+  explicit Frame(const Function &func)
+      : func(func), bits(func.slots.size()), times(func.slots.size()),
+        wide(func.numWide), valid(func.slots.size()) {
+    for (auto &slot : func.slots)
+      if (slot.kind == SlotKind::WideInt)
+        wide[slot.wideIndex] = APInt(slot.width, 0);
+  }
+
+  unsigned operand(const Instruction &inst, unsigned i) const {
+    return func.slotList[inst.operands + i];
+  }
+  unsigned result(const Instruction &inst, unsigned i) const {
+    return func.slotList[inst.results + i];
+  }
+
+  APInt getInt(unsigned s) const {
+    auto &slot = func.slots[s];
+    if (slot.kind == SlotKind::WideInt)
+      return wide[slot.wideIndex];
+    return APInt(slot.width, bits[s]);
+  }
+  void setInt(unsigned s, const APInt &value) {
+    auto &slot = func.slots[s];
+    assert(value.getBitWidth() == slot.width && "token of the wrong width");
+    if (slot.kind == SlotKind::WideInt)
+      wide[slot.wideIndex] = value;
+    else
+      bits[s] = value.getZExtValue();
+  }
+  double getFloat(unsigned s) const {
+    double value;
+    std::memcpy(&value, &bits[s], sizeof(value));
+    return value;
+  }
+  void setFloat(unsigned s, double value) {
+    if (func.slots[s].kind == SlotKind::Float)
+      value = static_cast<float>(value);
+    std::memcpy(&bits[s], &value, sizeof(value));
+  }
+
+  APInt intOperand(const Instruction &inst, unsigned i) const {
+    return getInt(operand(inst, i));
+  }
+  double floatOperand(const Instruction &inst, unsigned i) const {
+    return getFloat(operand(inst, i));
+  }
+
+  /// Copy the token of a slot of another frame, of the same type.
+  void copy(unsigned dst, const Frame &from, unsigned src) {
+    auto &slot = func.slots[dst];
+    if (slot.kind == SlotKind::WideInt)
+      wide[slot.wideIndex] = from.getInt(src);
+    else
+      bits[dst] = from.bits[src];
+  }
+  void copy(unsigned dst, unsigned src) { copy(dst, *this, src); }
+
+  /// Convert a token from and to the representation used by the store and
+  /// the interpreter.
+  Any toAny(unsigned s) const {
+    switch (func.slots[s].kind) {
+    case SlotKind::Int:
+    case SlotKind::WideInt:
+      return getInt(s);
+    case SlotKind::Float:
+    case SlotKind::Double:
+      return APFloat(getFloat(s));
+    case SlotKind::Buffer:
+      return static_cast<unsigned>(bits[s]);
+    case SlotKind::Control:
+      return APInt(1, 0);
+    }
+    llvm_unreachable("unknown slot kind");
+  }
+  void fromAny(unsigned s, const Any &value) {
+    auto &slot = func.slots[s];
+    switch (slot.kind) {
+    case SlotKind::Int:
+    case SlotKind::WideInt:
+      setInt(s, any_cast<APInt>(value).sextOrTrunc(slot.width));
+      return;
+    case SlotKind::Float:
+    case SlotKind::Double: {
+      APFloat apfloat = any_cast<APFloat>(value);
+      bool losesInfo;
+      apfloat.convert(APFloat::IEEEdouble(), APFloat::rmNearestTiesToEven,
+                      &losesInfo);
+      setFloat(s, apfloat.convertToDouble());
+      return;
+    }
+    case SlotKind::Buffer:
+      bits[s] = any_cast<unsigned>(value);
+      return;
+    case SlotKind::Control:
+      bits[s] = 0;
+      return;
+    }
+  }
+
+  /// Load and store a token from and to an element of a memref.
+  void load(unsigned s, const MemRefBuffer &buffer, size_t i) {
+    if (func.slots[s].kind == SlotKind::WideInt)
+      fromAny(s, buffer.get(i));
+    else
+      bits[s] = buffer.getBits(i);
+  }
+  void store(unsigned s, MemRefBuffer &buffer, size_t i) const {
+    if (func.slots[s].kind == SlotKind::WideInt)
+      buffer.set(i, toAny(s));
+    else
+      buffer.setBits(i, bits[s]);
+  }
+
+  const Function &func;
+  std::vector<uint64_t> bits;
+  std::vector<double> times;
+  std::vector<APInt> wide;
+  std::vector<uint8_t> valid;
+};
+} // namespace sim
+} // namespace handshake
+} // namespace circt
+
+//===----------------------------------------------------------------------===//
+// Compute handlers
+//===----------------------------------------------------------------------===//
+
+static void executeConstant(const Instruction &inst, Frame &frame) {
+  frame.setInt(frame.result(inst, 0), frame.func.constants[inst.aux]);
+}
+
+static void executeAddI(const Instruction &inst, Frame &frame) {
+  frame.setInt(frame.result(inst, 0),
+               frame.intOperand(inst, 0) + frame.intOperand(inst, 1));
+}
+
+static void executeSubI(const Instruction &inst, Frame &frame) {
+  frame.setInt(frame.result(inst, 0),
+               frame.intOperand(inst, 0) - frame.intOperand(inst, 1));
+}
+
+static void executeMulI(const Instruction &inst, Frame &frame) {
+  frame.setInt(frame.result(inst, 0),
+               frame.intOperand(inst, 0) * frame.intOperand(inst, 1));
+}
+
+static void executeSignedDivI(const Instruction &inst, Frame &frame) {
+  APInt rhs = frame.intOperand(inst, 1);
+  assert(rhs != 0 && "Division By Zero!");
+  frame.setInt(frame.result(inst, 0), frame.intOperand(inst, 0).sdiv(rhs));
+}
+
+static void executeUnsignedDivI(const Instruction &inst, Frame &frame) {
+  APInt rhs = frame.intOperand(inst, 1);
+  assert(rhs != 0 && "Division By Zero!");
+  frame.setInt(frame.result(inst, 0), frame.intOperand(inst, 0).udiv(rhs));
+}
+
+static void executeCmpI(const Instruction &inst, Frame &frame) {
+  auto predicate = static_cast<mlir::CmpIPredicate>(inst.aux);
+  APInt lhs = frame.intOperand(inst, 0);
+  APInt rhs = frame.intOperand(inst, 1);
+  frame.setInt(frame.result(inst, 0),
+               APInt(1, mlir::applyCmpPredicate(predicate, lhs, rhs)));
+}
+
+static void executeAddF(const Instruction &inst, Frame &frame) {
+  frame.setFloat(frame.result(inst, 0),
+                 frame.floatOperand(inst, 0) + frame.floatOperand(inst, 1));
+}
+
+static void executeSubF(const Instruction &inst, Frame &frame) {
+  frame.setFloat(frame.result(inst, 0),
+                 frame.floatOperand(inst, 0) - frame.floatOperand(inst, 1));
+}
+
+static void executeMulF(const Instruction &inst, Frame &frame) {
+  frame.setFloat(frame.result(inst, 0),
+                 frame.floatOperand(inst, 0) * frame.floatOperand(inst, 1));
+}
+
+static void executeDivF(const Instruction &inst, Frame &frame) {
+  frame.setFloat(frame.result(inst, 0),
+                 frame.floatOperand(inst, 0) / frame.floatOperand(inst, 1));
+}
+
+static void executeCmpF(const Instruction &inst, Frame &frame) {
+  auto predicate = static_cast<mlir::CmpFPredicate>(inst.aux);
+  APFloat lhs(frame.floatOperand(inst, 0));
+  APFloat rhs(frame.floatOperand(inst, 1));
+  frame.setInt(frame.result(inst, 0),
+               APInt(1, mlir::applyCmpPredicate(predicate, lhs, rhs)));
+}
+
+static void executeSignExtendI(const Instruction &inst, Frame &frame) {
+  unsigned result = frame.result(inst, 0);
+  unsigned width = frame.func.slots[result].width;
+  frame.setInt(result, frame.intOperand(inst, 0).sextOrTrunc(width));
+}
+
+static void executeZeroExtendI(const Instruction &inst, Frame &frame) {
+  unsigned result = frame.result(inst, 0);
+  unsigned width = frame.func.slots[result].width;
+  frame.setInt(result, frame.intOperand(inst, 0).zextOrTrunc(width));
+}
+
+/// Forward each operand to the result of the same index.
+static void executeForward(const Instruction &inst, Frame &frame) {
+  for (unsigned i = 0; i < inst.numResults; ++i)
+    frame.copy(frame.result(inst, i), frame.operand(inst, i));
+}
+
+/// Forward the first operand to all the results.
+static void executeFork(const Instruction &inst, Frame &frame) {
+  for (unsigned i = 0; i < inst.numResults; ++i)
+    frame.copy(frame.result(inst, i), frame.operand(inst, 0));
+}
+
+/// The compute handlers, indexed by ComputeOp.
+static const ComputeFn computeFns[] = {
+    executeConstant,     executeAddI,        executeSubI,
+    executeMulI,         executeSignedDivI,  executeUnsignedDivI,
+    executeCmpI,         executeAddF,        executeSubF,
+    executeMulF,         executeDivF,        executeCmpF,
+    executeSignExtendI,  executeZeroExtendI, executeForward,
+    executeFork,         nullptr};
+
+static void setCompute(Instruction &inst, ComputeOp op) {
+  inst.computeOp = op;
+  inst.compute = computeFns[static_cast<unsigned>(op)];
+}
+
+//===----------------------------------------------------------------------===//
+// Compiler
+//===----------------------------------------------------------------------===//
+
+/// Get the slot holding the values of the given type, if supported.
+static Optional<Slot> getSlot(mlir::Type type) {
+  Slot slot;
+  if (type.isIndex()) {
+    slot.kind = SlotKind::Int;
+    slot.width = indexWidth;
+  } else if (auto intType = type.dyn_cast<mlir::IntegerType>()) {
+    slot.width = intType.getWidth();
+    slot.kind = slot.width > 64 ? SlotKind::WideInt : SlotKind::Int;
+  } else if (type.isF32()) {
+    slot.kind = SlotKind::Float;
+  } else if (type.isF64()) {
+    slot.kind = SlotKind::Double;
+  } else if (type.isa<mlir::MemRefType>()) {
+    slot.kind = SlotKind::Buffer;
+  } else if (type.isa<mlir::NoneType>()) {
+    slot.kind = SlotKind::Control;
+  } else {
+    return llvm::None;
+  }
+  return slot;
+}
+
+/// Get the computation of a standard operation computing its results from its
+/// operands, with the instruction data it needs.
+static Optional<ComputeOp> getComputeOp(mlir::Operation &op, Function &func,
+                                        unsigned &aux) {
+  auto addConstant = [&](APInt value) {
+    aux = func.constants.size();
+    func.constants.push_back(std::move(value));
+    return ComputeOp::Constant;
+  };
+  if (auto constOp = dyn_cast<mlir::ConstantIndexOp>(op))
+    return addConstant(constOp->getAttrOfType<mlir::IntegerAttr>("value")
+                           .getValue()
+                           .sextOrTrunc(indexWidth));
+  if (auto constOp = dyn_cast<mlir::ConstantIntOp>(op))
+    return addConstant(
+        constOp->getAttrOfType<mlir::IntegerAttr>("value").getValue());
+  if (isa<mlir::AddIOp>(op))
+    return ComputeOp::AddI;
+  if (isa<mlir::AddFOp>(op))
+    return ComputeOp::AddF;
+  if (isa<mlir::SubIOp>(op))
+    return ComputeOp::SubI;
+  if (isa<mlir::SubFOp>(op))
+    return ComputeOp::SubF;
+  if (auto cmpOp = dyn_cast<mlir::CmpIOp>(op)) {
+    aux = static_cast<unsigned>(cmpOp.getPredicate());
+    return ComputeOp::CmpI;
+  }
+  if (auto cmpOp = dyn_cast<mlir::CmpFOp>(op)) {
+    aux = static_cast<unsigned>(cmpOp.getPredicate());
+    return ComputeOp::CmpF;
+  }
+  if (isa<mlir::MulIOp>(op))
+    return ComputeOp::MulI;
+  if (isa<mlir::MulFOp>(op))
+    return ComputeOp::MulF;
+  if (isa<mlir::UnsignedDivIOp>(op))
+    return ComputeOp::UnsignedDivI;
+  if (isa<mlir::SignedDivIOp>(op))
+    return ComputeOp::SignedDivI;
+  if (isa<mlir::DivFOp>(op))
+    return ComputeOp::DivF;
+  if (isa<mlir::IndexCastOp>(op) || isa<mlir::SignExtendIOp>(op))
+    return ComputeOp::SignExtendI;
+  if (isa<mlir::ZeroExtendIOp>(op))
+    return ComputeOp::ZeroExtendI;
+  return llvm::None;
+}
+
+namespace circt {
+namespace handshake {
+namespace sim {
+/// Compile a function and the functions it calls into a program.
+class Compiler {
+public:
+  explicit Compiler(Program &program) : program(program) {}
+
+  /// Get the index of the given function in the program, compiling it first
+  /// if needed.
+  Optional<unsigned> getFunction(mlir::Operation *op);
+
+private:
+  LogicalResult compileFunction(mlir::Operation *op, Function &func);
+  LogicalResult compileStdOp(mlir::Operation &op, Instruction &inst,
+                             Function &func);
+  LogicalResult compileHandshakeOp(mlir::Operation &op, Instruction &inst,
+                                   Function &func);
+  void indexUsers(mlir::Operation *op, Function &func);
+
+  Program &program;
+  DenseMap<mlir::Operation *, unsigned> functionIndex;
+  DenseMap<mlir::Value, unsigned> slotIndex;
+  DenseMap<mlir::Operation *, unsigned> instIndex;
+};
+} // namespace sim
+} // namespace handshake
+} // namespace circt
+
+Optional<unsigned> Compiler::getFunction(mlir::Operation *op) {
+  auto it = functionIndex.find(op);
+  if (it != functionIndex.end())
+    return it->second;
+
+  // Register the function before compiling it, such that recursive calls
+  // refer to it.
+  unsigned index = program.functions.size();
+  functionIndex[op] = index;
+  program.functions.push_back(std::make_unique<Function>());
+  auto &func = *program.functions.back();
+
+  // The slot and instruction indices are specific to each function.
+  auto savedSlots = std::move(slotIndex);
+  auto savedInsts = std::move(instIndex);
+  slotIndex.clear();
+  instIndex.clear();
+  auto result = compileFunction(op, func);
+  slotIndex = std::move(savedSlots);
+  instIndex = std::move(savedInsts);
+  if (failed(result))
+    return llvm::None;
+  return index;
+}
+
+LogicalResult Compiler::compileFunction(mlir::Operation *op, Function &func) {
+  func.op = op;
+  func.isHandshake = isa<handshake::FuncOp>(op);
+  auto &body = op->getRegion(0);
+  if (body.empty())
+    return failure();
+
+  // Assign a slot to every value, starting with the function arguments.
+  auto addSlot = [&](mlir::Value value) {
+    auto slot = getSlot(value.getType());
+    if (!slot)
+      return failure();
+    if (slot->kind == SlotKind::WideInt)
+      slot->wideIndex = func.numWide++;
+    slotIndex[value] = func.slots.size();
+    func.slots.push_back(*slot);
+    return success();
+  };
+  for (auto &block : body) {
+    for (auto arg : block.getArguments())
+      if (failed(addSlot(arg)))
+        return failure();
+    for (auto &inner : block)
+      for (auto result : inner.getResults())
+        if (failed(addSlot(result)))
+          return failure();
+  }
+
+  // Lay the operations out in block order.
+  DenseMap<mlir::Block *, unsigned> blockStart;
+  for (auto &block : body) {
+    blockStart[&block] = func.instructions.size();
+    for (auto &inner : block) {
+      instIndex[&inner] = func.instructions.size();
+      func.instructions.emplace_back();
+      auto &inst = func.instructions.back();
+      inst.op = &inner;
+      inst.operands = func.slotList.size();
+      inst.numOperands = inner.getNumOperands();
+      for (auto operand : inner.getOperands())
+        func.slotList.push_back(slotIndex.lookup(operand));
+      inst.results = func.slotList.size();
+      inst.numResults = inner.getNumResults();
+      for (auto result : inner.getResults())
+        func.slotList.push_back(slotIndex.lookup(result));
+    }
+  }
+
+  for (auto &inst : func.instructions) {
+    auto &inner = *inst.op;
+    if (failed(func.isHandshake ? compileHandshakeOp(inner, inst, func)
+                                : compileStdOp(inner, inst, func))) {
+      LLVM_DEBUG(dbgs() << "Interpreting " << *op << " for " << inner << "\n");
+      return failure();
+    }
+    // Branches write the arguments of their destinations.
+    if (inst.kind == InstKind::Branch || inst.kind == InstKind::CondBranch) {
+      inst.results = func.slotList.size();
+      inst.numResults = 0;
+      for (unsigned i = 0; i < inner.getNumSuccessors(); ++i) {
+        auto *dest = inner.getSuccessor(i);
+        inst.targets[i] = blockStart.lookup(dest);
+        for (auto arg : dest->getArguments())
+          func.slotList.push_back(slotIndex.lookup(arg));
+        inst.numResults += dest->getNumArguments();
+      }
+    }
+  }
+
+  if (func.isHandshake)
+    indexUsers(op, func);
+  return success();
+}
+
+LogicalResult Compiler::compileStdOp(mlir::Operation &op, Instruction &inst,
+                                     Function &func) {
+  if (auto computeOp = getComputeOp(op, func, inst.aux)) {
+    inst.kind = InstKind::Compute;
+    setCompute(inst, *computeOp);
+  } else if (isa<mlir::AllocOp>(op)) {
+    inst.kind = InstKind::Alloc;
+  } else if (auto loadOp = dyn_cast<mlir::LoadOp>(op)) {
+    inst.kind = InstKind::Load;
+    inst.aux = func.shapes.size();
+    auto shape = loadOp.getMemRefType().getShape();
+    func.shapes.emplace_back(shape.begin(), shape.end());
+  } else if (auto storeOp = dyn_cast<mlir::StoreOp>(op)) {
+    inst.kind = InstKind::Store;
+    inst.aux = func.shapes.size();
+    auto shape = storeOp.getMemRefType().getShape();
+    func.shapes.emplace_back(shape.begin(), shape.end());
+  } else if (isa<mlir::BranchOp>(op)) {
+    inst.kind = InstKind::Branch;
+  } else if (auto condBranchOp = dyn_cast<mlir::CondBranchOp>(op)) {
+    inst.kind = InstKind::CondBranch;
+    inst.aux = condBranchOp.getNumTrueOperands();
+  } else if (isa<mlir::ReturnOp>(op)) {
+    inst.kind = InstKind::Return;
+  } else if (auto callOp = dyn_cast<mlir::CallOpInterface>(op)) {
+    auto funcOp = dyn_cast_or_null<mlir::FuncOp>(callOp.resolveCallable());
+    if (!funcOp)
+      return failure();
+    auto callee = getFunction(funcOp);
+    if (!callee)
+      return failure();
+    inst.kind = InstKind::Call;
+    inst.aux = *callee;
+  } else {
+    return failure();
+  }
+  return success();
+}
+
+LogicalResult Compiler::compileHandshakeOp(mlir::Operation &op,
+                                           Instruction &inst, Function &func) {
+  auto general = [&](ComputeOp computeOp, unsigned latency) {
+    inst.kind = InstKind::General;
+    setCompute(inst, computeOp);
+    inst.latency = latency;
+    return success();
+  };
+
+  if (auto computeOp = getComputeOp(op, func, inst.aux)) {
+    inst.kind = InstKind::Compute;
+    setCompute(inst, *computeOp);
+    inst.latency = 1;
+  } else if (isa<handshake::ReturnOp>(op)) {
+    inst.kind = InstKind::Return;
+  } else if (isa<handshake::ForkOp>(op)) {
+    return general(ComputeOp::Fork, 1);
+  } else if (isa<handshake::BranchOp>(op)) {
+    return general(ComputeOp::Forward, 0);
+  } else if (auto constOp = dyn_cast<handshake::ConstantOp>(op)) {
+    auto attr = constOp->getAttrOfType<mlir::IntegerAttr>("value");
+    if (!attr)
+      return failure();
+    unsigned width = func.slots[func.slotList[inst.results]].width;
+    inst.aux = func.constants.size();
+    func.constants.push_back(attr.getValue().sextOrTrunc(width));
+    return general(ComputeOp::Constant, 0);
+  } else if (isa<handshake::StoreOp>(op)) {
+    return general(ComputeOp::Forward, 1);
+  } else if (isa<handshake::JoinOp>(op)) {
+    return general(ComputeOp::None, 1);
+  } else if (isa<handshake::MergeOp>(op)) {
+    inst.kind = InstKind::Merge;
+  } else if (isa<handshake::MuxOp>(op)) {
+    inst.kind = InstKind::Mux;
+  } else if (isa<handshake::ControlMergeOp>(op)) {
+    inst.kind = InstKind::ControlMerge;
+  } else if (isa<handshake::ConditionalBranchOp>(op)) {
+    inst.kind = InstKind::ConditionalBranch;
+  } else if (isa<handshake::LoadOp>(op)) {
+    if (inst.numOperands != 3)
+      return failure();
+    inst.kind = InstKind::HandshakeLoad;
+  } else if (auto memOp = dyn_cast<handshake::MemoryOp>(op)) {
+    inst.kind = InstKind::Memory;
+    inst.aux = func.memories.size();
+    inst.numLoads = memOp.getLdCount().getZExtValue();
+    inst.numStores = memOp.getStCount().getZExtValue();
+    func.memories.push_back(&inst - func.instructions.data());
+  } else if (auto bufferOp = dyn_cast<handshake::BufferOp>(op)) {
+    // The tokens queued in the buffer are held by slots of their own, of the
+    // type of its operand.
+    inst.kind = InstKind::Buffer;
+    inst.aux = func.slots.size();
+    inst.numSlots = bufferOp.getNumSlots().getZExtValue();
+    inst.latency = bufferOp.isSequential() ? 1 : 0;
+    Slot slot = func.slots[func.slotList[inst.operands]];
+    for (unsigned i = 0; i < inst.numSlots; ++i) {
+      if (slot.kind == SlotKind::WideInt)
+        slot.wideIndex = func.numWide++;
+      func.slots.push_back(slot);
+    }
+  } else if (isa<handshake::SinkOp>(op)) {
+    inst.kind = InstKind::Sink;
+  } else if (isa<handshake::StartOp>(op) || isa<handshake::EndOp>(op) ||
+             isa<handshake::TerminatorOp>(op)) {
+    inst.kind = InstKind::Nop;
+  } else {
+    return failure();
+  }
+  return success();
+}
+
+/// Index the users and the producer of each slot of a handshake function, used
+/// to find the instructions which might become ready to execute.
+void Compiler::indexUsers(mlir::Operation *op, Function &func) {
+  auto &body = op->getRegion(0);
+  func.producers.assign(func.slots.size(), noInstruction);
+  func.userBegin.reserve(func.slots.size() + 1);
+  auto addUsers = [&](mlir::Value value) {
+    func.userBegin.push_back(func.users.size());
+    for (auto &use : value.getUses())
+      func.users.push_back(instIndex.lookup(use.getOwner()));
+  };
+  for (auto &block : body) {
+    for (auto arg : block.getArguments())
+      addUsers(arg);
+    for (auto &inner : block) {
+      for (auto result : inner.getResults()) {
+        func.producers[func.userBegin.size()] = instIndex.lookup(&inner);
+        addUsers(result);
+      }
+    }
+  }
+  func.userBegin.push_back(func.users.size());
+}
+
+std::unique_ptr<Program> Program::compile(mlir::Operation *toplevel) {
+  std::unique_ptr<Program> program(new Program());
+  Compiler compiler(*program);
+  if (!compiler.getFunction(toplevel))
+    return nullptr;
+  return program;
+}
+
+Program::~Program() = default;
+
+llvm::Error Program::compileNative() {
+  auto &toplevel = *functions.front();
+  if (!toplevel.isHandshake)
+    return Error::success();
+  auto nativeOrErr = NativeFunction::compile(toplevel);
+  if (!nativeOrErr)
+    return nativeOrErr.takeError();
+  native = std::move(*nativeOrErr);
+  LLVM_DEBUG(dbgs() << "Compiled " << native->getNumCompiled() << " of "
+                    << toplevel.instructions.size()
+                    << " instructions to native code\n");
+  return Error::success();
+}
+
+//===----------------------------------------------------------------------===//
+// Execution
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// The instructions of a handshake function which might be ready to execute,
+/// in FIFO order, queued as done by the interpreter. The instructions waiting
+/// for all their operands are only queued once they all hold a token. The
+/// other ones are queued whenever a token arrives on one of their operands,
+/// and general operations and buffers also whenever a token leaves one of
+/// their results.
+class ReadyQueue {
+public:
+  explicit ReadyQueue(const Function &func)
+      : func(func), missing(func.instructions.size()),
+        queued(func.instructions.size()) {
+    for (unsigned i = 0; i < missing.size(); ++i)
+      if (waitsForAll(i))
+        missing[i] = func.instructions[i].numOperands;
+  }
+
+  bool empty() const { return fifo.empty(); }
+
+  unsigned pop() {
+    unsigned i = fifo.front();
+    fifo.pop_front();
+    queued.reset(i);
+    return i;
+  }
+
+  void tokenArrived(unsigned slot) {
+    for (unsigned k = func.userBegin[slot]; k < func.userBegin[slot + 1];
+         ++k) {
+      unsigned i = func.users[k];
+      if (!waitsForAll(i))
+        schedule(i);
+      else if (missing[i] > 0 && --missing[i] == 0)
+        schedule(i);
+    }
+  }
+
+  void tokenConsumed(unsigned slot) {
+    unsigned i = func.producers[slot];
+    if (i == noInstruction)
+      return;
+    auto kind = func.instructions[i].kind;
+    if (kind == InstKind::General || kind == InstKind::Buffer)
+      schedule(i);
+  }
+
+  void setMissing(unsigned i, unsigned count) { missing[i] = count; }
+
+private:
+  bool waitsForAll(unsigned i) const {
+    auto kind = func.instructions[i].kind;
+    return kind == InstKind::Compute || kind == InstKind::Return;
+  }
+
+  void schedule(unsigned i) {
+    if (queued.test(i))
+      return;
+    queued.set(i);
+    fifo.push_back(i);
+  }
+
+  const Function &func;
+  std::vector<unsigned> missing;
+  BitVector queued;
+  std::deque<unsigned> fifo;
+};
+
+/// The execution of a program, with the memory shared by its functions.
+class Runner {
+public:
+  Runner(const Program &program, std::vector<handshake::MemRefBuffer> &store,
+         std::vector<double> &storeTimes)
+      : program(program), store(store), storeTimes(storeTimes) {}
+
+  /// Execute a std function up to its return, and return the return
+  /// instruction, whose operands hold the results.
+  const Instruction &runStd(Frame &frame);
+
+  /// Execute a handshake function up to its return, and store its results.
+  LogicalResult runHandshake(Frame &frame, std::vector<Any> &results,
+                             std::vector<double> &resultTimes);
+
+  uint64_t instructionsExecuted = 0;
+  /// The statistics of the handshake function, collected if set.
+  Statistics *stats = nullptr;
+
+private:
+  unsigned allocate(const Instruction &inst, Frame &frame);
+  unsigned getAddress(const Instruction &inst, Frame &frame,
+                      unsigned firstIndex);
+  void executeMemory(const Instruction &inst, Frame &frame, unsigned buffer,
+                     SmallVectorImpl<unsigned> &produced);
+  bool fire(const Instruction &inst, Frame &frame, ArrayRef<unsigned> buffers,
+            SmallVectorImpl<unsigned> &produced);
+  void moveToken(Frame &frame, unsigned dst, unsigned src);
+  void record(unsigned index, Frame &frame, ArrayRef<unsigned> held,
+              ArrayRef<unsigned> produced);
+  void recordCriticalPath(const Instruction &ret, unsigned numResults,
+                          Frame &frame);
+
+  /// A firing of an instruction, producing tokens at the given time, and the
+  /// firing which produced the latest token it consumed.
+  struct Firing {
+    unsigned inst;
+    double time;
+    unsigned from;
+  };
+  /// The firings, and the one which produced the token held by each slot,
+  /// recorded along with the statistics.
+  std::vector<Firing> firings;
+  std::vector<unsigned> tokenFirings;
+
+  const Program &program;
+  std::vector<handshake::MemRefBuffer> &store;
+  std::vector<double> &storeTimes;
+};
+} // namespace
+
+/// Allocate the buffer of a std alloc, as allocateMemRef in the interpreter.
+unsigned Runner::allocate(const Instruction &inst, Frame &frame) {
+  auto type = cast<mlir::AllocOp>(inst.op).getType();
+  int64_t allocationSize = 1;
+  unsigned count = 0;
+  for (int64_t dim : type.getShape()) {
+    if (dim > 0)
+      allocationSize *= dim;
+    else
+      allocationSize *= frame.intOperand(inst, count++).getSExtValue();
+  }
+  unsigned ptr = store.size();
+  store.emplace_back(type.getElementType(), allocationSize);
+  storeTimes.push_back(0.0);
+  return ptr;
+}
+
+/// Linearize the indices of a std load or store, starting at the given
+/// operand.
+unsigned Runner::getAddress(const Instruction &inst, Frame &frame,
+                            unsigned firstIndex) {
+  auto &shape = frame.func.shapes[inst.aux];
+  unsigned address = 0;
+  for (unsigned i = 0; i < shape.size(); ++i)
+    address = address * shape[i] +
+              frame.intOperand(inst, firstIndex + i).getZExtValue();
+  return address;
+}
+
+const Instruction &Runner::runStd(Frame &frame) {
+  auto &func = frame.func;
+  unsigned pc = 0;
+  while (true) {
+    auto &inst = func.instructions[pc];
+    LLVM_DEBUG(dbgs() << "OP:  " << inst.op->getName() << "\n");
+    double time = 0.0;
+    for (unsigned i = 0; i < inst.numOperands; ++i)
+      time = std::max(time, frame.times[frame.operand(inst, i)]);
+
+    switch (inst.kind) {
+    case InstKind::Compute:
+      inst.compute(inst, frame);
+      break;
+    case InstKind::Alloc: {
+      unsigned ptr = allocate(inst, frame);
+      frame.bits[frame.result(inst, 0)] = ptr;
+      storeTimes[ptr] = time;
+      break;
+    }
+    case InstKind::Load: {
+      unsigned ptr = frame.bits[frame.operand(inst, 0)];
+      unsigned address = getAddress(inst, frame, 1);
+      assert(ptr < store.size() && address < store[ptr].size());
+      frame.load(frame.result(inst, 0), store[ptr], address);
+      time = std::max(time, storeTimes[ptr]);
+      storeTimes[ptr] = time;
+      break;
+    }
+    case InstKind::Store: {
+      unsigned ptr = frame.bits[frame.operand(inst, 1)];
+      unsigned address = getAddress(inst, frame, 2);
+      assert(ptr < store.size() && address < store[ptr].size());
+      frame.store(frame.operand(inst, 0), store[ptr], address);
+      time = std::max(time, storeTimes[ptr]);
+      storeTimes[ptr] = time;
+      break;
+    }
+    case InstKind::Branch:
+      for (unsigned i = 0; i < inst.numResults; ++i) {
+        unsigned arg = frame.result(inst, i);
+        frame.copy(arg, frame.operand(inst, i));
+        frame.times[arg] = time;
+      }
+      pc = inst.targets[0];
+      continue;
+    case InstKind::CondBranch: {
+      // The operands of the taken destination follow the condition, and its
+      // arguments come first among the results for the true destination.
+      bool taken = frame.intOperand(inst, 0) != 0;
+      unsigned numTrue = inst.aux;
+      unsigned firstOperand = taken ? 1 : 1 + numTrue;
+      unsigned firstArg = taken ? 0 : numTrue;
+      unsigned numArgs = taken ? numTrue : inst.numOperands - 1 - numTrue;
+      double argTime = 0.0;
+      for (unsigned i = 0; i < numArgs; ++i)
+        argTime = std::max(
+            argTime, frame.times[frame.operand(inst, firstOperand + i)]);
+      for (unsigned i = 0; i < numArgs; ++i) {
+        unsigned arg = frame.result(inst, firstArg + i);
+        frame.copy(arg, frame.operand(inst, firstOperand + i));
+        frame.times[arg] = argTime;
+      }
+      pc = inst.targets[taken ? 0 : 1];
+      continue;
+    }
+    case InstKind::Return:
+      return inst;
+    case InstKind::Call: {
+      Frame calleeFrame(program.getFunction(inst.aux));
+      for (unsigned i = 0; i < inst.numOperands; ++i) {
+        calleeFrame.copy(i, frame, frame.operand(inst, i));
+        calleeFrame.times[i] = frame.times[frame.operand(inst, i)];
+      }
+      auto &ret = runStd(calleeFrame);
+      for (unsigned i = 0; i < inst.numResults; ++i) {
+        unsigned result = frame.result(inst, i);
+        frame.copy(result, calleeFrame, calleeFrame.operand(ret, i));
+        frame.times[result] = calleeFrame.times[calleeFrame.operand(ret, i)];
+      }
+      ++pc;
+      continue;
+    }
+    default:
+      llvm_unreachable("not a standard operation");
+    }
+
+    for (unsigned i = 0; i < inst.numResults; ++i)
+      frame.times[frame.result(inst, i)] = time + 1;
+    ++pc;
+    ++instructionsExecuted;
+  }
+}
+
+/// Execute the ready ports of a handshake memory, as MemoryOp::tryExecute,
+/// and collect the results they produce.
+void Runner::executeMemory(const Instruction &inst, Frame &frame,
+                           unsigned buffer,
+                           SmallVectorImpl<unsigned> &produced) {
+  assert(buffer < store.size());
+  auto &ref = store[buffer];
+  unsigned opIndex = 0;
+  for (unsigned i = 0; i < inst.numStores; ++i) {
+    unsigned data = frame.operand(inst, opIndex++);
+    unsigned address = frame.operand(inst, opIndex++);
+    if (!frame.valid[data] || !frame.valid[address])
+      continue;
+    unsigned offset = frame.getInt(address).getZExtValue();
+    assert(offset < ref.size());
+    frame.store(data, ref, offset);
+    unsigned nonceOut = frame.result(inst, inst.numLoads + i);
+    frame.times[nonceOut] = std::max(frame.times[address], frame.times[data]);
+    frame.valid[nonceOut] = 1;
+    produced.push_back(nonceOut);
+    frame.valid[data] = 0;
+    frame.valid[address] = 0;
+  }
+  for (unsigned i = 0; i < inst.numLoads; ++i) {
+    unsigned address = frame.operand(inst, opIndex++);
+    if (!frame.valid[address])
+      continue;
+    unsigned offset = frame.getInt(address).getZExtValue();
+    assert(offset < ref.size());
+    unsigned dataOut = frame.result(inst, i);
+    unsigned nonceOut =
+        frame.result(inst, inst.numLoads + inst.numStores + i);
+    frame.load(dataOut, ref, offset);
+    frame.times[dataOut] = frame.times[nonceOut] = frame.times[address];
+    frame.valid[dataOut] = 1;
+    frame.valid[nonceOut] = 1;
+    produced.push_back(dataOut);
+    produced.push_back(nonceOut);
+    frame.valid[address] = 0;
+  }
+}
+
+/// Move a token between slots of the same type, along with its time.
+void Runner::moveToken(Frame &frame, unsigned dst, unsigned src) {
+  frame.copy(dst, src);
+  frame.times[dst] = frame.times[src];
+  frame.valid[dst] = 1;
+  frame.valid[src] = 0;
+  if (stats)
+    tokenFirings[dst] = tokenFirings[src];
+}
+
+/// Record the statistics of a firing, given the operands holding a token
+/// before it and the results it produced.
+void Runner::record(unsigned index, Frame &frame, ArrayRef<unsigned> held,
+                    ArrayRef<unsigned> produced) {
+  auto &inst = frame.func.instructions[index];
+  auto &op = stats->ops[index];
+  ++op.fires;
+
+  // Only the latest of the consumed operands stalled the instruction, by the
+  // time it arrived after the other ones.
+  unsigned latest = noInstruction;
+  double latestTime = 0.0, previousTime = 0.0;
+  unsigned numConsumed = 0;
+  for (unsigned i = 0; i < inst.numOperands; ++i) {
+    unsigned slot = frame.operand(inst, i);
+    if (frame.valid[slot] || !llvm::is_contained(held, slot))
+      continue;
+    double time = frame.times[slot];
+    if (numConsumed++ == 0 || time > latestTime) {
+      previousTime = numConsumed == 1 ? time : latestTime;
+      latestTime = time;
+      latest = i;
+    } else {
+      previousTime = std::max(previousTime, time);
+    }
+  }
+  if (numConsumed > 1)
+    op.stalls[latest] += static_cast<uint64_t>(latestTime - previousTime);
+
+  if (inst.kind == InstKind::Buffer) {
+    unsigned count = 0;
+    while (count < inst.numSlots && frame.valid[inst.aux + count])
+      ++count;
+    ++op.occupancy[count];
+  } else if (inst.kind == InstKind::Memory) {
+    // The data of the load ports and the nonces of the store ports come
+    // first among the results.
+    for (unsigned i = 0; i < op.portAccesses.size(); ++i)
+      if (llvm::is_contained(produced, frame.result(inst, i)))
+        ++op.portAccesses[i];
+  }
+
+  // The tokens produced by a buffer are the ones it consumed before, while
+  // the other instructions produce theirs from the latest consumed one.
+  unsigned from = latest == noInstruction
+                      ? noFiring
+                      : tokenFirings[frame.operand(inst, latest)];
+  for (unsigned slot : produced) {
+    if (inst.kind == InstKind::Buffer)
+      from = tokenFirings[slot];
+    tokenFirings[slot] = firings.size();
+    firings.push_back({index, frame.times[slot], from});
+  }
+}
+
+/// Record the chain of firings producing the latest of the first `numResults`
+/// results.
+void Runner::recordCriticalPath(const Instruction &ret, unsigned numResults,
+                                Frame &frame) {
+  unsigned latest = noFiring;
+  for (unsigned i = 0; i < numResults; ++i) {
+    unsigned slot = frame.operand(ret, i);
+    if (i == 0 || frame.times[slot] > stats->time) {
+      stats->time = frame.times[slot];
+      latest = tokenFirings[slot];
+    }
+  }
+  stats->criticalPath.clear();
+  for (unsigned i = latest; i != noFiring; i = firings[i].from)
+    stats->criticalPath.emplace_back(firings[i].inst, firings[i].time);
+  std::reverse(stats->criticalPath.begin(), stats->criticalPath.end());
+}
+
+/// Fire a ready handshake instruction, consuming the operand tokens and
+/// collecting the result slots it produces. Returns false if the instruction is
+/// not ready, without any effect.
+bool Runner::fire(const Instruction &inst, Frame &frame,
+                  ArrayRef<unsigned> buffers,
+                  SmallVectorImpl<unsigned> &produced) {
+  auto &func = frame.func;
+  switch (inst.kind) {
+  case InstKind::Compute:
+  case InstKind::General: {
+    // Compute instructions are only fired once all their operands hold a
+    // token, and do not wait for their results to be free.
+    bool ready = true;
+    for (unsigned i = 0; i < inst.numOperands; ++i)
+      ready &= frame.valid[frame.operand(inst, i)];
+    if (inst.kind == InstKind::General)
+      for (unsigned i = 0; i < inst.numResults; ++i)
+        ready &= !frame.valid[frame.result(inst, i)];
+    if (!ready)
+      return false;
+    double time = 0.0;
+    for (unsigned i = 0; i < inst.numOperands; ++i) {
+      unsigned slot = frame.operand(inst, i);
+      time = std::max(time, frame.times[slot]);
+      frame.valid[slot] = 0;
+    }
+    time += inst.latency;
+    if (inst.compute)
+      inst.compute(inst, frame);
+    for (unsigned i = 0; i < inst.numResults; ++i) {
+      unsigned result = frame.result(inst, i);
+      frame.times[result] = time;
+      frame.valid[result] = 1;
+      produced.push_back(result);
+    }
+    return true;
+  }
+  case InstKind::Merge:
+  case InstKind::ControlMerge: {
+    bool found = false;
+    for (unsigned i = 0; i < inst.numOperands; ++i) {
+      unsigned in = frame.operand(inst, i);
+      if (!frame.valid[in])
+        continue;
+      if (found)
+        inst.op->emitError(inst.kind == InstKind::Merge
+                               ? "More than one valid input to Merge!"
+                               : "More than one valid input to CMerge!");
+      unsigned out = frame.result(inst, 0);
+      frame.copy(out, in);
+      frame.times[out] = frame.times[in];
+      if (inst.kind == InstKind::ControlMerge) {
+        unsigned indexOut = frame.result(inst, 1);
+        frame.setInt(indexOut, APInt(func.slots[indexOut].width, i));
+        frame.times[indexOut] = frame.times[in];
+      }
+      frame.valid[in] = 0;
+      found = true;
+    }
+    if (!found) {
+      inst.op->emitError(inst.kind == InstKind::Merge
+                             ? "No valid input to Merge!"
+                             : "No valid input to CMerge!");
+      return false;
+    }
+    for (unsigned i = 0; i < inst.numResults; ++i) {
+      frame.valid[frame.result(inst, i)] = 1;
+      produced.push_back(frame.result(inst, i));
+    }
+    return true;
+  }
+  case InstKind::Mux: {
+    unsigned select = frame.operand(inst, 0);
+    if (!frame.valid[select])
+      return false;
+    unsigned in = frame.operand(inst, frame.getInt(select) == 0 ? 1 : 2);
+    if (!frame.valid[in])
+      return false;
+    unsigned out = frame.result(inst, 0);
+    frame.copy(out, in);
+    frame.times[out] = std::max(frame.times[select], frame.times[in]);
+    frame.valid[out] = 1;
+    produced.push_back(out);
+    frame.valid[select] = 0;
+    frame.valid[in] = 0;
+    return true;
+  }
+  case InstKind::ConditionalBranch: {
+    unsigned cond = frame.operand(inst, 0);
+    unsigned in = frame.operand(inst, 1);
+    if (!frame.valid[cond] || !frame.valid[in])
+      return false;
+    unsigned out = frame.result(inst, frame.getInt(cond) != 0 ? 0 : 1);
+    frame.copy(out, in);
+    frame.times[out] = std::max(frame.times[cond], frame.times[in]);
+    frame.valid[out] = 1;
+    produced.push_back(out);
+    frame.valid[cond] = 0;
+    frame.valid[in] = 0;
+    return true;
+  }
+  case InstKind::HandshakeLoad: {
+    unsigned address = frame.operand(inst, 0);
+    unsigned data = frame.operand(inst, 1);
+    unsigned nonce = frame.operand(inst, 2);
+    bool hasAddress = frame.valid[address];
+    bool hasNonce = frame.valid[nonce];
+    if (hasAddress && hasNonce) {
+      unsigned addressOut = frame.result(inst, 1);
+      frame.copy(addressOut, address);
+      frame.times[addressOut] =
+          std::max(frame.times[address], frame.times[nonce]);
+      frame.valid[addressOut] = 1;
+      produced.push_back(addressOut);
+      frame.valid[address] = 0;
+      frame.valid[nonce] = 0;
+      return true;
+    }
+    if (!hasAddress && !hasNonce && frame.valid[data]) {
+      unsigned dataOut = frame.result(inst, 0);
+      frame.copy(dataOut, data);
+      frame.times[dataOut] = frame.times[data];
+      frame.valid[dataOut] = 1;
+      produced.push_back(dataOut);
+      frame.valid[data] = 0;
+      return true;
+    }
+    return false;
+  }
+  case InstKind::Memory:
+    executeMemory(inst, frame, buffers[inst.aux], produced);
+    return true;
+  case InstKind::Buffer: {
+    // The queued tokens are kept at the front of the slots of the buffer, the
+    // oldest first.
+    unsigned in = frame.operand(inst, 0);
+    unsigned out = frame.result(inst, 0);
+    unsigned count = 0;
+    while (count < inst.numSlots && frame.valid[inst.aux + count])
+      ++count;
+    bool fired = false;
+    auto dequeue = [&] {
+      if (count == 0 || frame.valid[out])
+        return;
+      moveToken(frame, out, inst.aux);
+      frame.times[out] += inst.latency;
+      produced.push_back(out);
+      for (unsigned i = 1; i < count; ++i)
+        moveToken(frame, inst.aux + i - 1, inst.aux + i);
+      --count;
+      fired = true;
+    };
+    dequeue();
+    if (frame.valid[in] && count < inst.numSlots) {
+      moveToken(frame, inst.aux + count++, in);
+      fired = true;
+    }
+    dequeue();
+    return fired;
+  }
+  case InstKind::Sink:
+    frame.valid[frame.operand(inst, 0)] = 0;
+    return true;
+  case InstKind::Nop:
+    return false;
+  default:
+    llvm_unreachable("not a handshake operation");
+  }
+}
+
+LogicalResult Runner::runHandshake(Frame &frame, std::vector<Any> &results,
+                                   std::vector<double> &resultTimes) {
+  auto &func = frame.func;
+  ReadyQueue readyQueue(func);
+  const NativeFunction *native = program.getNative();
+
+  // Pre-allocate memory.
+  DenseMap<unsigned, unsigned> memoryMap;
+  SmallVector<unsigned, 4> buffers;
+  for (unsigned i : func.memories) {
+    auto memOp = cast<handshake::MemoryOp>(func.instructions[i].op);
+    if (!memOp.allocateMemory(memoryMap, store, storeTimes))
+      llvm_unreachable("Memory op does not have unique ID!\n");
+    buffers.push_back(memoryMap.lookup(memOp.getID()));
+  }
+
+  unsigned numArgs = func.op->getRegion(0).front().getNumArguments();
+  for (unsigned i = 0; i < numArgs; ++i)
+    readyQueue.tokenArrived(i);
+
+  if (stats) {
+    stats->ops.assign(func.instructions.size(), Statistics::Op());
+    for (unsigned i = 0; i < func.instructions.size(); ++i) {
+      auto &inst = func.instructions[i];
+      auto &op = stats->ops[i];
+      op.stalls.resize(inst.numOperands);
+      if (inst.kind == InstKind::Buffer)
+        op.occupancy.resize(inst.numSlots + 1);
+      else if (inst.kind == InstKind::Memory)
+        op.portAccesses.resize(inst.numLoads + inst.numStores);
+    }
+    firings.clear();
+    tokenFirings.assign(func.slots.size(), noFiring);
+  }
+
+  SmallVector<unsigned, 8> held, produced;
+  SmallVector<uint32_t, 8> nativeProduced;
+  while (true) {
+    if (readyQueue.empty())
+      return func.op->emitError("no operation is ready to execute, the "
+                                "function is deadlocked");
+    unsigned index = readyQueue.pop();
+    auto &inst = func.instructions[index];
+    LLVM_DEBUG(dbgs() << "OP: " << *inst.op << "\n");
+
+    // Record the operands holding a token, such that the producers of the
+    // consumed ones are notified after the instruction fired.
+    held.clear();
+    produced.clear();
+    for (unsigned i = 0; i < inst.numOperands; ++i)
+      if (frame.valid[frame.operand(inst, i)])
+        held.push_back(frame.operand(inst, i));
+
+    if (inst.kind == InstKind::Compute || inst.kind == InstKind::Return) {
+      if (held.size() != inst.numOperands) {
+        LLVM_DEBUG(dbgs() << "Waiting for data...\n");
+        readyQueue.setMissing(index, inst.numOperands - held.size());
+        continue;
+      }
+      readyQueue.setMissing(index, inst.numOperands);
+      if (inst.kind == InstKind::Return) {
+        for (unsigned i = 0; i < results.size(); ++i) {
+          results[i] = frame.toAny(frame.operand(inst, i));
+          resultTimes[i] = frame.times[frame.operand(inst, i)];
+        }
+        if (stats)
+          recordCriticalPath(inst, results.size(), frame);
+        return success();
+      }
+      ++instructionsExecuted;
+    }
+
+    // Fire the instruction through its native code, if it has any.
+    NativeFunction::FireFn nativeFire =
+        native ? native->getFire(index) : nullptr;
+    if (nativeFire) {
+      nativeProduced.resize(inst.numResults);
+      int32_t count = nativeFire(frame.bits.data(), frame.times.data(),
+                                 frame.valid.data(), nativeProduced.data());
+      if (count < 0)
+        continue;
+      produced.append(nativeProduced.begin(), nativeProduced.begin() + count);
+    } else if (!fire(inst, frame, buffers, produced)) {
+      continue;
+    }
+    if (stats)
+      record(index, frame, held, produced);
+
+    for (unsigned slot : held)
+      if (!frame.valid[slot])
+        readyQueue.tokenConsumed(slot);
+    for (unsigned slot : produced)
+      readyQueue.tokenArrived(slot);
+  }
+}
+
+LogicalResult Program::run(ArrayRef<Any> args, std::vector<Any> &results,
+                           std::vector<double> &resultTimes,
+                           std::vector<MemRefBuffer> &store,
+                           std::vector<double> &storeTimes,
+                           uint64_t &instructionsExecuted,
+                           Statistics *stats) const {
+  auto &toplevel = getFunction(0);
+  Frame frame(toplevel);
+  for (unsigned i = 0; i < args.size(); ++i) {
+    frame.fromAny(i, args[i]);
+    frame.valid[i] = 1;
+  }
+
+  Runner runner(*this, store, storeTimes);
+  runner.stats = stats;
+  LogicalResult result = success();
+  if (toplevel.isHandshake) {
+    result = runner.runHandshake(frame, results, resultTimes);
+  } else {
+    auto &ret = runner.runStd(frame);
+    for (unsigned i = 0; i < results.size(); ++i) {
+      results[i] = frame.toAny(frame.operand(ret, i));
+      resultTimes[i] = frame.times[frame.operand(ret, i)];
+    }
+  }
+  instructionsExecuted += runner.instructionsExecuted;
+  return result;
+}
+
+//===----------------------------------------------------------------------===//
+// Statistics
+//===----------------------------------------------------------------------===//
+
+static void printInstruction(llvm::raw_ostream &os, const Function &func,
+                             unsigned index) {
+  auto *op = func.instructions[index].op;
+  os << "#" << index << " " << op->getName() << " at " << op->getLoc();
+}
+
+void Statistics::print(llvm::raw_ostream &os, const Function &func) const {
+  os << "Operation statistics:\n";
+  for (unsigned i = 0; i < ops.size(); ++i) {
+    auto &inst = func.instructions[i];
+    if (inst.kind == InstKind::Nop || inst.kind == InstKind::Return)
+      continue;
+    auto &op = ops[i];
+    os << "  ";
+    printInstruction(os, func, i);
+    os << ": " << op.fires << " fires\n";
+    if (op.stalls.size() > 1) {
+      os << "    stall cycles per input:";
+      for (uint64_t stall : op.stalls)
+        os << " " << stall;
+      os << "\n";
+    }
+    if (!op.occupancy.empty()) {
+      os << "    occupancy histogram:";
+      for (unsigned count = 0; count < op.occupancy.size(); ++count)
+        os << " " << count << ":" << op.occupancy[count];
+      os << "\n";
+    }
+    if (!op.portAccesses.empty()) {
+      os << "    port accesses:";
+      for (unsigned port = 0; port < op.portAccesses.size(); ++port) {
+        uint64_t accesses = op.portAccesses[port];
+        if (port < inst.numLoads)
+          os << " load" << port;
+        else
+          os << " store" << port - inst.numLoads;
+        os << " " << accesses;
+        if (time > 0.0)
+          os << llvm::format(" (%.1f%%)", 100.0 * accesses / time);
+      }
+      os << "\n";
+    }
+  }
+
+  os << "Critical path, " << static_cast<uint64_t>(time) << " cycles:\n";
+  for (auto &step : criticalPath) {
+    os << "  " << static_cast<uint64_t>(step.second) << ": ";
+    printInstruction(os, func, step.first);
+    os << "\n";
+  }
+}
@@ -0,0 +1,236 @@
+//===- Program.h - Pre-compiled functions of handshake-runner ---*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the pre-compiled form of the functions executed by
+// handshake-runner. Every SSA value of a function is assigned a slot in a flat
+// array of typed tokens, and every operation an instruction refering to its
+// operand and result slots by index, such that executing a function neither
+// looks values up in maps nor allocates the tokens it passes around.
+//
+//===----------------------------------------------------------------------===//
+
+// NOLINTNEXTLINE(llvm-header-guard)
+#ifndef HANDSHAKE_RUNNER_PROGRAM_H
+#define HANDSHAKE_RUNNER_PROGRAM_H
+
+#include "circt/Dialect/Handshake/MemRefBuffer.h"
+#include "mlir/IR/Operation.h"
+#include "mlir/Support/LogicalResult.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/Any.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <vector>
+
+namespace circt {
+namespace handshake {
+namespace sim {
+
+/// The kinds of tokens held by the slots.
+enum class SlotKind : uint8_t {
+  /// Integers and indices up to 64 bits wide, stored inline.
+  Int,
+  /// Integers wider than 64 bits, stored in an APInt.
+  WideInt,
+  /// f32 values, stored inline as a double rounded to single precision.
+  Float,
+  /// f64 values, stored inline.
+  Double,
+  /// Memrefs, stored inline as the index of their buffer in the store.
+  Buffer,
+  /// Control tokens, carrying no value.
+  Control,
+};
+
+/// The type of a slot.
+struct Slot {
+  SlotKind kind;
+  unsigned width = 0;
+  /// The index of the slot among the wide integer slots of its function.
+  unsigned wideIndex = 0;
+};
+
+/// The ways an instruction executes.
+enum class InstKind : uint8_t {
+  /// Compute the results from the operands through the compute handler, once
+  /// all the operands hold a token.
+  Compute,
+  // Standard operations accessing memory or changing the control flow.
+  Alloc,
+  Load,
+  Store,
+  Branch,
+  CondBranch,
+  Call,
+  /// Return the operands, once they all hold a token.
+  Return,
+  /// Handshake operations firing once all their operands hold a token and all
+  /// their results are free, producing their results after a latency.
+  General,
+  // Handshake operations with a firing rule of their own.
+  Merge,
+  Mux,
+  ControlMerge,
+  ConditionalBranch,
+  HandshakeLoad,
+  Memory,
+  /// Handshake buffers, queuing the tokens of their operand in slots of their
+  /// own.
+  Buffer,
+  Sink,
+  /// Operations without any effect on the simulation.
+  Nop,
+};
+
+/// The computations of the compute handlers.
+enum class ComputeOp : uint8_t {
+  Constant,
+  AddI,
+  SubI,
+  MulI,
+  SignedDivI,
+  UnsignedDivI,
+  CmpI,
+  AddF,
+  SubF,
+  MulF,
+  DivF,
+  CmpF,
+  SignExtendI,
+  ZeroExtendI,
+  /// Forward each operand to the result of the same index.
+  Forward,
+  /// Forward the first operand to all the results.
+  Fork,
+  /// Produce control tokens, which carry no value.
+  None,
+};
+
+struct Instruction;
+struct Frame;
+class NativeFunction;
+
+/// The handler computing the results of an instruction from its operands.
+using ComputeFn = void (*)(const Instruction &inst, Frame &frame);
+
+/// An operation of a pre-compiled function.
+struct Instruction {
+  InstKind kind = InstKind::Nop;
+  ComputeOp computeOp = ComputeOp::None;
+  ComputeFn compute = nullptr;
+  /// The position of the operand and result slot indices in the slot list of
+  /// the function. The results of a standard branch are the arguments of its
+  /// destinations.
+  unsigned operands = 0, numOperands = 0;
+  unsigned results = 0, numResults = 0;
+  /// Kind specific data: the constant, shape, callee, memory or comparison
+  /// predicate index, the number of true operands of a conditional branch, or
+  /// the first slot of a buffer.
+  unsigned aux = 0;
+  /// The latency of a handshake instruction.
+  unsigned latency = 0;
+  /// The first instruction of the destinations of a standard branch.
+  unsigned targets[2] = {0, 0};
+  /// The number of load and store ports of a memory.
+  unsigned numLoads = 0, numStores = 0;
+  /// The number of slots of a buffer, allocated from `aux` on.
+  unsigned numSlots = 0;
+  mlir::Operation *op = nullptr;
+};
+
+/// A pre-compiled std or handshake function.
+struct Function {
+  mlir::Operation *op = nullptr;
+  bool isHandshake = false;
+  /// The slots, starting with the arguments of the function.
+  std::vector<Slot> slots;
+  unsigned numWide = 0;
+  /// The operand and result slots of the instructions.
+  std::vector<unsigned> slotList;
+  std::vector<Instruction> instructions;
+  /// The constants and memref shapes refered to by the instructions.
+  std::vector<llvm::APInt> constants;
+  std::vector<llvm::SmallVector<int64_t, 4>> shapes;
+  /// The memory instructions of a handshake function.
+  std::vector<unsigned> memories;
+  /// The instructions using each slot of a handshake function, in the order
+  /// of the uses of the value, starting at userBegin[slot], and the
+  /// instruction producing it.
+  std::vector<unsigned> userBegin, users, producers;
+};
+
+/// The statistics of the execution of a handshake function, per instruction.
+struct Statistics {
+  struct Op {
+    uint64_t fires = 0;
+    /// The cycles the instruction waited for each operand after the other
+    /// consumed ones held a token.
+    llvm::SmallVector<uint64_t, 4> stalls;
+    /// The number of firings of a buffer after which it held each number of
+    /// tokens.
+    llvm::SmallVector<uint64_t, 4> occupancy;
+    /// The number of accesses through each load, then store port of a memory.
+    llvm::SmallVector<uint64_t, 4> portAccesses;
+  };
+  std::vector<Op> ops;
+  /// The instructions the latest result depends on through the latest operand
+  /// of each, with the time they produced their token at.
+  std::vector<std::pair<unsigned, double>> criticalPath;
+  /// The time the last result is produced at.
+  double time = 0.0;
+
+  void print(llvm::raw_ostream &os, const Function &func) const;
+};
+
+/// A function and the functions it calls, pre-compiled.
+class Program {
+public:
+  /// Compile the given std or handshake function and the functions it calls.
+  /// Returns null if they use an operation the program can not execute, in
+  /// which case they have to be interpreted.
+  static std::unique_ptr<Program> compile(mlir::Operation *toplevel);
+
+  ~Program();
+
+  /// Compile the handshake operations of the toplevel function to native code
+  /// with the LLVM JIT, which then fires them instead of the program.
+  llvm::Error compileNative();
+
+  /// Run the toplevel function with the given arguments, available at time 0,
+  /// and store its first `results.size()` results and the time they are
+  /// produced at. Memrefs are the index of their buffer in the store. Returns
+  /// failure if a handshake function deadlocks. The statistics are collected
+  /// if `stats` is given and the toplevel function is a handshake one.
+  mlir::LogicalResult run(llvm::ArrayRef<llvm::Any> args,
+                          std::vector<llvm::Any> &results,
+                          std::vector<double> &resultTimes,
+                          std::vector<MemRefBuffer> &store,
+                          std::vector<double> &storeTimes,
+                          uint64_t &instructionsExecuted,
+                          Statistics *stats = nullptr) const;
+
+  const Function &getFunction(unsigned i) const { return *functions[i]; }
+  const NativeFunction *getNative() const { return native.get(); }
+
+private:
+  friend class Compiler;
+
+  /// The functions, starting with the toplevel one.
+  std::vector<std::unique_ptr<Function>> functions;
+  /// The native code of the toplevel function, if compiled.
+  std::unique_ptr<NativeFunction> native;
+};
+
+} // namespace sim
+} // namespace handshake
+} // namespace circt
+
+#endif // HANDSHAKE_RUNNER_PROGRAM_H
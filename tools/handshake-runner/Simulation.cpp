@@ -11,13 +11,19 @@
 //
 //===----------------------------------------------------------------------===//
 
-#include <list>
+#include <deque>
 
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
 
 #include "circt/Dialect/Handshake/HandshakeOps.h"
 #include "circt/Dialect/Handshake/Simulation.h"
 
+#include "Program.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
 #define DEBUG_TYPE "runner"
 
 #define INDEX_WIDTH 32
@@ -68,7 +74,7 @@ void executeOp(mlir::SubIOp op, std::vector<Any> &in, std::vector<Any> &out) {
 }
 
 void executeOp(mlir::SubFOp op, std::vector<Any> &in, std::vector<Any> &out) {
-  out[0] = any_cast<APFloat>(in[0]) + any_cast<APFloat>(in[1]);
+  out[0] = any_cast<APFloat>(in[0]) - any_cast<APFloat>(in[1]);
 }
 
 void executeOp(mlir::MulIOp op, std::vector<Any> &in, std::vector<Any> &out) {
@@ -116,7 +122,7 @@ void executeOp(mlir::ZeroExtendIOp op, std::vector<Any> &in,
 // given store.  Return the pseuddo-pointer to the new matrix in the
 // store (i.e. the first dimension index)
 unsigned allocateMemRef(mlir::MemRefType type, std::vector<Any> &in,
-                        std::vector<std::vector<Any>> &store,
+                        std::vector<handshake::MemRefBuffer> &store,
                         std::vector<double> &storeTimes) {
   ArrayRef<int64_t> shape = type.getShape();
   int64_t allocationSize = 1;
@@ -130,26 +136,13 @@ unsigned allocateMemRef(mlir::MemRefType type, std::vector<Any> &in,
     }
   }
   unsigned ptr = store.size();
-  store.resize(ptr + 1);
-  storeTimes.resize(ptr + 1);
-  store[ptr].resize(allocationSize);
-  storeTimes[ptr] = 0.0;
-  mlir::Type elementType = type.getElementType();
-  int64_t width = elementType.getIntOrFloatBitWidth();
-  for (int i = 0; i < allocationSize; i++) {
-    if (elementType.isa<mlir::IntegerType>()) {
-      store[ptr][i] = APInt(width, 0);
-    } else if (elementType.isa<mlir::FloatType>()) {
-      store[ptr][i] = APFloat(0.0);
-    } else {
-      llvm_unreachable("Unknown result type!\n");
-    }
-  }
+  store.emplace_back(type.getElementType(), allocationSize);
+  storeTimes.push_back(0.0);
   return ptr;
 }
 
 void executeOp(mlir::LoadOp op, std::vector<Any> &in, std::vector<Any> &out,
-               std::vector<std::vector<Any>> &store) {
+               std::vector<handshake::MemRefBuffer> &store) {
   ArrayRef<int64_t> shape = op.getMemRefType().getShape();
   unsigned address = 0;
   for (unsigned i = 0; i < shape.size(); i++) {
@@ -161,12 +154,11 @@ void executeOp(mlir::LoadOp op, std::vector<Any> &in, std::vector<Any> &out,
   assert(address < ref.size());
   //  LLVM_DEBUG(dbgs() << "Load " << ref[address] << " from " << ptr << "[" <<
   //  address << "]\n");
-  Any result = ref[address];
-  out[0] = result;
+  out[0] = ref.get(address);
 }
 
 void executeOp(mlir::StoreOp op, std::vector<Any> &in, std::vector<Any> &out,
-               std::vector<std::vector<Any>> &store) {
+               std::vector<handshake::MemRefBuffer> &store) {
   ArrayRef<int64_t> shape = op.getMemRefType().getShape();
   unsigned address = 0;
   for (unsigned i = 0; i < shape.size(); i++) {
@@ -178,7 +170,7 @@ void executeOp(mlir::StoreOp op, std::vector<Any> &in, std::vector<Any> &out,
   //  LLVM_DEBUG(dbgs() << "Store " << in[0] << " to " << ptr << "[" << address
   //  << "]\n");
   assert(address < ref.size());
-  ref[address] = in[0];
+  ref.set(address, in[0]);
 }
 
 void debugArg(const std::string &head, mlir::Value op, const APInt &value,
@@ -251,7 +243,11 @@ std::string printAnyValueWithType(mlir::Type type, Any &value) {
     out << any_cast<APInt>(value).getSExtValue();
     return out.str();
   } else if (type.isa<mlir::FloatType>()) {
-    out << any_cast<APFloat>(value).convertToDouble();
+    APFloat apfloat = any_cast<APFloat>(value);
+    bool losesInfo;
+    apfloat.convert(APFloat::IEEEdouble(), APFloat::rmNearestTiesToEven,
+                    &losesInfo);
+    out << apfloat.convertToDouble();
     return out.str();
   } else if (type.isa<mlir::NoneType>()) {
     return "none";
@@ -260,20 +256,82 @@ std::string printAnyValueWithType(mlir::Type type, Any &value) {
   }
 }
 
-void scheduleIfNeeded(std::list<mlir::Operation *> &readyList,
-                      llvm::DenseMap<mlir::Value, Any> &valueMap,
-                      mlir::Operation *op) {
-  if (std::find(readyList.begin(), readyList.end(), op) == readyList.end()) {
-    readyList.push_back(op);
+namespace {
+/// The operations of a handshake function which might be ready to execute, in
+/// FIFO order. Each operation is indexed once, such that it is queued at most
+/// once. The operations executed by the runner itself are only queued once all
+/// their operands hold a token, tracked by the number of operands still
+/// missing one. The handshake operations are queued whenever a token arrives on
+/// one of their operands, and the general ones also whenever a token leaves one
+/// of their results. They check their operands themselves.
+class ReadyQueue {
+public:
+  explicit ReadyQueue(handshake::FuncOp func) {
+    func.walk([&](mlir::Operation *op) {
+      index[op] = ops.size();
+      ops.push_back(op);
+      missing.push_back(op->getNumOperands());
+    });
+    queued.resize(ops.size());
   }
-}
-void scheduleUses(std::list<mlir::Operation *> &readyList,
-                  llvm::DenseMap<mlir::Value, Any> &valueMap,
-                  mlir::Value value) {
-  for (auto &use : value.getUses()) {
-    scheduleIfNeeded(readyList, valueMap, use.getOwner());
+
+  bool empty() const { return fifo.empty(); }
+
+  /// Pop the operation at the front of the queue.
+  mlir::Operation &pop() {
+    unsigned i = fifo.front();
+    fifo.pop_front();
+    queued.reset(i);
+    return *ops[i];
+  }
+
+  /// Queue the users of a value which just received a token.
+  void tokenArrived(mlir::Value value) {
+    for (auto &use : value.getUses()) {
+      auto *user = use.getOwner();
+      unsigned i = index.lookup(user);
+      if (isa<handshake::ExecutableOpInterface>(user))
+        schedule(i);
+      else if (missing[i] > 0 && --missing[i] == 0)
+        schedule(i);
+    }
+  }
+
+  /// Queue the general handshake operation producing a value whose token was
+  /// just consumed, as it might have been waiting for its results to be free.
+  /// The other handshake operations do not wait for their results.
+  void tokenConsumed(mlir::Value value) {
+    auto *def = value.getDefiningOp();
+    if (def && isa<handshake::GeneralOpInterface>(def))
+      schedule(index.lookup(def));
   }
-}
+
+  /// Set the number of operands of an operation executed by the runner which
+  /// are still missing a token.
+  void setMissing(mlir::Operation &op, unsigned count) {
+    missing[index.lookup(&op)] = count;
+  }
+
+  void dump() const {
+    for (auto i : fifo)
+      dbgs() << "READY: " << *ops[i] << "\n";
+  }
+
+private:
+  void schedule(unsigned i) {
+    if (queued.test(i))
+      return;
+    queued.set(i);
+    fifo.push_back(i);
+  }
+
+  llvm::DenseMap<mlir::Operation *, unsigned> index;
+  std::vector<mlir::Operation *> ops;
+  std::vector<unsigned> missing;
+  llvm::BitVector queued;
+  std::deque<unsigned> fifo;
+};
+} // namespace
 
 bool executeStdOp(mlir::Operation &op, std::vector<Any> &inValues,
                   std::vector<Any> &outValues) {
@@ -319,7 +377,7 @@ void executeFunction(mlir::FuncOp &toplevel,
                      llvm::DenseMap<mlir::Value, double> &timeMap,
                      std::vector<Any> &results,
                      std::vector<double> &resultTimes,
-                     std::vector<std::vector<Any>> &store,
+                     std::vector<handshake::MemRefBuffer> &store,
                      std::vector<double> &storeTimes) {
   mlir::Block &entryBlock = toplevel.getBody().front();
   // An iterator which walks over the instructions.
@@ -421,7 +479,7 @@ void executeFunction(mlir::FuncOp &toplevel,
         llvm::DenseMap<mlir::Value, double> newTimeMap;
         std::vector<Any> results(outputs);
         std::vector<double> resultTimes(outputs);
-        std::vector<std::vector<Any>> store;
+        std::vector<handshake::MemRefBuffer> store;
         std::vector<double> storeTimes;
         mlir::Block &entryBlock = funcOp.getBody().front();
         mlir::Block::BlockArgListType blockArgs = entryBlock.getArguments();
@@ -458,18 +516,21 @@ void executeFunction(mlir::FuncOp &toplevel,
   }
 }
 
-void executeHandshakeFunction(handshake::FuncOp &toplevel,
-                              llvm::DenseMap<mlir::Value, Any> &valueMap,
-                              llvm::DenseMap<mlir::Value, double> &timeMap,
-                              std::vector<Any> &results,
-                              std::vector<double> &resultTimes,
-                              std::vector<std::vector<Any>> &store,
-                              std::vector<double> &storeTimes) {
+/// Execute a handshake function until it returns. Returns failure if the
+/// function deadlocks before returning.
+LogicalResult
+executeHandshakeFunction(handshake::FuncOp &toplevel,
+                         llvm::DenseMap<mlir::Value, Any> &valueMap,
+                         llvm::DenseMap<mlir::Value, double> &timeMap,
+                         std::vector<Any> &results,
+                         std::vector<double> &resultTimes,
+                         std::vector<handshake::MemRefBuffer> &store,
+                         std::vector<double> &storeTimes) {
   mlir::Block &entryBlock = toplevel.getBody().front();
   // The arguments of the entry block.
   mlir::Block::BlockArgListType blockArgs = entryBlock.getArguments();
-  // A list of operations which might be ready to execute.
-  std::list<mlir::Operation *> readyList;
+  // The operations which might be ready to execute.
+  ReadyQueue readyQueue(toplevel);
   // A map of memory ops
   llvm::DenseMap<unsigned, unsigned> memoryMap;
 
@@ -481,15 +542,13 @@ void executeHandshakeFunction(handshake::FuncOp &toplevel,
   });
 
   for (unsigned i = 0; i < blockArgs.size(); i++)
-    scheduleUses(readyList, valueMap, blockArgs[i]);
+    readyQueue.tokenArrived(blockArgs[i]);
 
 #define EXTRA_DEBUG
   while (true) {
 #ifdef EXTRA_DEBUG
     LLVM_DEBUG(
-        for (auto t
-             : readyList) { dbgs() << "READY: " << *t << "\n"; } dbgs()
-            << "Live: " << valueMap.size() << "\n";
+        readyQueue.dump(); dbgs() << "Live: " << valueMap.size() << "\n";
         for (auto t
              : valueMap) {
           debugArg("Value:", t.first, t.second, 0.0);
@@ -497,41 +556,39 @@ void executeHandshakeFunction(handshake::FuncOp &toplevel,
           //        "\n";
         });
 #endif
-    assert(readyList.size() > 0);
-    mlir::Operation &op = *readyList.front();
-    readyList.pop_front();
-
-    /*    for(mlir::Value out : op.getResults()) {
-      if(valueMap.count(out) != 0) {
-        LLVM_DEBUG(dbgs() << "OP:  " << op << "\n");
-        for(auto t : valueMap) {
-          dbgs() << "Value: " << *(t.first) << " " << t.second << "\n";
-        }
-        assert(false);
-      }
-      }*/
-
-    // Execute handshake ops through ExecutableOpInterface
+    if (readyQueue.empty())
+      return toplevel.emitError("no operation is ready to execute, the "
+                                "function is deadlocked");
+    mlir::Operation &op = readyQueue.pop();
+
+    // Execute handshake ops through ExecutableOpInterface. An op which is not
+    // ready waits for a token to arrive on its operands or to leave its
+    // results.
     if (auto handshakeOp = dyn_cast<handshake::ExecutableOpInterface>(op)) {
+      SmallVector<mlir::Value, 4> held;
+      for (mlir::Value in : op.getOperands())
+        if (valueMap.count(in))
+          held.push_back(in);
       std::vector<mlir::Value> scheduleList;
-      if (!handshakeOp.tryExecute(valueMap, memoryMap, timeMap, store,
-                                  scheduleList))
-        readyList.push_back(&op);
+      handshakeOp.tryExecute(valueMap, memoryMap, timeMap, store, scheduleList);
+      for (mlir::Value in : held)
+        if (valueMap.count(in) == 0)
+          readyQueue.tokenConsumed(in);
       for (mlir::Value out : scheduleList)
-        scheduleUses(readyList, valueMap, out);
+        readyQueue.tokenArrived(out);
       continue;
     }
 
     int64_t i = 0;
     std::vector<Any> inValues(op.getNumOperands());
     std::vector<Any> outValues(op.getNumResults());
-    bool reschedule = false;
+    unsigned missing = 0;
     LLVM_DEBUG(dbgs() << "OP: (" << op.getNumOperands() << "->"
                       << op.getNumResults() << ")" << op << "\n");
-    double time;
+    double time = 0.0;
     for (mlir::Value in : op.getOperands()) {
       if (valueMap.count(in) == 0) {
-        reschedule = true;
+        ++missing;
         continue;
       }
       inValues[i] = valueMap[in];
@@ -539,22 +596,24 @@ void executeHandshakeFunction(handshake::FuncOp &toplevel,
       LLVM_DEBUG(debugArg("IN", in, inValues[i], timeMap[in]));
       i++;
     }
-    if (reschedule) {
-      LLVM_DEBUG(dbgs() << "Rescheduling data...\n");
-      readyList.push_back(&op);
+    if (missing) {
+      LLVM_DEBUG(dbgs() << "Waiting for data...\n");
+      readyQueue.setMissing(op, missing);
       continue;
     }
     // Consume the inputs.
     for (mlir::Value in : op.getOperands()) {
       valueMap.erase(in);
+      readyQueue.tokenConsumed(in);
     }
+    readyQueue.setMissing(op, op.getNumOperands());
     if (executeStdOp(op, inValues, outValues)) {
     } else if (auto returnOp = dyn_cast<handshake::ReturnOp>(op)) {
       for (unsigned i = 0; i < results.size(); i++) {
         results[i] = inValues[i];
         resultTimes[i] = timeMap[returnOp.getOperand(i)];
       }
-      return;
+      return success();
       //} else {
       // implement function calls.
     } else {
@@ -566,7 +625,7 @@ void executeHandshakeFunction(handshake::FuncOp &toplevel,
       assert(outValues[i].hasValue());
       valueMap[out] = outValues[i];
       timeMap[out] = time + 1;
-      scheduleUses(readyList, valueMap, out);
+      readyQueue.tokenArrived(out);
 
       i++;
     }
@@ -574,12 +633,40 @@ void executeHandshakeFunction(handshake::FuncOp &toplevel,
   }
 }
 
-bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
-              mlir::OwningModuleRef &module, mlir::MLIRContext &context) {
+/// Pre-compile the toplevel function, unless it has to be interpreted, and
+/// compile it to native code in JIT mode. Returns failure on JIT errors.
+static LogicalResult
+compileToplevel(StringRef toplevelFunction, mlir::ModuleOp module,
+                const SimulationOptions &options,
+                std::unique_ptr<handshake::sim::Program> &program) {
+  // Run the pre-compiled form of the function, unless it uses operations only
+  // the interpreter supports.
+  if (options.mode != ExecutionMode::Interpret)
+    program = handshake::sim::Program::compile(
+        module.lookupSymbol(toplevelFunction));
+  if (program && options.mode == ExecutionMode::JIT) {
+    if (auto err = program->compileNative()) {
+      logAllUnhandledErrors(std::move(err), errs(), "JIT compilation failed: ");
+      return failure();
+    }
+  }
+  return success();
+}
+
+/// Execute the toplevel function with the given arguments, through the
+/// pre-compiled program if any, and print its results to `os`. The final
+/// memref arguments are written to files named after `memrefOutput`, if set.
+/// Only reads the module and the program, such that functions can be executed
+/// concurrently.
+static bool runSimulation(StringRef toplevelFunction,
+                          ArrayRef<std::string> inputArgs,
+                          mlir::ModuleOp module,
+                          const handshake::sim::Program *program,
+                          const SimulationOptions &options,
+                          StringRef memrefOutput, raw_ostream &os) {
   // The store associates each allocation in the program
-  // (represented by a int) with a vector of values which can be
-  // accessed by it.  Currently values are assumed to be an integer.
-  std::vector<std::vector<Any>> store;
+  // (represented by a int) with the buffer holding its elements.
+  std::vector<handshake::MemRefBuffer> store;
   std::vector<double> storeTimes;
 
   // The valueMap associates each SSA statement in the program
@@ -606,7 +693,7 @@ bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
   unsigned realOutputs;
 
   if (mlir::FuncOp toplevel =
-          module->lookupSymbol<mlir::FuncOp>(toplevelFunction)) {
+          module.lookupSymbol<mlir::FuncOp>(toplevelFunction)) {
     ftype = toplevel.getType();
     mlir::Block &entryBlock = toplevel.getBody().front();
     blockArgs = entryBlock.getArguments();
@@ -617,7 +704,7 @@ bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
     outputs = ftype.getNumResults();
     realOutputs = outputs;
   } else if (handshake::FuncOp toplevel =
-                 module->lookupSymbol<handshake::FuncOp>(toplevelFunction)) {
+                 module.lookupSymbol<handshake::FuncOp>(toplevelFunction)) {
     ftype = toplevel.getType();
     mlir::Block &entryBlock = toplevel.getBody().front();
     blockArgs = entryBlock.getArguments();
@@ -656,17 +743,35 @@ bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
     if (type.isa<mlir::MemRefType>()) {
       // We require this memref type to be fully specified.
       auto memreftype = type.dyn_cast<mlir::MemRefType>();
-      std::vector<Any> nothing;
-      std::string x;
-      unsigned buffer = allocateMemRef(memreftype, nothing, store, storeTimes);
+      unsigned buffer;
+      StringRef input = inputArgs[i];
+      if (input.consume_front("@")) {
+        // Read the elements from a raw binary file.
+        auto file = handshake::MemRefBuffer::readFile(
+            memreftype.getElementType(), memreftype.getNumElements(), input,
+            options.mapMemRefs);
+        if (!file) {
+          logAllUnhandledErrors(file.takeError(), errs(),
+                                "Could not read memref argument: ");
+          return 1;
+        }
+        buffer = store.size();
+        store.push_back(std::move(*file));
+        storeTimes.push_back(0.0);
+      } else {
+        std::vector<Any> nothing;
+        std::string x;
+        buffer = allocateMemRef(memreftype, nothing, store, storeTimes);
+        int64_t j = 0;
+        std::stringstream arg(inputArgs[i]);
+        while (!arg.eof()) {
+          getline(arg, x, ',');
+          store[buffer].set(j++,
+                            readValueWithType(memreftype.getElementType(), x));
+        }
+      }
       valueMap[blockArgs[i]] = buffer;
       timeMap[blockArgs[i]] = 0.0;
-      int64_t i = 0;
-      std::stringstream arg(inputArgs[i]);
-      while (!arg.eof()) {
-        getline(arg, x, ',');
-        store[buffer][i++] = readValueWithType(memreftype.getElementType(), x);
-      }
     } else {
       Any value = readValueWithType(type, inputArgs[i]);
       valueMap[blockArgs[i]] = value;
@@ -676,19 +781,30 @@ bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
 
   std::vector<Any> results(realOutputs);
   std::vector<double> resultTimes(realOutputs);
-  if (mlir::FuncOp toplevel =
-          module->lookupSymbol<mlir::FuncOp>(toplevelFunction)) {
+  handshake::sim::Statistics stats;
+  if (program) {
+    std::vector<Any> args;
+    for (mlir::Value arg : blockArgs)
+      args.push_back(valueMap[arg]);
+    uint64_t executed = 0;
+    if (failed(program->run(args, results, resultTimes, store, storeTimes,
+                            executed, options.runStats ? &stats : nullptr)))
+      return 1;
+    instructionsExecuted += executed;
+  } else if (mlir::FuncOp toplevel =
+                 module.lookupSymbol<mlir::FuncOp>(toplevelFunction)) {
     executeFunction(toplevel, valueMap, timeMap, results, resultTimes, store,
                     storeTimes);
   } else if (handshake::FuncOp toplevel =
-                 module->lookupSymbol<handshake::FuncOp>(toplevelFunction)) {
-    executeHandshakeFunction(toplevel, valueMap, timeMap, results, resultTimes,
-                             store, storeTimes);
+                 module.lookupSymbol<handshake::FuncOp>(toplevelFunction)) {
+    if (failed(executeHandshakeFunction(toplevel, valueMap, timeMap, results,
+                                        resultTimes, store, storeTimes)))
+      return 1;
   }
   double time = 0.0;
   for (unsigned i = 0; i < results.size(); i++) {
     mlir::Type t = ftype.getResult(i);
-    outs() << printAnyValueWithType(t, results[i]) << " ";
+    os << printAnyValueWithType(t, results[i]) << " ";
     time = std::max(resultTimes[i], time);
   }
   // Go back through the arguments and output any memrefs.
@@ -698,18 +814,87 @@ bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
       // We require this memref type to be fully specified.
       auto memreftype = type.dyn_cast<mlir::MemRefType>();
       unsigned buffer = any_cast<unsigned>(valueMap[blockArgs[i]]);
+      if (!memrefOutput.empty()) {
+        // Write the elements to a raw binary file instead of printing them.
+        std::string path = (memrefOutput + Twine(i) + ".bin").str();
+        if (auto err = store[buffer].writeFile(path)) {
+          logAllUnhandledErrors(std::move(err), errs(),
+                                "Could not write memref argument: ");
+          return 1;
+        }
+        os << "@" << path << " ";
+        continue;
+      }
       auto elementType = memreftype.getElementType();
       for (int j = 0; j < memreftype.getNumElements(); j++) {
         if (j != 0)
-          outs() << ",";
-        outs() << printAnyValueWithType(elementType, store[buffer][j]);
+          os << ",";
+        Any element = store[buffer].get(j);
+        os << printAnyValueWithType(elementType, element);
       }
-      outs() << " ";
+      os << " ";
     }
   }
-  outs() << "\n";
+  os << "\n";
 
   simulatedTime += (int)time;
 
+  if (options.runStats) {
+    if (program && program->getFunction(0).isHandshake)
+      stats.print(os, program->getFunction(0));
+    else
+      errs() << "Operation statistics are only collected for pre-compiled "
+                "handshake functions\n";
+  }
+
   return 0;
 }
+
+bool simulate(StringRef toplevelFunction, ArrayRef<std::string> inputArgs,
+              mlir::OwningModuleRef &module, mlir::MLIRContext &context,
+              const SimulationOptions &options) {
+  std::unique_ptr<handshake::sim::Program> program;
+  if (failed(compileToplevel(toplevelFunction, *module, options, program)))
+    return 1;
+  return runSimulation(toplevelFunction, inputArgs, *module, program.get(),
+                       options, options.memrefOutput, outs());
+}
+
+bool simulateSweep(StringRef toplevelFunction,
+                   ArrayRef<std::vector<std::string>> inputVectors,
+                   mlir::OwningModuleRef &module, mlir::MLIRContext &context,
+                   const SimulationOptions &options, unsigned numThreads) {
+  std::unique_ptr<handshake::sim::Program> program;
+  if (failed(compileToplevel(toplevelFunction, *module, options, program)))
+    return 1;
+
+  // Every execution prints to a stream of its own, printed in input order
+  // once they all finished.
+  std::vector<std::string> outputs(inputVectors.size());
+  std::vector<char> failures(inputVectors.size());
+  {
+    ThreadPool pool(hardware_concurrency(numThreads));
+    for (unsigned i = 0; i < inputVectors.size(); ++i) {
+      pool.async([&, i] {
+        std::string memrefOutput;
+        if (!options.memrefOutput.empty())
+          memrefOutput = options.memrefOutput + std::to_string(i) + ".";
+        raw_string_ostream os(outputs[i]);
+        failures[i] =
+            runSimulation(toplevelFunction, inputVectors[i], *module,
+                          program.get(), options, memrefOutput, os);
+      });
+    }
+    pool.wait();
+  }
+
+  bool failed = false;
+  for (unsigned i = 0; i < inputVectors.size(); ++i) {
+    outs() << outputs[i];
+    if (failures[i]) {
+      errs() << "Execution " << i << " failed\n";
+      failed = true;
+    }
+  }
+  return failed;
+}
@@ -16,7 +16,9 @@
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/MLIRContext.h"
 #include "mlir/Parser.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/LineIterator.h"
 
 #include "circt/Dialect/Handshake/HandshakeOps.h"
 #include "circt/Dialect/Handshake/Simulation.h"
@@ -39,9 +41,43 @@ static cl::opt<std::string>
                      cl::desc("The toplevel function to execute"),
                      cl::init("main"), cl::cat(mainCategory));
 
-// static opt<bool> runStats("runStats", cl::Optional,
-//                           cl::desc("Print Execution Statistics"),
-//                           cl::init(false), cl::cat(mainCategory));
+static cl::opt<ExecutionMode> executionMode(
+    cl::desc("Execution mode:"), cl::init(ExecutionMode::Compiled),
+    cl::values(clEnumValN(ExecutionMode::Interpret, "interpret",
+                          "Interpret the operations instead of running the "
+                          "pre-compiled function"),
+               clEnumValN(ExecutionMode::JIT, "jit",
+                          "Fire the handshake operations of the pre-compiled "
+                          "function through native code")),
+    cl::cat(mainCategory));
+
+static cl::opt<bool> runStats("runStats", cl::Optional,
+                              cl::desc("Print Execution Statistics"),
+                              cl::init(false), cl::cat(mainCategory));
+
+static cl::opt<bool>
+    mapMemRefs("map-memrefs",
+               cl::desc("Map the memref arguments read from raw binary files "
+                        "to memory instead of reading them"),
+               cl::init(true), cl::cat(mainCategory));
+
+static cl::opt<std::string> memrefOutput(
+    "memref-output",
+    cl::desc("Write the final memref arguments to raw binary files named "
+             "<prefix><argument index>.bin instead of printing them"),
+    cl::value_desc("prefix"), cl::cat(mainCategory));
+
+static cl::opt<std::string> inputVectors(
+    "input-vectors",
+    cl::desc("Execute the function once for each line of the given file, "
+             "holding its arguments separated by spaces, concurrently"),
+    cl::value_desc("file"), cl::cat(mainCategory));
+
+static cl::opt<unsigned>
+    numThreads("threads",
+               cl::desc("The number of threads executing the input vectors, "
+                        "all the hardware threads by default"),
+               cl::init(0), cl::cat(mainCategory));
 
 int main(int argc, char **argv) {
   InitLLVM y(argc, argv);
@@ -51,7 +87,8 @@ int main(int argc, char **argv) {
       "This application executes a function in the given MLIR module\n"
       "Arguments to the function are passed on the command line and\n"
       "results are returned on stdout.\n"
-      "Memref types are specified as a comma-separated list of values.\n");
+      "Memref types are specified as a comma-separated list of values,\n"
+      "or as @<file> to read them from a raw binary file.\n");
 
   auto file_or_err = MemoryBuffer::getFileOrSTDIN(inputFileName.c_str());
   if (std::error_code error = file_or_err.getError()) {
@@ -77,5 +114,33 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  return simulate(toplevelFunction, inputArgs, module, context);
+  SimulationOptions options;
+  options.mode = executionMode;
+  options.runStats = runStats;
+  options.mapMemRefs = mapMemRefs;
+  options.memrefOutput = memrefOutput;
+  if (inputVectors.empty())
+    return simulate(toplevelFunction, inputArgs, module, context, options);
+
+  if (!inputArgs.empty()) {
+    errs() << argv[0] << ": arguments can not be given along with input "
+           << "vectors\n";
+    return 1;
+  }
+  auto vectorsOrErr = MemoryBuffer::getFileOrSTDIN(inputVectors);
+  if (std::error_code error = vectorsOrErr.getError()) {
+    errs() << argv[0] << ": could not open input vectors '" << inputVectors
+           << "': " << error.message() << "\n";
+    return 1;
+  }
+  // Every line which is neither blank nor a comment is an input vector.
+  std::vector<std::vector<std::string>> vectors;
+  for (line_iterator line(**vectorsOrErr, /*SkipBlanks=*/true, '#');
+       !line.is_at_eof(); ++line) {
+    SmallVector<StringRef, 8> args;
+    SplitString(*line, args);
+    vectors.emplace_back(args.begin(), args.end());
+  }
+  return simulateSweep(toplevelFunction, vectors, module, context, options,
+                       numThreads);
 }
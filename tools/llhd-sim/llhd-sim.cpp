@@ -24,8 +24,16 @@
 #include "mlir/Target/LLVMIR/Export.h"
 #include "mlir/Transforms/Passes.h"
 
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
 #include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/xxhash.h"
+
+#include <atomic>
 
 using namespace llvm;
 using namespace mlir;
@@ -47,6 +55,30 @@ static cl::opt<uint64_t> maxTime(
              "picoseconds, including all sub-steps for that real-time step"),
     cl::value_desc("max-time"));
 
+static cl::opt<unsigned> numThreads(
+    "j",
+    cl::desc("Number of threads used to evaluate the instances woken up in "
+             "the same delta cycle"),
+    cl::value_desc("N"), cl::init(1));
+
+static cl::opt<unsigned> numCompileThreads(
+    "compile-threads",
+    cl::desc("Number of threads used to compile the design, split in "
+             "partitions of units. A single thread compiles the design lazily"),
+    cl::value_desc("N"), cl::init(1));
+
+static cl::opt<bool> levelize(
+    "levelize",
+    cl::desc("Evaluate the entities in topological order, settling the "
+             "combinational logic within each delta cycle. Processes and "
+             "registers stay event-driven"));
+
+static cl::opt<bool> driveLogs(
+    "drive-logs",
+    cl::desc("Make the compiled units append their signal drives to a log "
+             "drained after each invocation, instead of calling the runtime "
+             "library for each drive"));
+
 static cl::opt<bool>
     dumpLLVMDialect("dump-llvm-dialect",
                     cl::desc("Dump the LLVM IR dialect module"));
@@ -60,6 +92,63 @@ static cl::opt<bool> dumpMLIR("dump-mlir",
 static cl::opt<bool> dumpLayout("dump-layout",
                                 cl::desc("Dump the gathered instance layout"));
 
+static cl::opt<bool>
+    dumpQueueStats("dump-queue-stats",
+                   cl::desc("Dump the event queue statistics after simulation"));
+
+static cl::opt<bool>
+    profile("profile",
+            cl::desc("Dump the time spent in each instance, the signal change "
+                     "counts and the delta cycle statistics after simulation"));
+
+static cl::opt<std::string> profileTrace(
+    "profile-trace",
+    cl::desc("Write the instance invocations and the event queue size to the "
+             "given file, in the Chrome trace event format"),
+    cl::value_desc("filename"));
+
+static cl::list<std::string> traceFilters(
+    "trace-filter",
+    cl::desc("Only trace the signals whose hierarchical name, in the form "
+             "<instance path>/<signal>, matches the given glob pattern. Can be "
+             "given multiple times"),
+    cl::value_desc("hier-glob"), cl::ZeroOrMore);
+
+static cl::opt<uint64_t> checkpointAt(
+    "checkpoint-at",
+    cl::desc("Save a checkpoint of the simulation state before running the "
+             "first step at or after the given time in picoseconds"),
+    cl::value_desc("time"));
+
+static cl::opt<std::string>
+    checkpointFile("checkpoint-file",
+                   cl::desc("The file the checkpoint is saved to"),
+                   cl::value_desc("filename"), cl::init("llhd-sim.ckpt"));
+
+static cl::opt<std::string>
+    restoreFile("restore",
+                cl::desc("Resume the simulation from the given checkpoint"),
+                cl::value_desc("filename"));
+
+static cl::list<std::string> batchRuns(
+    "batch",
+    cl::desc("Run one simulation per given checkpoint, or from the initial "
+             "state for 'init', reusing the compiled design. The traces are "
+             "written in the given order"),
+    cl::value_desc("checkpoints"), cl::CommaSeparated);
+
+static cl::opt<unsigned> batchJobs(
+    "batch-jobs",
+    cl::desc("Number of batch simulations run concurrently, each with a "
+             "simulation state of its own"),
+    cl::value_desc("N"), cl::init(1));
+
+static cl::opt<std::string> jitCacheDir(
+    "jit-cache-dir",
+    cl::desc("Cache the compiled design in the given directory, and reuse it "
+             "in later runs on the same input"),
+    cl::value_desc("directory"));
+
 static cl::opt<std::string> root(
     "root",
     cl::desc("Specify the name of the entity to use as root of the design"),
@@ -81,6 +170,8 @@ enum TraceFormat {
   merged,
   mergedReduce,
   namedOnly,
+  vcd,
+  llhdwave,
   noTrace = -1
 };
 
@@ -100,6 +191,11 @@ static cl::opt<TraceFormat> traceMode(
             namedOnly, "named-only",
             "Only dump changes for real-time steps, only for top-level "
             "instance and signals not having the default name '(sig)?[0-9]*'"),
+        clEnumVal(vcd, "Dump a Value Change Dump waveform of all signals, for "
+                       "real-time steps only"),
+        clEnumVal(llhdwave, "Dump all signals in the compressed binary "
+                            "waveform format of llhd-sim, for real-time "
+                            "steps only"),
         clEnumValN(noTrace, "no-trace", "Don't dump a signal trace")));
 
 static int dumpLLVM(ModuleOp module, MLIRContext &context) {
@@ -129,19 +225,112 @@ static int dumpLLVM(ModuleOp module, MLIRContext &context) {
   return 0;
 }
 
+/// Return the path of the cached object for the given input, in the JIT cache
+/// directory. The key covers everything the generated code depends on: the
+/// input, the compilation options, the host and the simulator itself, such that
+/// a rebuilt simulator never picks up stale objects.
+static std::string getCachedObjectPath(StringRef input, const char *argv0,
+                                       void *mainAddr) {
+  std::string key;
+  raw_string_ostream os(key);
+  os << "llhd-sim-jit-1\n"
+     << sys::getProcessTriple() << '\n'
+     << sys::getHostCPUName() << '\n'
+     << static_cast<int>(optimizationLevel.getValue()) << '\n'
+     << root.getValue() << '\n'
+     << driveLogs.getValue() << '\n';
+
+  auto executable = sys::fs::getMainExecutable(argv0, mainAddr);
+  sys::fs::file_status status;
+  if (!executable.empty() && !sys::fs::status(executable, status))
+    os << executable << ' '
+       << status.getLastModificationTime().time_since_epoch().count() << '\n';
+  os << input;
+
+  SmallString<128> path(jitCacheDir);
+  sys::path::append(path, "llhd-sim-" + utohexstr(xxHash64(os.str())) + ".o");
+  return std::string(path.str());
+}
+
 static LogicalResult applyMLIRPasses(ModuleOp module) {
   PassManager pm(module.getContext());
 
-  pm.addPass(createConvertLLHDToLLVMPass());
+  pm.addPass(createConvertLLHDToLLVMPass(driveLogs));
 
   return pm.run(module);
 }
 
+/// Run the batch simulations on engines cloned from the given one, sharing its
+/// compiled design, and write their traces in order to the given stream.
+static LogicalResult runBatch(llhd::sim::Engine &engine, raw_ostream &os) {
+  unsigned numRuns = batchRuns.size();
+  unsigned numJobs = std::min(std::max(1u, unsigned(batchJobs)), numRuns);
+
+  // Each job collects the trace of its current run, moved to the run's trace
+  // once it finishes.
+  SmallVector<std::string, 0> traces(numRuns);
+  SmallVector<std::string, 0> buffers(numJobs);
+  SmallVector<std::unique_ptr<raw_string_ostream>, 0> streams;
+  SmallVector<std::unique_ptr<llhd::sim::Engine>, 0> engines;
+  for (unsigned j = 0; j < numJobs; ++j) {
+    streams.push_back(std::make_unique<raw_string_ostream>(buffers[j]));
+    auto clone = engine.clone(*streams.back());
+    if (!clone) {
+      logAllUnhandledErrors(clone.takeError(), llvm::errs(),
+                            "failed to set up the batch: ");
+      return failure();
+    }
+    engines.push_back(std::move(*clone));
+  }
+
+  std::atomic<unsigned> nextRun(0);
+  std::atomic<bool> anyFailed(false);
+  ThreadPool pool(hardware_concurrency(numJobs));
+  for (unsigned j = 0; j < numJobs; ++j) {
+    pool.async([&, j] {
+      auto &jobEngine = *engines[j];
+      for (unsigned i = nextRun++; i < numRuns; i = nextRun++) {
+        auto err = jobEngine.reset();
+        if (!err && batchRuns[i] != "init")
+          err = jobEngine.restoreCheckpoint(batchRuns[i]);
+        if (err) {
+          logAllUnhandledErrors(std::move(err), llvm::errs(),
+                                "failed to restore checkpoint: ");
+          anyFailed = true;
+          continue;
+        }
+        bool failed = jobEngine.simulate(nSteps, maxTime) < 0;
+        streams[j]->flush();
+        if (failed)
+          anyFailed = true;
+        else
+          traces[i] = std::move(buffers[j]);
+        buffers[j].clear();
+      }
+    });
+  }
+  pool.wait();
+
+  for (auto &trace : traces)
+    os << trace;
+  return failure(anyFailed);
+}
+
 int main(int argc, char **argv) {
   InitLLVM y(argc, argv);
 
   cl::ParseCommandLineOptions(argc, argv, "LLHD simulator\n");
 
+  // The batch runs start from their own checkpoints and are neither
+  // checkpointed nor profiled.
+  if (!batchRuns.empty() &&
+      (checkpointAt.getNumOccurrences() || !restoreFile.empty() || profile ||
+       !profileTrace.empty())) {
+    llvm::errs() << "--batch cannot be combined with --checkpoint-at, "
+                    "--restore, --profile or --profile-trace\n";
+    return 1;
+  }
+
   // Set up the input and output files.
   std::string errorMessage;
   auto file = openInputFile(inputFilename, &errorMessage);
@@ -174,10 +363,22 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+  // The cached object holds the lowered design only, which cannot be dumped.
+  std::string cachedObjectPath;
+  if (!jitCacheDir.empty() && !dumpLLVMDialect && !dumpLLVMIR) {
+    if (auto ec = sys::fs::create_directories(jitCacheDir))
+      llvm::errs() << "Not caching the compiled design, cannot create '"
+                   << jitCacheDir << "': " << ec.message() << "\n";
+    else
+      cachedObjectPath = getCachedObjectPath(
+          mgr.getMemoryBuffer(mgr.getMainFileID())->getBuffer(), argv[0],
+          (void *)(intptr_t)&main);
+  }
+
   llhd::sim::Engine engine(
       output->os(), *module, &applyMLIRPasses,
       makeOptimizingTransformer(optimizationLevel, 0, nullptr), root,
-      traceMode);
+      traceMode, cachedObjectPath, numCompileThreads);
 
   if (dumpLLVMDialect || dumpLLVMIR) {
     return dumpLLVM(engine.getModule(), context);
@@ -189,7 +390,48 @@ int main(int argc, char **argv) {
     return 0;
   }
 
-  engine.simulate(nSteps, maxTime);
+  engine.setNumThreads(numThreads);
+  engine.setLevelized(levelize);
+  if (auto err = engine.setTraceFilters(traceFilters)) {
+    logAllUnhandledErrors(std::move(err), llvm::errs(),
+                          "invalid trace filter: ");
+    return 1;
+  }
+
+  if (checkpointAt.getNumOccurrences())
+    engine.setCheckpoint(checkpointAt, checkpointFile);
+
+  if (!batchRuns.empty()) {
+    if (failed(runBatch(engine, output->os())))
+      return 1;
+    output->keep();
+    return 0;
+  }
+
+  if (!restoreFile.empty()) {
+    if (auto err = engine.restoreCheckpoint(restoreFile)) {
+      logAllUnhandledErrors(std::move(err), llvm::errs(),
+                            "failed to restore checkpoint: ");
+      return 1;
+    }
+  }
+  engine.setProfiling(profile || !profileTrace.empty());
+  if (engine.simulate(nSteps, maxTime) < 0)
+    return 1;
+
+  if (dumpQueueStats)
+    engine.dumpQueueStatistics(llvm::errs());
+
+  if (profile)
+    engine.dumpProfile(llvm::errs());
+
+  if (!profileTrace.empty()) {
+    if (auto err = engine.writeProfileTrace(profileTrace)) {
+      logAllUnhandledErrors(std::move(err), llvm::errs(),
+                            "failed to write profile trace: ");
+      return 1;
+    }
+  }
 
   output->keep();
   return 0;